@@ -0,0 +1,44 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_ATOMIC_H
+#define MBOSTOCK_ATOMIC_H
+
+namespace mbostock {
+
+  /**
+   * A few atomic primitives for sharing state between threads without locks.
+   * SDL 1.2 has threads and mutexes but no atomics, so these wrap the GCC
+   * __sync builtins (also supported by clang). Each operation is a full memory
+   * barrier.
+   */
+  class Atomics {
+  public:
+
+    /** Issues a full memory barrier. */
+    static inline void barrier() {
+      __sync_synchronize();
+    }
+
+    /** Atomically stores v in *p, returning the previous value. */
+    static inline int exchange(volatile int* p, int v) {
+      __sync_synchronize();
+      return __sync_lock_test_and_set(p, v);
+    }
+
+    /** Atomically adds v to *p, returning the new value. */
+    static inline int add(volatile int* p, int v) {
+      return __sync_add_and_fetch(p, v);
+    }
+
+    /** Atomically stores v in *p if *p equals old; returns true on success. */
+    static inline bool compareAndSwap(volatile int* p, int old, int v) {
+      return __sync_bool_compare_and_swap(p, old, v);
+    }
+
+  private:
+    Atomics();
+  };
+
+}
+
+#endif
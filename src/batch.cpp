@@ -0,0 +1,89 @@
+// -*- C++ -*-
+
+#include "batch.h"
+#include "player.h"
+#include "room.h"
+#include "world.h"
+
+using namespace mbostock;
+
+static void output(std::vector<float>& out, int k, const Vector& v) {
+  out[3 * k] = v.x;
+  out[3 * k + 1] = v.y;
+  out[3 * k + 2] = v.z;
+}
+
+BatchEnvironment::BatchEnvironment(World& world, int room, int count)
+    : world_(world), count_(count), states_(count),
+      positions_(3 * count), xs_(3 * count), ys_(3 * count), zs_(3 * count),
+      leftContacts_(count), rightContacts_(count), rooms_(count),
+      portals_(count, -1), falls_(count) {
+  world_.setMuted(true);
+  world_.setBookkeeping(false);
+  world_.setRoom(room, 0);
+  world_.contactObjects_.clear();
+  world_.room().reset();
+  world_.player().stop();
+  world_.saveState(start_);
+  for (int k = 0; k < count_; k++) {
+    reset(k);
+  }
+}
+
+void BatchEnvironment::reset(int k) {
+  setState(k, start_);
+}
+
+void BatchEnvironment::setState(int k, const Snapshot& s) {
+  states_[k] = s;
+  states_[k].rewind();
+  world_.loadState(states_[k]);
+  world_.portal_ = -1;
+  world_.fell_ = false;
+  output(k);
+}
+
+/*
+ * Each environment is loaded, stepped and saved in turn. Environments that
+ * leave the room (through a portal) carry on in the room they entered.
+ */
+void BatchEnvironment::step(const uint8_t* actions) {
+  for (int k = 0; k < count_; k++) {
+    Snapshot& s = states_[k];
+    s.rewind();
+    world_.loadState(s);
+
+    uint8_t a = actions[k];
+    Player::Direction turn = Player::NONE;
+    Player::Direction move = Player::NONE;
+    if ((a & (LEFT | RIGHT)) == LEFT) {
+      turn = Player::LEFT;
+    } else if ((a & (LEFT | RIGHT)) == RIGHT) {
+      turn = Player::RIGHT;
+    }
+    if ((a & (FORWARD | BACKWARD)) == FORWARD) {
+      move = Player::FORWARD;
+    } else if ((a & (FORWARD | BACKWARD)) == BACKWARD) {
+      move = Player::BACKWARD;
+    }
+    world_.player().setControls(turn, move);
+    world_.step();
+
+    s.clear();
+    world_.saveState(s);
+    output(k);
+  }
+}
+
+void BatchEnvironment::output(int k) {
+  const Player& p = world_.player();
+  ::output(positions_, k, p.origin());
+  ::output(xs_, k, p.x());
+  ::output(ys_, k, p.y());
+  ::output(zs_, k, p.z());
+  leftContacts_[k] = p.leftWheelFriction() ? 1 : 0;
+  rightContacts_[k] = p.rightWheelFriction() ? 1 : 0;
+  rooms_[k] = world_.roomIndex();
+  portals_[k] = world_.portal_;
+  falls_[k] = world_.fell_ ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_BATCH_H
+#define MBOSTOCK_BATCH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "physics/snapshot.h"
+
+namespace mbostock {
+
+  class World;
+
+  /**
+   * Runs many independent copies (environments) of one room in a single world,
+   * stepping all of them with one call. Each environment's state is kept as a
+   * snapshot and loaded into the world to be stepped, so the copies share the
+   * room's objects rather than duplicating them.
+   *
+   * After each step, the player's position, orientation, wheel contacts and
+   * room index for every environment are written to contiguous arrays, one
+   * per field, along with the index of the portal taken on that step (in the
+   * room stepped, or -1) and whether the player fell into a chasm. The arrays
+   * may be read directly (e.g., mapped by external code) without copying.
+   * Vectors are stored as consecutive x, y, z floats, so position k is at
+   * positions()[3 * k].
+   *
+   * The world must not be running on its simulation thread. It is muted and
+   * stepped without bookkeeping (see World::setBookkeeping), and so neither
+   * rewinds, records nor grows the room's trails; loading an environment in
+   * another room switches to it without prefetching or evicting rooms.
+   */
+  class BatchEnvironment {
+  public:
+    BatchEnvironment(World& world, int room, int count);
+
+    /** Actions are bitmasks of the held directions. */
+    enum Action { LEFT = 1, RIGHT = 2, FORWARD = 4, BACKWARD = 8 };
+
+    /** Steps every environment once, given an action for each. */
+    void step(const uint8_t* actions);
+
+    /** Resets the specified environment to the room's starting state. */
+    void reset(int k);
+
+    /**
+     * The complete state of the specified environment, as saved by the world.
+     * Setting the state of one environment to that of another (or to a state
+     * saved earlier) branches from that point without replaying the input
+     * that led to it.
+     */
+    inline const Snapshot& state(int k) const { return states_[k]; }
+    void setState(int k, const Snapshot& s);
+
+    inline int count() const { return count_; }
+
+    inline const float* positions() const { return &positions_[0]; }
+    inline const float* xs() const { return &xs_[0]; }
+    inline const float* ys() const { return &ys_[0]; }
+    inline const float* zs() const { return &zs_[0]; }
+    inline const uint8_t* leftContacts() const { return &leftContacts_[0]; }
+    inline const uint8_t* rightContacts() const { return &rightContacts_[0]; }
+    inline const int32_t* rooms() const { return &rooms_[0]; }
+    inline const int32_t* portals() const { return &portals_[0]; }
+    inline const uint8_t* falls() const { return &falls_[0]; }
+
+  private:
+    void output(int k);
+
+    World& world_;
+    int count_;
+    Snapshot start_;
+    std::vector<Snapshot> states_;
+    std::vector<float> positions_;
+    std::vector<float> xs_;
+    std::vector<float> ys_;
+    std::vector<float> zs_;
+    std::vector<uint8_t> leftContacts_;
+    std::vector<uint8_t> rightContacts_;
+    std::vector<int32_t> rooms_;
+    std::vector<int32_t> portals_;
+    std::vector<uint8_t> falls_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_COMPILED_FORMAT_H
+#define MBOSTOCK_COMPILED_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace mbostock {
+
+  /**
+   * A contiguous run of records in one of a compiled file's arrays, such as
+   * the objects in a room.
+   */
+  class CompiledRange {
+  public:
+    int32_t begin;
+    int32_t count;
+  };
+
+  /**
+   * Helpers shared by the compiled formats (worlds, textures and archives).
+   * Each file begins with a header class H of the form
+   *
+   *   char magic[4];
+   *   int32_t version;
+   *   CompiledRange sections[H::SECTIONS];
+   *
+   * giving the byte offset and number of records (or bytes) of each array.
+   * The arrays follow the header, each aligned to four bytes.
+   */
+  class CompiledFormat {
+  public:
+
+    /** Returns true if the range lies within an array of count records. */
+    static inline bool validRange(const CompiledRange& r, int count) {
+      return (r.begin >= 0) && (r.count >= 0) && (r.begin <= count - r.count);
+    }
+
+    /** Returns true if the index is -1 (none) or within count records. */
+    static inline bool validIndex(int i, int count) {
+      return (i >= -1) && (i < count);
+    }
+
+    /**
+     * Checks the magic and version of the header at the start of the data,
+     * and locates each array, checking that it is aligned and within bounds;
+     * sizes gives the size of each array's records.
+     */
+    template <class H>
+    static bool readSections(const char* data, size_t length,
+        const char* magic, int32_t version, const size_t* sizes,
+        const char** sections) {
+      if (length < sizeof(H)) {
+        return false;
+      }
+      const H& h = *(const H*) data;
+      if ((memcmp(h.magic, magic, sizeof(h.magic)) != 0)
+          || (h.version != version)) {
+        return false;
+      }
+      for (int i = 0; i < H::SECTIONS; i++) {
+        const CompiledRange& s = h.sections[i];
+        if ((s.begin < (int32_t) sizeof(H)) || (s.begin % 4 != 0)
+            || (s.count < 0) || ((size_t) s.begin > length)
+            || ((size_t) s.count > (length - s.begin) / sizes[i])) {
+          return false;
+        }
+        sections[i] = data + s.begin;
+      }
+      return true;
+    }
+
+    /**
+     * Clears the specified header, setting its magic and version, and reserves
+     * space for it at the start of the output; the header is copied into place
+     * once its sections are written.
+     */
+    template <class H>
+    static void writeHeader(std::vector<char>& out, H& h, const char* magic,
+        int32_t version) {
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, magic, sizeof(h.magic));
+      h.version = version;
+      out.assign(sizeof(h), 0);
+    }
+
+    /**
+     * Appends an array, padded to four bytes, and records its range as the
+     * specified section of the header.
+     */
+    template <class H, class T>
+    static void writeSection(std::vector<char>& out, H& h, int section,
+        const std::vector<T>& records) {
+      CompiledRange& s = h.sections[section];
+      s.begin = out.size();
+      s.count = records.size();
+      if (!records.empty()) {
+        const char* p = (const char*) &records[0];
+        out.insert(out.end(), p, p + records.size() * sizeof(T));
+      }
+      out.resize((out.size() + 3) & ~3);
+    }
+
+  private:
+    CompiledFormat();
+  };
+
+}
+
+#endif
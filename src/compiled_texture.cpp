@@ -0,0 +1,434 @@
+// -*- C++ -*-
+
+#include <SDL/sdl.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compiled_texture.h"
+#include "texture_image.h"
+
+namespace mbostock {
+
+  class CompiledTexturesHeader {
+  public:
+    enum Section { TEXTURES, LEVELS, STRINGS, PIXELS, SECTIONS };
+
+    char magic[4];
+    int32_t version;
+
+    /** The byte offset and number of records (or bytes) of each array. */
+    CompiledRange sections[SECTIONS];
+  };
+
+}
+
+using namespace mbostock;
+
+static const char magic[] = { 'P', 'B', 'G', 'X' };
+
+/* Returns the size of a level; compressed levels are in 4x4 blocks. */
+static int levelSize(int width, int height, bool alpha, bool compressed) {
+  return compressed
+      ? ((width + 3) / 4) * ((height + 3) / 4) * (alpha ? 16 : 8)
+      : width * height * (alpha ? 4 : 3);
+}
+
+CompiledTextures::CompiledTextures()
+    : data_(NULL), length_(0) {
+  close();
+}
+
+CompiledTextures::~CompiledTextures() {
+  close();
+}
+
+bool CompiledTextures::open(const char* path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0)
+      || (st.st_size < (off_t) sizeof(CompiledTexturesHeader))) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  if (!load((const char*) data, st.st_size)) {
+    munmap(data, st.st_size);
+    data_ = NULL;
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool CompiledTextures::open(Resource& resource) {
+  close();
+  resource_.swap(resource);
+  if ((resource_.length() < sizeof(CompiledTexturesHeader))
+      || !load(resource_.data(), resource_.length())) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void CompiledTextures::close() {
+  if (resource_.opened()) {
+    resource_.close();
+  } else if (data_ != NULL) {
+    munmap((void*) data_, length_);
+  }
+  data_ = NULL;
+  length_ = 0;
+  textures_ = NULL;
+  levels_ = NULL;
+  strings_ = NULL;
+  pixels_ = NULL;
+  textureCount_ = levelCount_ = stringsLength_ = pixelsLength_ = 0;
+}
+
+const CompiledTexture* CompiledTextures::find(const char* path) const {
+  for (int i = 0; i < textureCount_; i++) {
+    if (strcmp(text(textures_[i].path), path) == 0) {
+      return &textures_[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Locates each array within the data, checking that it is aligned and within
+ * bounds, and then validates the records.
+ */
+bool CompiledTextures::load(const char* data, size_t length) {
+  data_ = data;
+  length_ = length;
+  static const size_t sizes[CompiledTexturesHeader::SECTIONS] = {
+    sizeof(CompiledTexture), sizeof(CompiledTextureLevel), 1, 1
+  };
+  const char* sections[CompiledTexturesHeader::SECTIONS];
+  if (!CompiledFormat::readSections<CompiledTexturesHeader>(data, length,
+          magic, version, sizes, sections)) {
+    return false;
+  }
+  const CompiledTexturesHeader& h = *(const CompiledTexturesHeader*) data;
+
+  textures_ = (const CompiledTexture*)
+      sections[CompiledTexturesHeader::TEXTURES];
+  levels_ = (const CompiledTextureLevel*)
+      sections[CompiledTexturesHeader::LEVELS];
+  strings_ = sections[CompiledTexturesHeader::STRINGS];
+  pixels_ = (const uint8_t*) sections[CompiledTexturesHeader::PIXELS];
+  textureCount_ = h.sections[CompiledTexturesHeader::TEXTURES].count;
+  levelCount_ = h.sections[CompiledTexturesHeader::LEVELS].count;
+  stringsLength_ = h.sections[CompiledTexturesHeader::STRINGS].count;
+  pixelsLength_ = h.sections[CompiledTexturesHeader::PIXELS].count;
+
+  /* Every string is terminated, so the table must end with a terminator. */
+  if ((stringsLength_ > 0) && (strings_[stringsLength_ - 1] != '\0')) {
+    return false;
+  }
+  return validate();
+}
+
+/*
+ * Checks that every level lies within the pixels, and is exactly the size its
+ * dimensions and format imply, so that the driver never reads past it.
+ */
+bool CompiledTextures::validate() const {
+  for (int i = 0; i < textureCount_; i++) {
+    const CompiledTexture& t = textures_[i];
+    bool alpha = (t.flags & CompiledTexture::ALPHA);
+    if ((t.path < 0) || (t.path >= stringsLength_)
+        || !validateLevels(t.levels, alpha, false)
+        || !validateLevels(t.compressedLevels, alpha, true)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CompiledTextures::validateLevels(const CompiledRange& r, bool alpha,
+    bool compressed) const {
+  if ((r.count < 1) || !CompiledFormat::validRange(r, levelCount_)) {
+    return false;
+  }
+  for (int i = r.begin; i < r.begin + r.count; i++) {
+    const CompiledTextureLevel& l = levels_[i];
+    if ((l.width < 1) || (l.height < 1)
+        || (l.width > 1 << 16) || (l.height > 1 << 16)
+        || (l.size != levelSize(l.width, l.height, alpha, compressed))
+        || (l.offset < 0) || (l.offset > pixelsLength_ - l.size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Returns the color as 5:6:5, rounded to nearest. */
+static uint16_t pack565(const int* c) {
+  return (((c[0] * 31 + 127) / 255) << 11)
+      | (((c[1] * 63 + 127) / 255) << 5)
+      | ((c[2] * 31 + 127) / 255);
+}
+
+/* Expands a 5:6:5 color, replicating the high bits into the low. */
+static void unpack565(uint16_t p, int* c) {
+  int r = (p >> 11) & 31, g = (p >> 5) & 63, b = p & 31;
+  c[0] = (r << 3) | (r >> 2);
+  c[1] = (g << 2) | (g >> 4);
+  c[2] = (b << 3) | (b >> 2);
+}
+
+static void writeLittle(uint8_t* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out[i] = (value >> (8 * i)) & 0xff;
+  }
+}
+
+/*
+ * Compresses the colors of a block of 16 RGBA pixels as DXT1 (opaque). The
+ * endpoints are the pixels furthest apart along the principal axis of the
+ * colors, found by power iteration, inset slightly so that the palette
+ * better fits the colors between.
+ */
+static void compressColors(const uint8_t* block, uint8_t* out) {
+  float mean[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) {
+      mean[c] += block[i * 4 + c] / 16.f;
+    }
+  }
+  float cov[6] = { 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    float r = block[i * 4] - mean[0];
+    float g = block[i * 4 + 1] - mean[1];
+    float b = block[i * 4 + 2] - mean[2];
+    cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+    cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+  }
+  float axis[3] = { 1, 1, 1 };
+  for (int k = 0; k < 8; k++) {
+    float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+    float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+    float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+    float m = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+    if (m == 0) {
+      break;
+    }
+    axis[0] = x / m;
+    axis[1] = y / m;
+    axis[2] = z / m;
+  }
+
+  int lo = 0, hi = 0;
+  float loDot = 0, hiDot = 0;
+  for (int i = 0; i < 16; i++) {
+    const uint8_t* p = block + i * 4;
+    float d = p[0] * axis[0] + p[1] * axis[1] + p[2] * axis[2];
+    if ((i == 0) || (d < loDot)) {
+      loDot = d;
+      lo = i;
+    }
+    if ((i == 0) || (d > hiDot)) {
+      hiDot = d;
+      hi = i;
+    }
+  }
+  int c0[3], c1[3];
+  for (int c = 0; c < 3; c++) {
+    int a = block[hi * 4 + c], b = block[lo * 4 + c];
+    int inset = (a - b) / 16;
+    c0[c] = std::min(255, std::max(0, a - inset));
+    c1[c] = std::min(255, std::max(0, b + inset));
+  }
+  uint16_t p0 = pack565(c0), p1 = pack565(c1);
+  if (p0 < p1) {
+    std::swap(p0, p1);
+  }
+
+  /* With p0 > p1, the palette has four colors; if equal, all use the first. */
+  int palette[4][3];
+  unpack565(p0, palette[0]);
+  unpack565(p1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+  uint32_t indexes = 0;
+  if (p0 != p1) {
+    for (int i = 0; i < 16; i++) {
+      const uint8_t* p = block + i * 4;
+      int best = 0, bestDistance = 0;
+      for (int j = 0; j < 4; j++) {
+        int dr = p[0] - palette[j][0];
+        int dg = p[1] - palette[j][1];
+        int db = p[2] - palette[j][2];
+        int d = dr * dr + dg * dg + db * db;
+        if ((j == 0) || (d < bestDistance)) {
+          bestDistance = d;
+          best = j;
+        }
+      }
+      indexes |= best << (2 * i);
+    }
+  }
+  writeLittle(out, p0, 2);
+  writeLittle(out + 2, p1, 2);
+  writeLittle(out + 4, indexes, 4);
+}
+
+/*
+ * Compresses the alpha of a block of 16 RGBA pixels as DXT5 does, with the
+ * extremes as endpoints and six values interpolated between.
+ */
+static void compressAlpha(const uint8_t* block, uint8_t* out) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; i++) {
+    a0 = std::max(a0, (int) block[i * 4 + 3]);
+    a1 = std::min(a1, (int) block[i * 4 + 3]);
+  }
+  uint64_t indexes = 0;
+  if (a0 != a1) {
+    int palette[8] = { a0, a1 };
+    for (int j = 1; j < 7; j++) {
+      palette[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+    }
+    for (int i = 0; i < 16; i++) {
+      int a = block[i * 4 + 3];
+      int best = 0;
+      for (int j = 1; j < 8; j++) {
+        if (abs(a - palette[j]) < abs(a - palette[best])) {
+          best = j;
+        }
+      }
+      indexes |= (uint64_t) best << (3 * i);
+    }
+  }
+  out[0] = a0;
+  out[1] = a1;
+  writeLittle(out + 2, indexes, 6);
+}
+
+/* Compresses the RGBA pixels as DXT1, or as DXT5 if alpha. */
+static void compress(const uint8_t* pixels, int width, int height, bool alpha,
+    std::vector<uint8_t>& out) {
+  out.resize(levelSize(width, height, alpha, true));
+  uint8_t* o = &out[0];
+  uint8_t block[64];
+  for (int by = 0; by < height; by += 4) {
+    for (int bx = 0; bx < width; bx += 4) {
+
+      /* Blocks that overhang a small level repeat its edge pixels. */
+      for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+          int sx = std::min(bx + x, width - 1);
+          int sy = std::min(by + y, height - 1);
+          memcpy(block + (y * 4 + x) * 4, pixels + (sy * width + sx) * 4, 4);
+        }
+      }
+      if (alpha) {
+        compressAlpha(block, o);
+        o += 8;
+      }
+      compressColors(block, o);
+      o += 8;
+    }
+  }
+}
+
+/*
+ * Each level is stored uncompressed as RGB (or RGBA), whatever the order of
+ * the decoded image, and compressed from RGBA.
+ */
+void CompiledTexturesWriter::add(const char* path, const SDL_Surface* image) {
+  TextureImage t(image);
+  bool bgr = (t.format() == GL_BGR) || (t.format() == GL_BGRA);
+  int n = t.components();
+
+  CompiledTexture texture;
+  texture.path = strings_.size();
+  strings_.insert(strings_.end(), path, path + strlen(path) + 1);
+  texture.flags = t.alpha() ? CompiledTexture::ALPHA : 0;
+  texture.levels.begin = levels_.size();
+  texture.levels.count = t.levels();
+  texture.compressedLevels.begin = levels_.size() + t.levels();
+  texture.compressedLevels.count = t.levels();
+
+  std::vector<std::vector<uint8_t> > rgba(t.levels());
+  for (int i = 0; i < t.levels(); i++) {
+    int size = t.width(i) * t.height(i);
+    const uint8_t* src = t.pixels(i);
+    std::vector<uint8_t> pixels(size * n);
+    rgba[i].resize(size * 4);
+    for (int j = 0; j < size; j++) {
+      uint8_t* p = &pixels[j * n];
+      uint8_t* q = &rgba[i][j * 4];
+      p[0] = q[0] = src[j * n + (bgr ? 2 : 0)];
+      p[1] = q[1] = src[j * n + 1];
+      p[2] = q[2] = src[j * n + (bgr ? 0 : 2)];
+      q[3] = 255;
+      if (n == 4) {
+        p[3] = q[3] = src[j * n + 3];
+      }
+    }
+    addLevel(t.width(i), t.height(i), pixels);
+  }
+  for (int i = 0; i < t.levels(); i++) {
+    std::vector<uint8_t> pixels;
+    compress(&rgba[i][0], t.width(i), t.height(i), t.alpha(), pixels);
+    addLevel(t.width(i), t.height(i), pixels);
+  }
+  textures_.push_back(texture);
+}
+
+void CompiledTexturesWriter::addLevel(int width, int height,
+    const std::vector<uint8_t>& pixels) {
+  CompiledTextureLevel l;
+  l.width = width;
+  l.height = height;
+  l.offset = pixels_.size();
+  l.size = pixels.size();
+  pixels_.insert(pixels_.end(), pixels.begin(), pixels.end());
+  pixels_.resize((pixels_.size() + 3) & ~3);
+  levels_.push_back(l);
+}
+
+size_t CompiledTexturesWriter::size(bool compressed) const {
+  size_t size = 0;
+  std::vector<CompiledTexture>::const_iterator i;
+  for (i = textures_.begin(); i != textures_.end(); i++) {
+    const CompiledRange& r = compressed ? i->compressedLevels : i->levels;
+    for (int j = r.begin; j < r.begin + r.count; j++) {
+      size += levels_[j].size;
+    }
+  }
+  return size;
+}
+
+void CompiledTexturesWriter::write(std::vector<char>& out) const {
+  CompiledTexturesHeader h;
+  CompiledFormat::writeHeader(out, h, magic, CompiledTextures::version);
+  CompiledFormat::writeSection(out, h, CompiledTexturesHeader::TEXTURES,
+      textures_);
+  CompiledFormat::writeSection(out, h, CompiledTexturesHeader::LEVELS,
+      levels_);
+  CompiledFormat::writeSection(out, h, CompiledTexturesHeader::STRINGS,
+      strings_);
+  CompiledFormat::writeSection(out, h, CompiledTexturesHeader::PIXELS,
+      pixels_);
+  memcpy(&out[0], &h, sizeof(h));
+}
@@ -0,0 +1,132 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_COMPILED_TEXTURE_H
+#define MBOSTOCK_COMPILED_TEXTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "compiled_format.h"
+#include "resource.h"
+
+struct SDL_Surface;
+
+namespace mbostock {
+
+  /** A mipmap level, as a range of bytes in the data section. */
+  class CompiledTextureLevel {
+  public:
+    int32_t width;
+    int32_t height;
+    int32_t offset;
+    int32_t size;
+  };
+
+  /**
+   * A texture's mipmaps, both uncompressed (as RGB or RGBA) and compressed (as
+   * DXT1 or DXT5, if the texture has alpha). Each is a range of levels, the
+   * largest first.
+   */
+  class CompiledTexture {
+  public:
+    enum Flag { ALPHA = 1 };
+
+    int32_t path;
+    int32_t flags;
+    CompiledRange levels;
+    CompiledRange compressedLevels;
+  };
+
+  /**
+   * A cache of textures, decoded and filtered offline so that loading them
+   * needs neither decoding nor filtering, and compressed so that uploading
+   * them needs less time and memory. Textures are keyed by their resource
+   * path, and stored in native byte order.
+   *
+   * As with CompiledWorld, opening a file maps it into memory and validates
+   * it (as does opening a resource, which may be in the archive); levels are
+   * then uploaded straight from the mapping, so only the pages of the textures
+   * (and levels) actually used are ever read.
+   */
+  class CompiledTextures {
+  public:
+    CompiledTextures();
+    ~CompiledTextures();
+
+    static const int version = 1;
+
+    /** Maps the specified file; returns false if it is missing or invalid. */
+    bool open(const char* path);
+
+    /**
+     * Takes the specified resource, reading it in place; returns false if it
+     * is invalid.
+     */
+    bool open(Resource& resource);
+
+    void close();
+
+    inline bool opened() const { return data_ != NULL; }
+
+    /** The size of the file in bytes. */
+    inline size_t length() const { return length_; }
+
+    inline int textures() const { return textureCount_; }
+    inline const CompiledTexture& texture(int i) const { return textures_[i]; }
+    inline const CompiledTextureLevel& level(int i) const { return levels_[i]; }
+
+    /** Returns the texture with the specified path, or NULL if absent. */
+    const CompiledTexture* find(const char* path) const;
+
+    inline const char* text(int offset) const { return strings_ + offset; }
+    inline const uint8_t* pixels(const CompiledTextureLevel& l) const {
+      return pixels_ + l.offset;
+    }
+
+  private:
+    bool load(const char* data, size_t length);
+    bool validate() const;
+    bool validateLevels(const CompiledRange& r, bool alpha,
+        bool compressed) const;
+
+    const char* data_;
+    size_t length_;
+    Resource resource_;
+
+    const CompiledTexture* textures_;
+    const CompiledTextureLevel* levels_;
+    const char* strings_;
+    const uint8_t* pixels_;
+    int textureCount_;
+    int levelCount_;
+    int stringsLength_;
+    int pixelsLength_;
+  };
+
+  /**
+   * Accumulates textures, filtering and compressing their mipmaps, and
+   * serializes them in the format read by CompiledTextures.
+   */
+  class CompiledTexturesWriter {
+  public:
+    /** Adds the image, whose pixels must be RGB or RGBA (in either order). */
+    void add(const char* path, const SDL_Surface* image);
+
+    /** Returns the total size of the levels, compressed or not. */
+    size_t size(bool compressed) const;
+
+    void write(std::vector<char>& out) const;
+
+  private:
+    void addLevel(int width, int height, const std::vector<uint8_t>& pixels);
+
+    std::vector<CompiledTexture> textures_;
+    std::vector<CompiledTextureLevel> levels_;
+    std::vector<char> strings_;
+    std::vector<uint8_t> pixels_;
+  };
+
+}
+
+#endif
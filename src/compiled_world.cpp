@@ -0,0 +1,239 @@
+// -*- C++ -*-
+
+#include <string.h>
+
+#include "compiled_world.h"
+#include "physics/translation.h"
+
+namespace mbostock {
+
+  class CompiledHeader {
+  public:
+    enum Section {
+      LIGHTINGS, LIGHTS, MATERIALS, ROOMS, ORIGINS, PORTALS, FORCES,
+      TRANSFORMS, OBJECTS, TARGETS, STRINGS, SECTIONS
+    };
+
+    char magic[4];
+    int32_t version;
+
+    /** The byte offset and number of records (or bytes) of each array. */
+    CompiledRange sections[SECTIONS];
+  };
+
+}
+
+using namespace mbostock;
+
+static const char magic[] = { 'P', 'B', 'G', 'W' };
+
+CompiledWorld::CompiledWorld()
+    : data_(NULL), length_(0) {
+  close();
+}
+
+CompiledWorld::~CompiledWorld() {
+  close();
+}
+
+bool CompiledWorld::isCompiled(const char* data, size_t length) {
+  return (length >= sizeof(magic)) && (memcmp(data, magic, sizeof(magic)) == 0);
+}
+
+bool CompiledWorld::open(Resource& resource) {
+  close();
+  resource_.swap(resource);
+  if (!load(resource_.data(), resource_.length())) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool CompiledWorld::open(std::vector<char>& data) {
+  close();
+  buffer_.swap(data);
+  if (!load(buffer_.empty() ? NULL : &buffer_[0], buffer_.size())) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void CompiledWorld::close() {
+  resource_.close();
+  buffer_.clear();
+  data_ = NULL;
+  length_ = 0;
+  lightings_ = NULL;
+  lights_ = NULL;
+  materials_ = NULL;
+  rooms_ = NULL;
+  origins_ = NULL;
+  portals_ = NULL;
+  forces_ = NULL;
+  transforms_ = NULL;
+  objects_ = NULL;
+  targets_ = NULL;
+  strings_ = NULL;
+  lightingCount_ = lightCount_ = materialCount_ = roomCount_ = 0;
+  originCount_ = portalCount_ = forceCount_ = transformCount_ = 0;
+  objectCount_ = targetCount_ = stringsLength_ = 0;
+}
+
+/*
+ * Locates each array within the data, checking that it is aligned and within
+ * bounds, and then validates the records.
+ */
+bool CompiledWorld::load(const char* data, size_t length) {
+  data_ = data;
+  length_ = length;
+  static const size_t sizes[CompiledHeader::SECTIONS] = {
+    sizeof(CompiledLighting), sizeof(CompiledLight), sizeof(CompiledMaterial),
+    sizeof(CompiledRoom), sizeof(CompiledOrigin), sizeof(CompiledPortal),
+    sizeof(CompiledForce), sizeof(CompiledTransform), sizeof(CompiledObject),
+    sizeof(CompiledTarget), 1
+  };
+  const char* sections[CompiledHeader::SECTIONS];
+  if (!CompiledFormat::readSections<CompiledHeader>(data, length, magic,
+          version, sizes, sections)) {
+    return false;
+  }
+  const CompiledHeader& h = *(const CompiledHeader*) data;
+
+  lightings_ = (const CompiledLighting*) sections[CompiledHeader::LIGHTINGS];
+  lights_ = (const CompiledLight*) sections[CompiledHeader::LIGHTS];
+  materials_ = (const CompiledMaterial*) sections[CompiledHeader::MATERIALS];
+  rooms_ = (const CompiledRoom*) sections[CompiledHeader::ROOMS];
+  origins_ = (const CompiledOrigin*) sections[CompiledHeader::ORIGINS];
+  portals_ = (const CompiledPortal*) sections[CompiledHeader::PORTALS];
+  forces_ = (const CompiledForce*) sections[CompiledHeader::FORCES];
+  transforms_ = (const CompiledTransform*)
+      sections[CompiledHeader::TRANSFORMS];
+  objects_ = (const CompiledObject*) sections[CompiledHeader::OBJECTS];
+  targets_ = (const CompiledTarget*) sections[CompiledHeader::TARGETS];
+  strings_ = sections[CompiledHeader::STRINGS];
+  lightingCount_ = h.sections[CompiledHeader::LIGHTINGS].count;
+  lightCount_ = h.sections[CompiledHeader::LIGHTS].count;
+  materialCount_ = h.sections[CompiledHeader::MATERIALS].count;
+  roomCount_ = h.sections[CompiledHeader::ROOMS].count;
+  originCount_ = h.sections[CompiledHeader::ORIGINS].count;
+  portalCount_ = h.sections[CompiledHeader::PORTALS].count;
+  forceCount_ = h.sections[CompiledHeader::FORCES].count;
+  transformCount_ = h.sections[CompiledHeader::TRANSFORMS].count;
+  objectCount_ = h.sections[CompiledHeader::OBJECTS].count;
+  targetCount_ = h.sections[CompiledHeader::TARGETS].count;
+  stringsLength_ = h.sections[CompiledHeader::STRINGS].count;
+
+  /* Every string is terminated, so the table must end with a terminator. */
+  if ((stringsLength_ > 0) && (strings_[stringsLength_ - 1] != '\0')) {
+    return false;
+  }
+  return validate();
+}
+
+/*
+ * Checks that every range and index is in bounds, so that the loader can trust
+ * the records. Indexes of transforms and origins must also lie within the
+ * room that owns them.
+ */
+bool CompiledWorld::validate() const {
+  for (int i = 0; i < lightingCount_; i++) {
+    if (!CompiledFormat::validRange(lightings_[i].lights, lightCount_)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < materialCount_; i++) {
+    if (!CompiledFormat::validIndex(materials_[i].texture, stringsLength_)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < originCount_; i++) {
+    if (!CompiledFormat::validIndex(origins_[i].name, stringsLength_)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < portalCount_; i++) {
+    const CompiledPortal& p = portals_[i];
+    if (!CompiledFormat::validIndex(p.room, roomCount_)
+        || !CompiledFormat::validIndex(p.origin, (p.room < 0)
+            ? 0 : rooms_[p.room].origins.count)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < targetCount_; i++) {
+    const CompiledTarget& t = targets_[i];
+    if ((t.room < 0) || (t.room >= roomCount_)) {
+      return false;
+    }
+    const CompiledRange& z = rooms_[t.room].transforms;
+    if ((t.transform < z.begin) || (t.transform >= z.begin + z.count)) {
+      return false;
+    }
+  }
+  for (int i = 0; i < roomCount_; i++) {
+    const CompiledRoom& r = rooms_[i];
+    if (!CompiledFormat::validIndex(r.name, stringsLength_)
+        || !CompiledFormat::validIndex(r.music, stringsLength_)
+        || !CompiledFormat::validIndex(r.lighting, lightingCount_)
+        || !CompiledFormat::validRange(r.origins, originCount_)
+        || !CompiledFormat::validRange(r.portals, portalCount_)
+        || !CompiledFormat::validRange(r.forces, forceCount_)
+        || !CompiledFormat::validRange(r.transforms, transformCount_)
+        || !CompiledFormat::validRange(r.objects, objectCount_)) {
+      return false;
+    }
+    int end = r.transforms.begin + r.transforms.count;
+    for (int j = r.transforms.begin; j < end; j++) {
+      const CompiledTransform& z = transforms_[j];
+      if ((z.type < CompiledTransform::ROTATION)
+          || (z.type > CompiledTransform::TRANSLATION)
+          || (z.mode < Translation::REVERSE)
+          || (z.mode > Translation::ONE_WAY)
+          || !CompiledFormat::validIndex(z.name, stringsLength_)
+          || ((z.parent != -1) && ((z.parent <= j) || (z.parent >= end)))) {
+        return false;
+      }
+    }
+    for (int j = r.objects.begin; j < r.objects.begin + r.objects.count; j++) {
+      const CompiledObject& o = objects_[j];
+      if ((o.type < CompiledObject::AXIS_ALIGNED_BLOCK)
+          || (o.type > CompiledObject::SWITCH)
+          || ((o.transform != -1) && ((o.transform < r.transforms.begin)
+              || (o.transform >= end)))
+          || !CompiledFormat::validIndex(o.material, materialCount_)
+          || !CompiledFormat::validIndex(o.topMaterial, materialCount_)
+          || !CompiledFormat::validIndex(o.activeMaterial, materialCount_)
+          || !CompiledFormat::validRange(o.targets, targetCount_)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int CompiledWorldWriter::addString(const char* s) {
+  if (s == NULL) {
+    return -1;
+  }
+  int offset = strings_.size();
+  strings_.insert(strings_.end(), s, s + strlen(s) + 1);
+  return offset;
+}
+
+void CompiledWorldWriter::write(std::vector<char>& out) const {
+  CompiledHeader h;
+  CompiledFormat::writeHeader(out, h, magic, CompiledWorld::version);
+  CompiledFormat::writeSection(out, h, CompiledHeader::LIGHTINGS, lightings);
+  CompiledFormat::writeSection(out, h, CompiledHeader::LIGHTS, lights);
+  CompiledFormat::writeSection(out, h, CompiledHeader::MATERIALS, materials);
+  CompiledFormat::writeSection(out, h, CompiledHeader::ROOMS, rooms);
+  CompiledFormat::writeSection(out, h, CompiledHeader::ORIGINS, origins);
+  CompiledFormat::writeSection(out, h, CompiledHeader::PORTALS, portals);
+  CompiledFormat::writeSection(out, h, CompiledHeader::FORCES, forces);
+  CompiledFormat::writeSection(out, h, CompiledHeader::TRANSFORMS, transforms);
+  CompiledFormat::writeSection(out, h, CompiledHeader::OBJECTS, objects);
+  CompiledFormat::writeSection(out, h, CompiledHeader::TARGETS, targets);
+  CompiledFormat::writeSection(out, h, CompiledHeader::STRINGS, strings_);
+  memcpy(&out[0], &h, sizeof(h));
+}
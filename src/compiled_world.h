@@ -0,0 +1,286 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_COMPILED_WORLD_H
+#define MBOSTOCK_COMPILED_WORLD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "compiled_format.h"
+#include "physics/vector.h"
+#include "resource.h"
+
+namespace mbostock {
+
+  /**
+   * A light, as a set of parameters to apply over the defaults; flags records
+   * which parameters were specified.
+   */
+  class CompiledLight {
+  public:
+    enum Flag {
+      AMBIENT = 1, DIFFUSE = 2, SPECULAR = 4, POSITION = 8,
+      SPOT_DIRECTION = 16, SPOT_EXPONENT = 32, CONSTANT_ATTENUATION = 64,
+      LINEAR_ATTENUATION = 128, QUADRATIC_ATTENUATION = 256
+    };
+
+    int32_t flags;
+    float ambient[4];
+    float diffuse[4];
+    float specular[4];
+    float position[4];
+    float spotDirection[4];
+    float spotExponent;
+    float constantAttenuation;
+    float linearAttenuation;
+    float quadraticAttenuation;
+  };
+
+  class CompiledLighting {
+  public:
+    enum Flag { GLOBAL_AMBIENT = 1 };
+
+    int32_t flags;
+    float globalAmbient[4];
+    CompiledRange lights;
+  };
+
+  class CompiledMaterial {
+  public:
+    enum Flag { AMBIENT = 1, DIFFUSE = 2, EMISSION = 4, SPECULAR = 8 };
+
+    int32_t flags;
+    float slipAngle;
+    float ambient[4];
+    float diffuse[4];
+    float emission[4];
+    float specular[4];
+    int32_t texture;
+  };
+
+  class CompiledOrigin {
+  public:
+    int32_t name;
+    Vector position;
+    Vector velocity;
+  };
+
+  class CompiledPortal {
+  public:
+    Vector min;
+    Vector max;
+    int32_t room;
+    int32_t origin;
+    int32_t reset;
+  };
+
+  class CompiledForce {
+  public:
+    Vector min;
+    Vector max;
+    Vector force;
+  };
+
+  /**
+   * A rotation (about x0, along the axis x1, starting at the angle start) or
+   * a translation (from x0 to x1). The parent is the index of the enclosing
+   * transform, or -1. Transforms are stored in the order they close, so a
+   * parent always follows its children.
+   */
+  class CompiledTransform {
+  public:
+    enum Type { ROTATION, TRANSLATION };
+
+    int32_t type;
+    int32_t mode;
+    int32_t parent;
+    int32_t name;
+    float speed;
+    float start;
+    float dampen;
+    Vector x0;
+    Vector x1;
+  };
+
+  /** The room and index of a transform, as targeted by a switch. */
+  class CompiledTarget {
+  public:
+    int32_t room;
+    int32_t transform;
+  };
+
+  /**
+   * A room object. The meaning of the points depends on the type: min and max
+   * for axis-aligned blocks, escalators, seesaws and switches (followed by the
+   * velocity for escalators); center and axes for oriented blocks; the
+   * vertices for walls and ramps; the ends and y-axis for tubes; and the
+   * center (followed by the velocity for fans) for balls and fans. The
+   * transform is the innermost enclosing transform, or -1; materials are -1
+   * if unspecified, and the top material is the cap material for tubes.
+   */
+  class CompiledObject {
+  public:
+    enum Type {
+      AXIS_ALIGNED_BLOCK, BLOCK, QUAD_WALL, TRI_WALL, ESCALATOR, SEESAW, RAMP,
+      TUBE, BALL, FAN, SWITCH
+    };
+
+    int32_t type;
+    int32_t transform;
+    int32_t material;
+    int32_t topMaterial;
+    int32_t activeMaterial;
+    float radius;
+    float speed;
+    float mass;
+    Vector x[4];
+    int32_t texCoords;
+    Vector t[4];
+    CompiledRange targets;
+  };
+
+  class CompiledRoom {
+  public:
+    int32_t name;
+    int32_t lighting;
+    int32_t music;
+    Vector cameraMin;
+    Vector cameraMax;
+    CompiledRange origins;
+    CompiledRange portals;
+    CompiledRange forces;
+    CompiledRange transforms;
+    CompiledRange objects;
+  };
+
+  /**
+   * A world compiled from XML into flat arrays of fixed-size records, with
+   * every reference by name resolved to an index. Strings (names and resource
+   * paths) are stored in a table and referenced by offset, or -1 if absent.
+   *
+   * The file is a header (magic, version, and the offset and count of each
+   * array) followed by the arrays, in native byte order; a file compiled for a
+   * different byte order fails the version check. Opening a resource reads it
+   * in place (mapped, or from the archive) and validates every range and
+   * index, so that records can then be read without parsing or copying.
+   */
+  class CompiledWorld {
+  public:
+    CompiledWorld();
+    ~CompiledWorld();
+
+    static const int version = 1;
+
+    /** Returns true if the specified data begins with the compiled magic. */
+    static bool isCompiled(const char* data, size_t length);
+
+    /**
+     * Takes the specified resource, reading it in place; returns false if it
+     * is invalid.
+     */
+    bool open(Resource& resource);
+
+    /** Takes the specified compiled data, as from CompiledWorldWriter. */
+    bool open(std::vector<char>& data);
+
+    void close();
+
+    /** The size of the compiled data in bytes. */
+    inline size_t length() const { return length_; }
+
+    inline int lightings() const { return lightingCount_; }
+    inline int lights() const { return lightCount_; }
+    inline int materials() const { return materialCount_; }
+    inline int rooms() const { return roomCount_; }
+    inline int origins() const { return originCount_; }
+    inline int portals() const { return portalCount_; }
+    inline int forces() const { return forceCount_; }
+    inline int transforms() const { return transformCount_; }
+    inline int objects() const { return objectCount_; }
+    inline int targets() const { return targetCount_; }
+
+    inline const CompiledLighting& lighting(int i) const {
+      return lightings_[i];
+    }
+    inline const CompiledLight& light(int i) const { return lights_[i]; }
+    inline const CompiledMaterial& material(int i) const {
+      return materials_[i];
+    }
+    inline const CompiledRoom& room(int i) const { return rooms_[i]; }
+    inline const CompiledOrigin& origin(int i) const { return origins_[i]; }
+    inline const CompiledPortal& portal(int i) const { return portals_[i]; }
+    inline const CompiledForce& force(int i) const { return forces_[i]; }
+    inline const CompiledTransform& transform(int i) const {
+      return transforms_[i];
+    }
+    inline const CompiledObject& object(int i) const { return objects_[i]; }
+    inline const CompiledTarget& target(int i) const { return targets_[i]; }
+
+    /** Returns the string at the specified offset, or NULL if -1. */
+    inline const char* text(int offset) const {
+      return (offset < 0) ? NULL : strings_ + offset;
+    }
+
+  private:
+    bool load(const char* data, size_t length);
+    bool validate() const;
+
+    const char* data_;
+    size_t length_;
+    Resource resource_;
+    std::vector<char> buffer_;
+
+    const CompiledLighting* lightings_;
+    const CompiledLight* lights_;
+    const CompiledMaterial* materials_;
+    const CompiledRoom* rooms_;
+    const CompiledOrigin* origins_;
+    const CompiledPortal* portals_;
+    const CompiledForce* forces_;
+    const CompiledTransform* transforms_;
+    const CompiledObject* objects_;
+    const CompiledTarget* targets_;
+    const char* strings_;
+    int lightingCount_;
+    int lightCount_;
+    int materialCount_;
+    int roomCount_;
+    int originCount_;
+    int portalCount_;
+    int forceCount_;
+    int transformCount_;
+    int objectCount_;
+    int targetCount_;
+    int stringsLength_;
+  };
+
+  /**
+   * Accumulates the records of a compiled world, and serializes them in the
+   * format read by CompiledWorld. Records are appended directly to the public
+   * arrays; strings are added with addString, which returns their offset.
+   */
+  class CompiledWorldWriter {
+  public:
+    int addString(const char* s);
+
+    void write(std::vector<char>& out) const;
+
+    std::vector<CompiledLighting> lightings;
+    std::vector<CompiledLight> lights;
+    std::vector<CompiledMaterial> materials;
+    std::vector<CompiledRoom> rooms;
+    std::vector<CompiledOrigin> origins;
+    std::vector<CompiledPortal> portals;
+    std::vector<CompiledForce> forces;
+    std::vector<CompiledTransform> transforms;
+    std::vector<CompiledObject> objects;
+    std::vector<CompiledTarget> targets;
+
+  private:
+    std::vector<char> strings_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_CONCURRENT_QUEUE_H
+#define MBOSTOCK_CONCURRENT_QUEUE_H
+
+#include <stdlib.h>
+
+#include "atomic.h"
+
+namespace mbostock {
+
+  /**
+   * A fixed-capacity, lock-free queue for passing values from exactly one
+   * producer thread to exactly one consumer thread. The capacity N must be a
+   * power of two. Pushing to a full queue fails rather than blocking.
+   */
+  template <class T, int N>
+  class ConcurrentQueue {
+  public:
+    ConcurrentQueue() : head_(0), tail_(0) {}
+
+    /** Appends a copy of t; returns false if full. Producer only. */
+    bool push(const T& t) {
+      int tail = tail_;
+      if (tail - head_ == N) {
+        return false;
+      }
+      items_[tail & (N - 1)] = t;
+      Atomics::barrier();
+      tail_ = tail + 1;
+      return true;
+    }
+
+    /** Pops the oldest value into t; returns false if empty. Consumer only. */
+    bool pop(T& t) {
+      int head = head_;
+      if (head == tail_) {
+        return false;
+      }
+      Atomics::barrier();
+      t = items_[head & (N - 1)];
+      Atomics::barrier();
+      head_ = head + 1;
+      return true;
+    }
+
+    /** Returns the oldest value without removing it. Consumer only. */
+    const T* peek() const {
+      int head = head_;
+      if (head == tail_) {
+        return NULL;
+      }
+      Atomics::barrier();
+      return &items_[head & (N - 1)];
+    }
+
+    inline bool empty() const { return head_ == tail_; }
+
+  private:
+    T items_[N];
+    volatile int head_;
+    volatile int tail_;
+  };
+
+}
+
+#endif
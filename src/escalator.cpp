@@ -5,6 +5,7 @@
 #include "model.h"
 #include "physics/particle.h"
 #include "physics/shape.h"
+#include "physics/snapshot.h"
 #include "physics/vector.h"
 
 using namespace mbostock;
@@ -30,7 +31,25 @@ const Shape& Escalator::shape() const {
 void Escalator::step(const ParticleSimulator& s) {
   offset_.x = fmodf(offset_.x + velocity_.x, 1.f);
   offset_.z = fmodf(offset_.z + velocity_.z, 1.f);
-  model_.setTexOffset(-offset_.x, -offset_.z);
+}
+
+void Escalator::saveDisplay(Snapshot& s) const {
+  s.write(offset_.x);
+  s.write(offset_.z);
+}
+
+void Escalator::loadDisplay(Snapshot& s) {
+  float u = s.read();
+  float v = s.read();
+  model_.setTexOffset(-u, -v);
+}
+
+void Escalator::saveState(Snapshot& s) const {
+  s.write(offset_);
+}
+
+void Escalator::loadState(Snapshot& s) {
+  offset_ = s.readVector();
 }
 
 Vector Escalator::velocity(const Vector& x) const {
@@ -22,6 +22,10 @@ namespace mbostock {
     virtual void step(const ParticleSimulator& s);
     virtual Vector velocity(const Vector& x) const;
     virtual float slip() const;
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
 
     void setMaterial(const Material& m);
     void setTopMaterial(const Material& m);
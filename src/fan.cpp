@@ -7,6 +7,7 @@
 #include "material.h"
 #include "physics/particle.h"
 #include "physics/shape.h"
+#include "physics/snapshot.h"
 
 using namespace mbostock;
 
@@ -19,6 +20,7 @@ namespace mbostock {
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
 
@@ -60,6 +62,10 @@ void StaticFanModel::initialize() {
   bladeModel_.initialize();
 }
 
+const Material* StaticFanModel::firstMaterial() const {
+  return material_;
+}
+
 void StaticFanModel::display() {
   float axleLength = r_ / 10.f * 1.5;
   float axleRadius = r_ / 20.f;
@@ -88,7 +94,8 @@ void StaticFanModel::displayBlades() {
 }
 
 FanModel::FanModel(const Fan& fan)
-    : fan_(fan), staticModel_(new StaticFanModel(fan.cylinder_.radius())),
+    : fan_(fan), angle_(0.f),
+      staticModel_(new StaticFanModel(fan.cylinder_.radius())),
       compiledModel_(Models::compile(staticModel_)) {
   for (int i = 0; i < 15; i++) {
     orientation_[i] = 0.f;
@@ -123,11 +130,15 @@ void FanModel::display() {
   glPushMatrix();
   glTranslatev(fan_.cylinder_.x0());
   glMultMatrixf(orientation());
-  glRotatef(fan_.a_, 0.f, 0.f, 1.f);
+  glRotatef(angle_, 0.f, 0.f, 1.f);
   compiledModel_->display();
   glPopMatrix();
 }
 
+const Material* FanModel::firstMaterial() const {
+  return compiledModel_->firstMaterial();
+}
+
 Fan::Fan(const Vector& x, const Vector& v, float r, float s)
     : cylinder_(x, x + v * (r / 10.f), r),
       s_(s * ParticleSimulator::timeStep()),
@@ -149,3 +160,19 @@ void Fan::step(const ParticleSimulator& s) {
 void Fan::reset() {
   a_ = 0.f;
 }
+
+void Fan::saveDisplay(Snapshot& s) const {
+  s.write(a_);
+}
+
+void Fan::loadDisplay(Snapshot& s) {
+  model_.setAngle(s.read());
+}
+
+void Fan::saveState(Snapshot& s) const {
+  s.write(a_);
+}
+
+void Fan::loadState(Snapshot& s) {
+  a_ = s.read();
+}
@@ -19,13 +19,16 @@ namespace mbostock {
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
+    inline void setAngle(float angle) { angle_ = angle; }
 
   private:
     float* orientation();
 
     const Fan& fan_;
+    float angle_;
     StaticFanModel* staticModel_;
     Model* compiledModel_;
     float orientation_[16];
@@ -39,6 +42,10 @@ namespace mbostock {
     virtual const Shape& shape() const;
     virtual void step(const ParticleSimulator& s);
     virtual void reset();
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
 
     inline void setMaterial(const Material& m) { model_.setMaterial(m); }
 
@@ -0,0 +1,277 @@
+// -*- C++ -*-
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <deque>
+#include <unistd.h>
+
+#include "atomic.h"
+#include "jobs.h"
+
+using namespace mbostock;
+
+namespace mbostock {
+
+  /**
+   * A double-ended queue of jobs. The owning thread pushes and pops at the
+   * back, while other threads steal from the front, so that the owner works
+   * on recent (cache-warm) jobs and thieves take older, typically larger ones.
+   */
+  class JobQueue {
+  public:
+    JobQueue();
+    ~JobQueue();
+
+    void push(Job* job);
+    Job* pop();
+    Job* steal();
+
+  private:
+    SDL_mutex* mutex_;
+    std::deque<Job*> jobs_;
+  };
+
+}
+
+/*
+ * Queue zero is shared by all threads other than the workers; each worker has
+ * the queue after it. The semaphore counts submitted jobs, so that idle workers
+ * sleep rather than spin.
+ */
+static std::vector<JobQueue*> queues;
+static std::vector<SDL_Thread*> workers;
+static std::vector<Uint32> workerIds;
+static SDL_sem* available = NULL;
+static volatile bool stopped = false;
+
+/* Waiting threads yield this many times before they start to sleep. */
+static const int maxSpins = 100;
+
+JobQueue::JobQueue()
+    : mutex_(SDL_CreateMutex()) {
+}
+
+JobQueue::~JobQueue() {
+  SDL_DestroyMutex(mutex_);
+}
+
+void JobQueue::push(Job* job) {
+  SDL_mutexP(mutex_);
+  jobs_.push_back(job);
+  SDL_mutexV(mutex_);
+}
+
+Job* JobQueue::pop() {
+  Job* job = NULL;
+  SDL_mutexP(mutex_);
+  if (!jobs_.empty()) {
+    job = jobs_.back();
+    jobs_.pop_back();
+  }
+  SDL_mutexV(mutex_);
+  return job;
+}
+
+Job* JobQueue::steal() {
+  Job* job = NULL;
+  SDL_mutexP(mutex_);
+  if (!jobs_.empty()) {
+    job = jobs_.front();
+    jobs_.pop_front();
+  }
+  SDL_mutexV(mutex_);
+  return job;
+}
+
+Job::Job()
+    : run_(NULL), data_(NULL), dependencies_(1), done_(false) {
+}
+
+Job::Job(void (*run)(void* data), void* data)
+    : run_(run), data_(data), dependencies_(1), done_(false) {
+}
+
+void Job::dependOn(Job& job) {
+  dependencies_++;
+  job.dependents_.push_back(this);
+}
+
+static int queueIndex() {
+  Uint32 id = SDL_ThreadID();
+  for (int i = 0; i < (int) workerIds.size(); i++) {
+    if (workerIds[i] == id) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static Job* take(int index) {
+  Job* job = queues[index]->pop();
+  for (int i = 1; (job == NULL) && (i < (int) queues.size()); i++) {
+    job = queues[(index + i) % queues.size()]->steal();
+  }
+  return job;
+}
+
+/* Queues the job if this was its last unfinished dependency (or submit). */
+void Jobs::release(Job* job) {
+  if (Atomics::add(&job->dependencies_, -1) == 0) {
+    if (queues.empty()) {
+      execute(job);
+    } else {
+      queues[queueIndex()]->push(job);
+      SDL_SemPost(available);
+    }
+  }
+}
+
+void Jobs::execute(Job* job) {
+  if (job->run_ != NULL) {
+    job->run_(job->data_);
+  }
+
+  /*
+   * Once done, the job may be destroyed by a waiting thread at any moment, and
+   * the same is true once its last dependent is released (if only the final job
+   * of a chain is waited for), so take the dependents first.
+   */
+  std::vector<Job*> dependents;
+  dependents.swap(job->dependents_);
+  Atomics::barrier();
+  job->done_ = true;
+  std::vector<Job*>::const_iterator i;
+  for (i = dependents.begin(); i != dependents.end(); i++) {
+    release(*i);
+  }
+}
+
+int Jobs::work(void* data) {
+  int index = (long) data;
+  workerIds[index - 1] = SDL_ThreadID();
+  Atomics::barrier();
+  while (true) {
+    SDL_SemWait(available);
+    if (stopped) {
+      break;
+    }
+    Job* job = take(index);
+    if (job != NULL) {
+      execute(job);
+    }
+  }
+  return 0;
+}
+
+void Jobs::initialize(int n) {
+  if (!queues.empty()) {
+    return;
+  }
+  if (n < 0) {
+    n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  }
+  stopped = false;
+  available = SDL_CreateSemaphore(0);
+  workerIds.resize(n, 0);
+  for (int i = 0; i <= n; i++) {
+    queues.push_back(new JobQueue());
+  }
+  for (int i = 1; i <= n; i++) {
+    workers.push_back(SDL_CreateThread(work, (void*) (long) i));
+  }
+}
+
+void Jobs::dispose() {
+  stopped = true;
+  for (int i = 0; i < (int) workers.size(); i++) {
+    SDL_SemPost(available);
+  }
+  for (int i = 0; i < (int) workers.size(); i++) {
+    SDL_WaitThread(workers[i], NULL);
+  }
+  for (int i = 0; i < (int) queues.size(); i++) {
+    delete queues[i];
+  }
+  workers.clear();
+  workerIds.clear();
+  queues.clear();
+  if (available != NULL) {
+    SDL_DestroySemaphore(available);
+    available = NULL;
+  }
+}
+
+int Jobs::concurrency() {
+  return workers.size() + 1;
+}
+
+void Jobs::submit(Job& job) {
+  release(&job);
+}
+
+void Jobs::wait(Job& job) {
+  int index = queues.empty() ? 0 : queueIndex();
+  int spins = 0;
+  while (!job.done_) {
+    Job* j = queues.empty() ? NULL : take(index);
+    if (j != NULL) {
+      execute(j);
+      spins = 0;
+    } else {
+      SDL_Delay((spins++ < maxSpins) ? 0 : 1);
+    }
+  }
+  Atomics::barrier();
+}
+
+namespace {
+
+  class Range {
+  public:
+    void (*run)(void* data, int begin, int end);
+    void* data;
+    int begin;
+    int end;
+  };
+
+}
+
+static void runRange(void* data) {
+  Range* r = (Range*) data;
+  r->run(r->data, r->begin, r->end);
+}
+
+/*
+ * The first subrange is run by the calling thread while the rest are queued;
+ * if there's only one thread, the whole range is run directly.
+ */
+void Jobs::parallelFor(int begin, int end, int grain,
+    void (*run)(void* data, int begin, int end), void* data) {
+  if (grain < 1) {
+    grain = 1;
+  }
+  int n = (end - begin + grain - 1) / grain;
+  if ((n <= 1) || (concurrency() == 1)) {
+    if (end > begin) {
+      run(data, begin, end);
+    }
+    return;
+  }
+  std::vector<Range> ranges(n);
+  std::vector<Job> jobs(n);
+  for (int i = 0; i < n; i++) {
+    Range& r = ranges[i];
+    r.run = run;
+    r.data = data;
+    r.begin = begin + i * grain;
+    r.end = (r.begin + grain < end) ? r.begin + grain : end;
+    jobs[i] = Job(runRange, &r);
+  }
+  for (int i = n - 1; i > 0; i--) {
+    submit(jobs[i]);
+  }
+  runRange(&ranges[0]);
+  for (int i = 1; i < n; i++) {
+    wait(jobs[i]);
+  }
+}
@@ -0,0 +1,84 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_JOBS_H
+#define MBOSTOCK_JOBS_H
+
+#include <vector>
+
+namespace mbostock {
+
+  /**
+   * A unit of work for the job system: a function and its argument. A job may
+   * depend on other jobs, in which case it isn't run until they have all
+   * finished. Jobs are owned by the caller, and must outlive their execution
+   * (i.e., wait for a job before destroying it).
+   */
+  class Job {
+  public:
+    Job();
+    Job(void (*run)(void* data), void* data = NULL);
+
+    /**
+     * Declares that this job can't start until the specified job finishes.
+     * Dependencies must be declared before either job is submitted.
+     */
+    void dependOn(Job& job);
+
+    /** Returns true once the job has run. */
+    inline bool done() const { return done_; }
+
+  private:
+    void (*run_)(void* data);
+    void* data_;
+    volatile int dependencies_;
+    volatile bool done_;
+    std::vector<Job*> dependents_;
+
+    friend class Jobs;
+  };
+
+  /**
+   * A work-stealing job system, shared by the whole game. Each worker thread
+   * has its own queue of jobs; a worker takes the most recently submitted job
+   * from its own queue, and when that is empty steals the oldest job from
+   * another's. Threads other than the workers (such as the main thread) submit
+   * to a shared queue, and help run jobs while they wait, so that waiting never
+   * blocks a core and jobs may safely submit and wait for other jobs.
+   */
+  class Jobs {
+  public:
+
+    /**
+     * Starts the specified number of worker threads, or by default one fewer
+     * than the number of cores, since the waiting thread helps.
+     */
+    static void initialize(int workers = -1);
+    static void dispose();
+
+    /** Returns the number of threads that can run jobs at once. */
+    static int concurrency();
+
+    /** Queues the job to be run once its dependencies have finished. */
+    static void submit(Job& job);
+
+    /** Runs other jobs until the specified job has finished. */
+    static void wait(Job& job);
+
+    /**
+     * Calls run(data, i, j) for consecutive subranges [i, j) of [begin, end),
+     * each at most grain long, in parallel, and returns when all are done.
+     */
+    static void parallelFor(int begin, int end, int grain,
+        void (*run)(void* data, int begin, int end), void* data);
+
+  private:
+    Jobs();
+
+    static void release(Job* job);
+    static void execute(Job* job);
+    static int work(void* data);
+  };
+
+}
+
+#endif
@@ -101,6 +101,8 @@ void Light::disable() {
   enabled_ = false;
 }
 
+static const Lighting* lastLighting_ = NULL;
+
 Lighting::Lighting() {
   for (int i = 0; i < lights(); i++) {
     lights_[i].id_ = GL_LIGHT0 + i;
@@ -111,6 +113,13 @@ Lighting::Lighting() {
   lights_[0].enable();
 }
 
+/* A lighting allocated later at the same address must still be initialized. */
+Lighting::~Lighting() {
+  if (lastLighting_ == this) {
+    lastLighting_ = NULL;
+  }
+}
+
 void Lighting::setGlobalAmbient(float r, float g, float b, float a) {
   globalAmbient_[0] = r;
   globalAmbient_[1] = g;
@@ -118,8 +127,6 @@ void Lighting::setGlobalAmbient(float r, float g, float b, float a) {
   globalAmbient_[3] = a;
 }
 
-static const Lighting* lastLighting_ = NULL;
-
 void Lighting::initialize() const {
   lastLighting_ = this;
   glLightModelfv(GL_LIGHT_MODEL_AMBIENT, globalAmbient_);
@@ -48,6 +48,7 @@ namespace mbostock {
   class Lighting {
   public:
     Lighting();
+    ~Lighting();
 
     void initialize() const;
     void display() const;
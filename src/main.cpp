@@ -1,15 +1,23 @@
 // -*- C++ -*-
 
+#include <algorithm>
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
 #include <SDL/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <TinyXML/tinyxml.h>
+#include <string.h>
 
+#include "jobs.h"
+#include "material.h"
+#include "overlay.h"
+#include "pacer.h"
+#include "replay.h"
+#include "resource.h"
 #include "room.h"
 #include "shader.h"
 #include "sound.h"
+#include "telemetry.h"
 #include "texture.h"
 #include "world.h"
 #include "worlds.h"
@@ -23,11 +31,16 @@ static int screenHeight = 0;
 static const int defaultX = 50;
 static const int defaultY = 50;
 static const float kd = .060f; // frame-rate dependent
+static const uint32_t throttleMs = 16; // per quality level
 
 static bool run = true;
 static bool fullScreen = false;
 
 static World* world = NULL;
+static InputLog* inputLog = NULL;
+static const char* inputLogPath = NULL;
+static TelemetryRecorder* telemetry = NULL;
+static WorldWatcher* watcher = NULL;
 static bool wireframe = false;
 
 static Shader* shaders[] = {
@@ -39,10 +52,121 @@ static Shader* shaders[] = {
 static int shaderi = 0;
 static const int shadern = 3;
 
+static FramePacer pacer;
+static OverlayModel overlay;
+
+/**
+ * A step of startup that doesn't need a GL context, and so runs as a job while
+ * the window is created. Times are in milliseconds since startup.
+ */
+class StartupStage {
+public:
+  StartupStage(const char* name, void (*run)())
+      : name(name), run(run), begin(0), end(0) {
+  }
+
+  const char* name;
+  void (*run)();
+  Job job;
+  uint32_t begin;
+  uint32_t end;
+};
+
+static void openAudio();
+static void loadWorld();
+static void decodeTextures();
+static void readShaders();
+
+enum { AUDIO_STAGE, WORLD_STAGE, TEXTURE_STAGE, SHADER_STAGE };
+
+static StartupStage stages[] = {
+  StartupStage("audio", openAudio),
+  StartupStage("world", loadWorld),
+  StartupStage("textures", decodeTextures),
+  StartupStage("shaders", readShaders)
+};
+
+static const int stagen = 4;
+static uint32_t startTicks = 0;
+static uint32_t windowMs = 0;
+static uint32_t loadedMs = 0;
+static uint32_t firstFrameMs = 0;
+static bool loaded = false;
+static bool startupBenchmark = false;
+
 static Shader* shader() {
   return shaders[shaderi];
 }
 
+static void openAudio() {
+  Sounds::initialize();
+}
+
+/*
+ * The first room is built (and its music opened) as the world loads, which
+ * needs the audio device, so this follows openAudio.
+ */
+static void loadWorld() {
+  world = Worlds::fromFile("world.pbw");
+}
+
+/* These are the textures of the world's materials; this follows loadWorld. */
+static void decodeTextures() {
+  Textures::load();
+}
+
+static void readShaders() {
+  for (int i = 0; i < shadern; i++) {
+    shaders[i]->load();
+  }
+}
+
+static void runStage(void* data) {
+  StartupStage& s = *(StartupStage*) data;
+  s.begin = SDL_GetTicks() - startTicks;
+  s.run();
+  s.end = SDL_GetTicks() - startTicks;
+}
+
+/*
+ * Startup runs as a graph of jobs, so that opening the audio device, loading
+ * the world, decoding its textures and reading the shaders all overlap with
+ * creating the window. Only the GL work (uploading textures, compiling shaders
+ * and building display lists) is left to the main thread, which waits for the
+ * jobs once the window is open, helping to run them.
+ */
+static void beginStartup() {
+  for (int i = 0; i < stagen; i++) {
+    stages[i].job = Job(runStage, &stages[i]);
+  }
+  stages[WORLD_STAGE].job.dependOn(stages[AUDIO_STAGE].job);
+  stages[TEXTURE_STAGE].job.dependOn(stages[WORLD_STAGE].job);
+  for (int i = 0; i < stagen; i++) {
+    Jobs::submit(stages[i].job);
+  }
+}
+
+static void finishStartup() {
+  if (loaded) {
+    return;
+  }
+  windowMs = SDL_GetTicks() - startTicks;
+  for (int i = 0; i < stagen; i++) {
+    Jobs::wait(stages[i].job);
+  }
+  loadedMs = SDL_GetTicks() - startTicks;
+  loaded = true;
+}
+
+static void reportStartup() {
+  printf("first frame %u ms\n", firstFrameMs);
+  printf("  window open %u ms, loaded %u ms\n", windowMs, loadedMs);
+  for (int i = 0; i < stagen; i++) {
+    const StartupStage& s = stages[i];
+    printf("  %s %u-%u ms\n", s.name, s.begin, s.end);
+  }
+}
+
 static void resizeSurface(int width, int height) {
   uint32_t flags = SDL_OPENGL | SDL_RESIZABLE;
   if (fullScreen) {
@@ -64,20 +188,52 @@ static void resizeSurface(int width, int height) {
   glMatrixMode(GL_MODELVIEW);
   glClearColor(0.f, 0.f, 0.f, 0.f);
 
+  finishStartup();
   shader()->initialize();
   Textures::initialize();
   world->model().initialize();
 }
 
+static void displayOverlay() {
+  FrameHistogram& h = pacer.histogram();
+  overlay.clear();
+  overlay.print("frame %.1f ms, p50 %u, p95 %u, p99 %u, max %u (%u frames)",
+      h.mean(), h.percentile(.5f), h.percentile(.95f), h.percentile(.99f),
+      h.max(), h.count());
+  overlay.print("display %u ms, swap %u ms%s",
+      pacer.displayMillis(), pacer.swapMillis(),
+      pacer.synchronized() ? ", vsync" : "");
+  static const char* policies[] = { "drop", "dilate", "degrade" };
+  overlay.print("simulation x%.2f, %s%s, quality %d",
+      world->timeRatio(), policies[world->overloadPolicy()],
+      world->overloaded() ? ", overloaded" : "", world->quality());
+  overlay.print("textures %d of %d resident, %.1f MB; decoded %.1f MB",
+      Textures::residentCount(), Textures::count(),
+      Textures::residentBytes() / 1048576.f,
+      Textures::cacheBytes() / 1048576.f);
+  overlay.print("binds %d materials, %d textures; %d redundant skipped",
+      Materials::bindCount(), Materials::textureBindCount(),
+      Materials::redundantBindCount());
+  overlay.display();
+}
+
 static void handleDisplay() {
+  pacer.begin();
+
+  /* If the simulation is degrading quality, give it more of the CPU. */
+  int quality = world->quality();
+  pacer.throttle((quality == 0) ? 0 : (quality + 1) * throttleMs);
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glLoadIdentity();
+  Materials::clearCounts();
 
-  world->simulate();
+  WorldModel& model = world->model();
+  model.update();
 
-  const Vector& p = world->player().origin();
-  const Vector& min = world->room().cameraBounds().min();
-  const Vector& max = world->room().cameraBounds().max();
+  const Vector& p = model.playerOrigin();
+  const Vector& min = model.room().cameraBounds().min();
+  const Vector& max = model.room().cameraBounds().max();
 
   /* Interpolate the eye location. */
   Vector ee(p.x, p.y + 4.f, p.z + 6.f);
@@ -93,8 +249,34 @@ static void handleDisplay() {
             c.x, c.y, c.z,
             0.f, 1.f, 0.f);
 
-  shader()->display(world->model());
+  shader()->display(model);
+  if (world->debug()) {
+    displayOverlay();
+  }
+
+  pacer.swap();
   SDL_GL_SwapBuffers();
+  pacer.end();
+
+  if (firstFrameMs == 0) {
+    firstFrameMs = SDL_GetTicks() - startTicks;
+    if (startupBenchmark) {
+      reportStartup();
+      run = false;
+    }
+  }
+}
+
+static void toggleDebug() {
+  world->toggleDebug();
+  pacer.histogram().clear();
+}
+
+static void toggleOverloadPolicy() {
+  world->lock();
+  world->setOverloadPolicy((Simulation::OverloadPolicy)
+      ((world->overloadPolicy() + 1) % 3));
+  world->unlock();
 }
 
 static void toggleShader() {
@@ -113,59 +295,78 @@ static void toggleFullScreen() {
   }
 }
 
+/* Input is posted to the simulation thread rather than applied directly. */
+static void post(WorldEvent::Type type, Player::Direction d = Player::NONE) {
+  world->post(WorldEvent(type, d));
+}
+
 static void handleKeyDown(SDL_Event* event) {
   switch (event->key.keysym.sym) {
     case SDLK_LEFT: {
       if (event->key.keysym.mod & KMOD_META) {
-        world->previousRoom();
+        post(WorldEvent::PREVIOUS_ROOM);
       }
       break;
     }
     case SDLK_DOWN: {
       if (event->key.keysym.mod & KMOD_META) {
-        world->resetPlayer();
+        post(WorldEvent::RESET_PLAYER);
       }
       break;
     }
     case SDLK_RIGHT: {
       if (event->key.keysym.mod & KMOD_META) {
-        world->nextRoom();
+        post(WorldEvent::NEXT_ROOM);
       }
       break;
     }
-    case SDLK_a: world->player().move(Player::LEFT); break;
-    case SDLK_s: world->player().move(Player::BACKWARD); break;
-    case SDLK_d: world->player().move(Player::RIGHT); break;
-    case SDLK_w: world->player().move(Player::FORWARD); break;
+    case SDLK_a: post(WorldEvent::MOVE, Player::LEFT); break;
+    case SDLK_s: post(WorldEvent::MOVE, Player::BACKWARD); break;
+    case SDLK_d: post(WorldEvent::MOVE, Player::RIGHT); break;
+    case SDLK_w: post(WorldEvent::MOVE, Player::FORWARD); break;
   }
 }
 
 static void handleKeyUp(SDL_Event* event) {
   switch (event->key.keysym.sym) {
-    case SDLK_a: world->player().stop(Player::LEFT); break;
-    case SDLK_s: world->player().stop(Player::BACKWARD); break;
-    case SDLK_d: world->player().stop(Player::RIGHT); break;
-    case SDLK_w: world->player().stop(Player::FORWARD); break;
-    case SDLK_SPACE: world->togglePaused(); break;
+    case SDLK_a: post(WorldEvent::STOP, Player::LEFT); break;
+    case SDLK_s: post(WorldEvent::STOP, Player::BACKWARD); break;
+    case SDLK_d: post(WorldEvent::STOP, Player::RIGHT); break;
+    case SDLK_w: post(WorldEvent::STOP, Player::FORWARD); break;
+    case SDLK_SPACE: post(WorldEvent::TOGGLE_PAUSED); break;
+    case SDLK_r: post(WorldEvent::REWIND); break;
     case SDLK_q: if (!(event->key.keysym.mod & KMOD_META)) break;
     case SDLK_ESCAPE: run = false; break;
+    case SDLK_F8: toggleOverloadPolicy(); break;
     case SDLK_F9: toggleShader(); break;
-    case SDLK_F10: world->toggleDebug(); break;
+    case SDLK_F10: toggleDebug(); break;
     case SDLK_F11: toggleFullScreen(); break;
   }
 }
 
 static void handleQuit() {
-  Sounds::dispose();
+  world->stop();
+  if ((inputLog != NULL) && !inputLog->save(inputLogPath)) {
+    fprintf(stderr, "Error saving input log \"%s\"\n", inputLogPath);
+  }
+  if (telemetry != NULL) {
+    telemetry->close();
+    if (telemetry->dropped() > 0) {
+      fprintf(stderr, "Dropped %d telemetry samples\n", telemetry->dropped());
+    }
+  }
+  /* Deleting the world waits for rooms being built, which may open music. */
+  delete watcher;
   delete world;
+  Sounds::dispose();
+  Jobs::dispose();
   SDL_Quit();
 }
 
 static void eventLoop() {
   SDL_Event event;
   while (run) {
-    handleDisplay();
-    if (SDL_PollEvent(&event)) {
+    while (SDL_PollEvent(&event)) {
       switch (event.type) {
         case SDL_VIDEORESIZE: {
           resizeSurface(event.resize.w, event.resize.h);
@@ -185,14 +386,87 @@ static void eventLoop() {
         }
       }
     }
-    SDL_Delay(10);
+    if (watcher != NULL) {
+      watcher->poll();
+    }
+    handleDisplay();
   }
   handleQuit();
   return;
 }
 
+/*
+ * The input applied to the world can be recorded, for replay with the replay
+ * tool: --record path [--hash-every steps]. The player's position can be
+ * streamed to a file, for analysis with the telemetry tool: --telemetry path
+ * [--telemetry-every steps]. The number of trail points kept per room (shown
+ * in debug mode) can be set with --trail-points count, and the memory budget
+ * for loaded rooms with --room-budget megabytes; the memory kept for decoded
+ * textures is set with --texture-cache megabytes. With --startup-benchmark,
+ * the time to the first frame (and of each step of startup) is printed, and
+ * the game quits. With --watch path, the world's XML at the given path is
+ * reloaded whenever it is saved, rebuilding only the rooms that changed.
+ */
+static void parseArguments(int argc, char** argv) {
+  uint32_t hashInterval = 0;
+  const char* telemetryPath = NULL;
+  int telemetryInterval = 10;
+  const char* watchPath = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--startup-benchmark") == 0) {
+      startupBenchmark = true;
+    } else if (i == argc - 1) {
+      break;
+    } else if (strcmp(argv[i], "--record") == 0) {
+      inputLogPath = argv[++i];
+    } else if (strcmp(argv[i], "--hash-every") == 0) {
+      hashInterval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--telemetry") == 0) {
+      telemetryPath = argv[++i];
+    } else if (strcmp(argv[i], "--telemetry-every") == 0) {
+      telemetryInterval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--trail-points") == 0) {
+      world->rooms().setTrailCapacity(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--room-budget") == 0) {
+      world->rooms().setBudget((size_t) atoi(argv[++i]) << 20);
+    } else if (strcmp(argv[i], "--texture-cache") == 0) {
+      i++; // see parseStartupArguments
+    } else if (strcmp(argv[i], "--watch") == 0) {
+      watchPath = argv[++i];
+    }
+  }
+  if (inputLogPath != NULL) {
+    inputLog = new InputLog(hashInterval);
+    world->record(inputLog);
+  }
+  if (telemetryPath != NULL) {
+    telemetry = new TelemetryRecorder(std::max(1, telemetryInterval));
+    if (telemetry->open(telemetryPath)) {
+      world->setTelemetry(telemetry);
+    } else {
+      fprintf(stderr, "Error opening telemetry file \"%s\"\n", telemetryPath);
+    }
+  }
+  if (watchPath != NULL) {
+    watcher = new WorldWatcher(*world, watchPath);
+  }
+}
+
+/*
+ * The textures are decoded during startup, so the memory kept for them must be
+ * set before startup begins; the other arguments need the world.
+ */
+static void parseStartupArguments(int argc, char** argv) {
+  for (int i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "--texture-cache") == 0) {
+      Textures::setCacheBudget((size_t) atoi(argv[++i]) << 20);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+  startTicks = SDL_GetTicks();
 
   SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 1);
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
@@ -205,10 +479,14 @@ int main(int argc, char** argv) {
   SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
   SDL_WM_SetCaption("POLLY-B-GONE", "POLLY-B-GONE");
 
-  Sounds::initialize();
-  world = Worlds::fromFile("world.xml");
+  Resources::initialize();
+  Jobs::initialize();
+  parseStartupArguments(argc, argv);
+  beginStartup();
   // resizeSurface(defaultWidth, defaultHeight);
   toggleFullScreen();
+  parseArguments(argc, argv);
+  world->start();
   eventLoop();
 
   return 0;
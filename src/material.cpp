@@ -10,6 +10,13 @@
 
 using namespace mbostock;
 
+static std::vector<const Material*>* recorded = NULL;
+static bool tracking = false;
+static const Material* tracked = NULL;
+static int binds = 0;
+static int textureBinds = 0;
+static int redundantBinds = 0;
+
 Material::Material()
     : shininess_(0.f), texture_(NULL), slip_(0.f) {
   for (int i = 0; i < 4; i++) {
@@ -20,6 +27,12 @@ Material::Material()
   }
 }
 
+Material::~Material() {
+  if (texture_ != NULL) {
+    Textures::release(*texture_);
+  }
+}
+
 void Material::setAmbient(float r, float g, float b, float a) {
   ambient_[0] = r;
   ambient_[1] = g;
@@ -53,6 +66,9 @@ void Material::setShininess(float s) {
 }
 
 void Material::setTexture(const char* path) {
+  if (texture_ != NULL) {
+    Textures::release(*texture_);
+  }
   texture_ = (path == NULL) ? NULL : &(Textures::fromFile(path));
 }
 
@@ -60,17 +76,54 @@ void Material::setSlipAngle(float angle) {
   slip_ = cosf(angle * (2.f * M_PI / 360.f));
 }
 
+bool Material::blended() const {
+  return (texture_ != NULL) && texture_->alpha();
+}
+
+/*
+ * While tracking, a material sharing its texture with the bound material
+ * doesn't bind the texture again; nor does it change the blending, which
+ * depends only on the texture.
+ */
 void Material::bind() const {
+  bool track = tracking;
+  if (recorded != NULL) {
+    if (!recorded->empty() && (recorded->back() == this)) {
+      return;
+    }
+    recorded->push_back(this);
+    if (recorded->size() == 1) {
+      return;
+    }
+    track = false;
+  } else if (track && (tracked == this)) {
+    redundantBinds++;
+    return;
+  }
   glMaterialfv(GL_FRONT, GL_AMBIENT, ambient_);
   glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse_);
   glMaterialfv(GL_FRONT, GL_SPECULAR, specular_);
   glMaterialfv(GL_FRONT, GL_EMISSION, emission_);
   glMaterialf(GL_FRONT, GL_SHININESS, shininess_);
-  if (texture_ == NULL) {
-    glDisable(GL_BLEND);
-    glBindTexture(GL_TEXTURE_2D, GL_NONE);
-  } else {
-    texture_->bind();
+  bool texture = !track || (tracked == NULL) || (tracked->texture_ != texture_);
+  if (texture) {
+    if (texture_ == NULL) {
+      glDisable(GL_BLEND);
+      glBindTexture(GL_TEXTURE_2D, GL_NONE);
+    } else {
+      texture_->bind();
+    }
+  }
+  if (recorded == NULL) {
+    binds++;
+    if (texture) {
+      textureBinds++;
+    } else {
+      redundantBinds++;
+    }
+  }
+  if (track) {
+    tracked = this;
   }
 }
 
@@ -86,3 +139,41 @@ const Material& Materials::blank() {
   }
   return m;
 }
+
+void Materials::record(std::vector<const Material*>& bound) {
+  recorded = &bound;
+}
+
+void Materials::stop() {
+  recorded = NULL;
+}
+
+void Materials::track() {
+  tracking = true;
+  tracked = NULL;
+}
+
+void Materials::invalidate() {
+  tracked = NULL;
+}
+
+void Materials::untrack() {
+  tracking = false;
+  tracked = NULL;
+}
+
+int Materials::bindCount() {
+  return binds;
+}
+
+int Materials::textureBindCount() {
+  return textureBinds;
+}
+
+int Materials::redundantBindCount() {
+  return redundantBinds;
+}
+
+void Materials::clearCounts() {
+  binds = textureBinds = redundantBinds = 0;
+}
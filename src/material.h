@@ -3,6 +3,8 @@
 #ifndef MBOSTOCK_MATERIAL_H
 #define MBOSTOCK_MATERIAL_H
 
+#include <vector>
+
 namespace mbostock {
 
   class Texture;
@@ -10,6 +12,7 @@ namespace mbostock {
   class Material {
   public:
     Material();
+    ~Material();
 
     void setAmbient(float r, float g, float b, float a);
     void setDiffuse(float r, float g, float b, float a);
@@ -21,6 +24,11 @@ namespace mbostock {
     void setSlipAngle(float angle);
     inline float slip() const { return slip_; }
 
+    inline const Texture* texture() const { return texture_; }
+
+    /** Returns true if the material's texture has alpha, and so is blended. */
+    bool blended() const;
+
     void bind() const;
 
   private:
@@ -38,6 +46,35 @@ namespace mbostock {
   public:
     static const Material& blank();
 
+    /**
+     * Records the materials bound, in order, until stop is called, as when
+     * compiling a display list that is to be called with its first material
+     * already bound. While recording, the first material isn't applied, nor is
+     * a material bound again while already bound.
+     */
+    static void record(std::vector<const Material*>& bound);
+    static void stop();
+
+    /**
+     * Tracks the material bound until untrack is called, so that binding it
+     * again is skipped, as is binding the texture of the material bound. If
+     * anything else changes the material or texture (such as calling a
+     * display list that binds materials), it must call invalidate.
+     */
+    static void track();
+    static void invalidate();
+    static void untrack();
+
+    /**
+     * The number of materials and textures bound, and of binds skipped as
+     * redundant while tracking, since the counts were last cleared. Binds
+     * compiled into display lists aren't counted.
+     */
+    static int bindCount();
+    static int textureBindCount();
+    static int redundantBindCount();
+    static void clearCounts();
+
   private:
     Materials();
   };
@@ -0,0 +1,202 @@
+// -*- C++ -*-
+
+#include <OpenGL/gl.h>
+#include <algorithm>
+#include <stddef.h>
+
+#include "material.h"
+#include "mesh.h"
+
+using namespace mbostock;
+
+class ImmediateFaces : public Faces {
+public:
+  virtual void bind(const Material& m) {
+    m.bind();
+  }
+
+  virtual void frontFace(GLenum mode) {
+    glFrontFace(mode);
+  }
+
+  virtual void begin(GLenum mode) {
+    glBegin(mode);
+  }
+
+  virtual void normal(const Vector& n) {
+    glNormal3f(n.x, n.y, n.z);
+  }
+
+  virtual void texCoord(float u, float v) {
+    glTexCoord2f(u, v);
+  }
+
+  virtual void vertex(const Vector& x) {
+    glVertex3f(x.x, x.y, x.z);
+  }
+
+  virtual void end() {
+    glEnd();
+  }
+};
+
+Faces& Faces::immediate() {
+  static ImmediateFaces faces;
+  return faces;
+}
+
+Mesh::Mesh()
+    : batch_(-1), mode_(GL_TRIANGLES), first_(0), clockwise_(false),
+      vertexBuffer_(GL_NONE), indexBuffer_(GL_NONE) {
+  vertex_.t[0] = vertex_.t[1] = 0.f;
+  vertex_.n[0] = vertex_.n[1] = vertex_.n[2] = 0.f;
+  vertex_.x[0] = vertex_.x[1] = vertex_.x[2] = 0.f;
+}
+
+Mesh::~Mesh() {
+  clear();
+}
+
+void Mesh::clear() {
+  if (vertexBuffer_ != GL_NONE) {
+    glDeleteBuffers(1, &vertexBuffer_);
+    glDeleteBuffers(1, &indexBuffer_);
+    vertexBuffer_ = indexBuffer_ = GL_NONE;
+  }
+  vertices_.clear();
+  batches_.clear();
+  batch_ = -1;
+  first_ = 0;
+  clockwise_ = false;
+}
+
+void Mesh::bind(const Material& m) {
+  for (batch_ = 0; batch_ < (int) batches_.size(); batch_++) {
+    if (batches_[batch_].material == &m) {
+      return;
+    }
+  }
+  batches_.push_back(Batch());
+  Batch& b = batches_.back();
+  b.material = &m;
+  b.blended = false;
+  b.offset = b.count = 0;
+}
+
+void Mesh::frontFace(GLenum mode) {
+  clockwise_ = (mode == GL_CW);
+}
+
+void Mesh::begin(GLenum mode) {
+  if (batch_ < 0) {
+    bind(Materials::blank());
+  }
+  mode_ = mode;
+  first_ = vertices_.size();
+}
+
+void Mesh::normal(const Vector& n) {
+  vertex_.n[0] = n.x;
+  vertex_.n[1] = n.y;
+  vertex_.n[2] = n.z;
+}
+
+void Mesh::texCoord(float u, float v) {
+  vertex_.t[0] = u;
+  vertex_.t[1] = v;
+}
+
+/*
+ * Once a primitive's last vertex is added, it is split into triangles in the
+ * current batch. A quad is split along the diagonal between its second and
+ * fourth vertices, as GL splits it, so that the lighting computed at each
+ * vertex is interpolated across it just as before.
+ */
+void Mesh::vertex(const Vector& x) {
+  vertex_.x[0] = x.x;
+  vertex_.x[1] = x.y;
+  vertex_.x[2] = x.z;
+  vertices_.push_back(vertex_);
+  int n = (mode_ == GL_QUADS) ? 4 : 3;
+  if ((int) vertices_.size() - first_ < n) {
+    return;
+  }
+  static const int quad[] = { 0, 1, 3, 1, 2, 3 };
+  static const int triangle[] = { 0, 1, 2 };
+  const int* order = (n == 4) ? quad : triangle;
+  int count = (n == 4) ? 6 : 3;
+  std::vector<GLuint>& indices = batches_[batch_].indices;
+  for (int i = 0; i < count; i += 3) {
+    indices.push_back(first_ + order[i]);
+    indices.push_back(first_ + order[i + (clockwise_ ? 2 : 1)]);
+    indices.push_back(first_ + order[i + (clockwise_ ? 1 : 2)]);
+  }
+  first_ = vertices_.size();
+}
+
+void Mesh::end() {
+  first_ = vertices_.size();
+}
+
+void Mesh::initialize() {
+  std::vector<Batch>::iterator b;
+  for (b = batches_.begin(); b != batches_.end(); b++) {
+    b->material->bind();
+    b->blended = b->material->blended();
+  }
+  std::stable_sort(batches_.begin(), batches_.end());
+
+  std::vector<GLuint> indices;
+  for (b = batches_.begin(); b != batches_.end(); b++) {
+    b->offset = indices.size();
+    b->count = b->indices.size();
+    indices.insert(indices.end(), b->indices.begin(), b->indices.end());
+    std::vector<GLuint>().swap(b->indices);
+  }
+  if (indices.empty()) {
+    batches_.clear();
+    return;
+  }
+
+  glGenBuffers(1, &vertexBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(MeshVertex),
+      &vertices_[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+  glGenBuffers(1, &indexBuffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+      &indices[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_NONE);
+  std::vector<MeshVertex>().swap(vertices_);
+}
+
+void Mesh::display(bool blended) {
+  if (vertexBuffer_ == GL_NONE) {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glTexCoordPointer(2, GL_FLOAT, sizeof(MeshVertex),
+      (const GLvoid*) offsetof(MeshVertex, t));
+  glNormalPointer(GL_FLOAT, sizeof(MeshVertex),
+      (const GLvoid*) offsetof(MeshVertex, n));
+  glVertexPointer(3, GL_FLOAT, sizeof(MeshVertex),
+      (const GLvoid*) offsetof(MeshVertex, x));
+  std::vector<Batch>::const_iterator b;
+  for (b = batches_.begin(); b != batches_.end(); b++) {
+    if ((b->blended == blended) && (b->count > 0)) {
+      b->material->bind();
+      glDrawElements(GL_TRIANGLES, b->count, GL_UNSIGNED_INT,
+          (const GLvoid*) (b->offset * sizeof(GLuint)));
+    }
+  }
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_NONE);
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+}
@@ -0,0 +1,112 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_MESH_H
+#define MBOSTOCK_MESH_H
+
+#include <OpenGL/gl.h>
+#include <vector>
+
+#include "physics/vector.h"
+
+namespace mbostock {
+
+  class Material;
+
+  /**
+   * Receives the faces of a model, in the manner of glBegin and glEnd. Models
+   * built of planar faces emit them through this interface, so that the same
+   * code can either draw them immediately or bake them into a Mesh. Only
+   * GL_QUADS and GL_TRIANGLES are supported.
+   */
+  class Faces {
+  public:
+    virtual ~Faces() {}
+
+    virtual void bind(const Material& m) = 0;
+    virtual void frontFace(GLenum mode) = 0;
+    virtual void begin(GLenum mode) = 0;
+    virtual void normal(const Vector& n) = 0;
+    virtual void texCoord(float u, float v) = 0;
+    virtual void vertex(const Vector& x) = 0;
+    virtual void end() = 0;
+
+    /** Returns faces that are drawn immediately, with the equivalent GL. */
+    static Faces& immediate();
+  };
+
+  /** An interleaved vertex: texture coordinate, normal and position. */
+  class MeshVertex {
+  public:
+    float t[2];
+    float n[3];
+    float x[3];
+  };
+
+  /**
+   * Faces baked into a vertex buffer and an index buffer, as triangles grouped
+   * into one batch per material, each drawn with a single call. Faces wound
+   * clockwise (as with glFrontFace(GL_CW)) are reversed as they are added.
+   * The batches are in order of first appearance, except that those with
+   * blended materials come last, so that they can be drawn after everything
+   * they might cover.
+   */
+  class Mesh : public Faces {
+  public:
+    Mesh();
+    virtual ~Mesh();
+
+    virtual void bind(const Material& m);
+    virtual void frontFace(GLenum mode);
+    virtual void begin(GLenum mode);
+    virtual void normal(const Vector& n);
+    virtual void texCoord(float u, float v);
+    virtual void vertex(const Vector& x);
+    virtual void end();
+
+    /**
+     * Uploads the faces added so far into buffers, discarding the copies in
+     * memory. Each batch's material is bound once, so that its texture is
+     * recorded if a TextureSet is recording.
+     */
+    void initialize();
+
+    /** Draws either the batches with blended materials, or the others. */
+    void display(bool blended);
+
+    /** Deletes the buffers and any faces added. */
+    void clear();
+
+    inline bool empty() const { return batches_.empty(); }
+
+  private:
+    class Batch {
+    public:
+      const Material* material;
+      bool blended;
+      std::vector<GLuint> indices;
+      int offset;
+      int count;
+
+      inline bool operator<(const Batch& b) const {
+        return !blended && b.blended;
+      }
+    };
+
+    Mesh(const Mesh& m);
+    Mesh& operator=(const Mesh& m);
+
+    std::vector<MeshVertex> vertices_;
+    std::vector<Batch> batches_;
+    MeshVertex vertex_;
+    int batch_;
+    GLenum mode_;
+    int first_;
+    bool clockwise_;
+
+    GLuint vertexBuffer_;
+    GLuint indexBuffer_;
+  };
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 
 #include "material.h"
+#include "mesh.h"
 #include "model.h"
 
 using namespace mbostock;
@@ -28,70 +29,83 @@ const Material& WedgeModel::topMaterial() const {
   return (topMaterial_ == NULL) ? *material_ : *topMaterial_;
 }
 
+const Material* WedgeModel::firstMaterial() const {
+  return &topMaterial();
+}
+
 void WedgeModel::display() {
+  display(Faces::immediate());
+}
+
+bool WedgeModel::bake(Mesh& mesh) {
+  display(mesh);
+  return true;
+}
+
+void WedgeModel::display(Faces& f) {
   Vector size = wedge_.x2() - wedge_.x0();
 
   /* Top. */
-  ((topMaterial_ != NULL) ? topMaterial_ : material_)->bind();
-  glBegin(GL_QUADS);
-  glNormalv(wedge_.top().normal());
-  glTexCoord2f(0, 0);
-  glVertexv(wedge_.x0());
-  glTexCoord2f(sqrtf(size.x * size.x + size.y * size.y), 0);
-  glVertexv(wedge_.x1());
-  glTexCoord2f(sqrtf(size.x * size.x + size.y * size.y), size.z);
-  glVertexv(wedge_.x2());
-  glTexCoord2f(0, size.z);
-  glVertexv(wedge_.x3());
-  glEnd();
-
-  material_->bind();
-  glBegin(GL_QUADS);
+  f.bind(topMaterial());
+  f.begin(GL_QUADS);
+  f.normal(wedge_.top().normal());
+  f.texCoord(0, 0);
+  f.vertex(wedge_.x0());
+  f.texCoord(sqrtf(size.x * size.x + size.y * size.y), 0);
+  f.vertex(wedge_.x1());
+  f.texCoord(sqrtf(size.x * size.x + size.y * size.y), size.z);
+  f.vertex(wedge_.x2());
+  f.texCoord(0, size.z);
+  f.vertex(wedge_.x3());
+  f.end();
+
+  f.bind(*material_);
+  f.begin(GL_QUADS);
 
   /* Right. */
-  glNormalv(wedge_.right().normal());
-  glTexCoord2f(size.z, size.y);
-  glVertexv(wedge_.x2());
-  glTexCoord2f(0, size.y);
-  glVertexv(wedge_.x1());
-  glTexCoord2f(0, 0);
-  glVertexv(wedge_.x4());
-  glTexCoord2f(size.z, 0);
-  glVertexv(wedge_.x5());
+  f.normal(wedge_.right().normal());
+  f.texCoord(size.z, size.y);
+  f.vertex(wedge_.x2());
+  f.texCoord(0, size.y);
+  f.vertex(wedge_.x1());
+  f.texCoord(0, 0);
+  f.vertex(wedge_.x4());
+  f.texCoord(size.z, 0);
+  f.vertex(wedge_.x5());
 
   /* Bottom. */
-  glNormalv(wedge_.bottom().normal());
-  glTexCoord2f(0, 0);
-  glVertexv(wedge_.x0());
-  glTexCoord2f(0, size.z);
-  glVertexv(wedge_.x3());
-  glTexCoord2f(size.x, size.z);
-  glVertexv(wedge_.x5());
-  glTexCoord2f(size.x, 0);
-  glVertexv(wedge_.x4());
-
-  glEnd();
-  glBegin(GL_TRIANGLES);
+  f.normal(wedge_.bottom().normal());
+  f.texCoord(0, 0);
+  f.vertex(wedge_.x0());
+  f.texCoord(0, size.z);
+  f.vertex(wedge_.x3());
+  f.texCoord(size.x, size.z);
+  f.vertex(wedge_.x5());
+  f.texCoord(size.x, 0);
+  f.vertex(wedge_.x4());
+
+  f.end();
+  f.begin(GL_TRIANGLES);
 
   /* Front. */
-  glNormalv(wedge_.front().normal());
-  glTexCoord2f(size.x, size.y);
-  glVertexv(wedge_.x1());
-  glTexCoord2f(0, 0);
-  glVertexv(wedge_.x0());
-  glTexCoord2f(size.x, 0);
-  glVertexv(wedge_.x4());
+  f.normal(wedge_.front().normal());
+  f.texCoord(size.x, size.y);
+  f.vertex(wedge_.x1());
+  f.texCoord(0, 0);
+  f.vertex(wedge_.x0());
+  f.texCoord(size.x, 0);
+  f.vertex(wedge_.x4());
 
   /* Back. */
-  glNormalv(wedge_.back().normal());
-  glTexCoord2f(0, 0);
-  glVertexv(wedge_.x3());
-  glTexCoord2f(size.x, size.y);
-  glVertexv(wedge_.x2());
-  glTexCoord2f(size.x, 0);
-  glVertexv(wedge_.x5());
+  f.normal(wedge_.back().normal());
+  f.texCoord(0, 0);
+  f.vertex(wedge_.x3());
+  f.texCoord(size.x, size.y);
+  f.vertex(wedge_.x2());
+  f.texCoord(size.x, 0);
+  f.vertex(wedge_.x5());
 
-  glEnd();
+  f.end();
 }
 
 AxisAlignedBoxModel::AxisAlignedBoxModel(const AxisAlignedBox& box)
@@ -111,7 +125,20 @@ const Material& AxisAlignedBoxModel::topMaterial() const {
   return (topMaterial_ == NULL) ? *material_ : *topMaterial_;
 }
 
+const Material* AxisAlignedBoxModel::firstMaterial() const {
+  return &topMaterial();
+}
+
 void AxisAlignedBoxModel::display() {
+  display(Faces::immediate());
+}
+
+bool AxisAlignedBoxModel::bake(Mesh& mesh) {
+  display(mesh);
+  return true;
+}
+
+void AxisAlignedBoxModel::display(Faces& f) {
   Vector size = box_.x7() - box_.x0();
   Vector t4, t5, t6, t7;
   switch (orientation_) {
@@ -152,78 +179,78 @@ void AxisAlignedBoxModel::display() {
   Vector t3 = t6 + y;
 
   /* Top. */
-  ((topMaterial_ != NULL) ? topMaterial_ : material_)->bind();
-  glBegin(GL_QUADS);
-  glNormal3f(0.f, 1.f, 0.f);
-  glTexCoord2f(t4.x, t4.z);
-  glVertexv(box_.x4());
-  glTexCoord2f(t5.x, t5.z);
-  glVertexv(box_.x5());
-  glTexCoord2f(t6.x, t6.z);
-  glVertexv(box_.x6());
-  glTexCoord2f(t7.x, t7.z);
-  glVertexv(box_.x7());
-  glEnd();
-
-  material_->bind();
-  glBegin(GL_QUADS);
+  f.bind(topMaterial());
+  f.begin(GL_QUADS);
+  f.normal(Vector(0.f, 1.f, 0.f));
+  f.texCoord(t4.x, t4.z);
+  f.vertex(box_.x4());
+  f.texCoord(t5.x, t5.z);
+  f.vertex(box_.x5());
+  f.texCoord(t6.x, t6.z);
+  f.vertex(box_.x6());
+  f.texCoord(t7.x, t7.z);
+  f.vertex(box_.x7());
+  f.end();
+
+  f.bind(*material_);
+  f.begin(GL_QUADS);
 
   /* Bottom. */
-  glNormal3f(0.f, -1.f, 0.f);
-  glTexCoord2f(t0.x, t0.z);
-  glVertexv(box_.x0());
-  glTexCoord2f(t1.x, t1.z);
-  glVertexv(box_.x1());
-  glTexCoord2f(t2.x, t2.z);
-  glVertexv(box_.x2());
-  glTexCoord2f(t3.x, t3.z);
-  glVertexv(box_.x3());
+  f.normal(Vector(0.f, -1.f, 0.f));
+  f.texCoord(t0.x, t0.z);
+  f.vertex(box_.x0());
+  f.texCoord(t1.x, t1.z);
+  f.vertex(box_.x1());
+  f.texCoord(t2.x, t2.z);
+  f.vertex(box_.x2());
+  f.texCoord(t3.x, t3.z);
+  f.vertex(box_.x3());
 
   /* Front. */
-  glNormal3f(0.f, 0.f, 1.f);
-  glTexCoord2f(t7.x, t7.y);
-  glVertexv(box_.x7());
-  glTexCoord2f(t6.x, t6.y);
-  glVertexv(box_.x6());
-  glTexCoord2f(t3.x, t3.y);
-  glVertexv(box_.x3());
-  glTexCoord2f(t2.x, t2.y);
-  glVertexv(box_.x2());
+  f.normal(Vector(0.f, 0.f, 1.f));
+  f.texCoord(t7.x, t7.y);
+  f.vertex(box_.x7());
+  f.texCoord(t6.x, t6.y);
+  f.vertex(box_.x6());
+  f.texCoord(t3.x, t3.y);
+  f.vertex(box_.x3());
+  f.texCoord(t2.x, t2.y);
+  f.vertex(box_.x2());
 
   /* Back. */
-  glNormal3f(0.f, 0.f, -1.f);
-  glTexCoord2f(t5.x, t5.y);
-  glVertexv(box_.x5());
-  glTexCoord2f(t4.x, t4.y);
-  glVertexv(box_.x4());
-  glTexCoord2f(t1.x, t1.y);
-  glVertexv(box_.x1());
-  glTexCoord2f(t0.x, t0.y);
-  glVertexv(box_.x0());
+  f.normal(Vector(0.f, 0.f, -1.f));
+  f.texCoord(t5.x, t5.y);
+  f.vertex(box_.x5());
+  f.texCoord(t4.x, t4.y);
+  f.vertex(box_.x4());
+  f.texCoord(t1.x, t1.y);
+  f.vertex(box_.x1());
+  f.texCoord(t0.x, t0.y);
+  f.vertex(box_.x0());
 
   /* Left. */
-  glNormal3f(-1.f, 0.f, 0.f);
-  glTexCoord2f(t6.z, t6.y);
-  glVertexv(box_.x6());
-  glTexCoord2f(t5.z, t5.y);
-  glVertexv(box_.x5());
-  glTexCoord2f(t0.z, t0.y);
-  glVertexv(box_.x0());
-  glTexCoord2f(t3.z, t3.y);
-  glVertexv(box_.x3());
+  f.normal(Vector(-1.f, 0.f, 0.f));
+  f.texCoord(t6.z, t6.y);
+  f.vertex(box_.x6());
+  f.texCoord(t5.z, t5.y);
+  f.vertex(box_.x5());
+  f.texCoord(t0.z, t0.y);
+  f.vertex(box_.x0());
+  f.texCoord(t3.z, t3.y);
+  f.vertex(box_.x3());
 
   /* Right. */
-  glNormal3f(1.f, 0.f, 0.f);
-  glTexCoord2f(t4.z, t4.y);
-  glVertexv(box_.x4());
-  glTexCoord2f(t7.z, t7.y);
-  glVertexv(box_.x7());
-  glTexCoord2f(t2.z, t2.y);
-  glVertexv(box_.x2());
-  glTexCoord2f(t1.z, t1.y);
-  glVertexv(box_.x1());
+  f.normal(Vector(1.f, 0.f, 0.f));
+  f.texCoord(t4.z, t4.y);
+  f.vertex(box_.x4());
+  f.texCoord(t7.z, t7.y);
+  f.vertex(box_.x7());
+  f.texCoord(t2.z, t2.y);
+  f.vertex(box_.x2());
+  f.texCoord(t1.z, t1.y);
+  f.vertex(box_.x1());
 
-  glEnd();
+  f.end();
 }
 
 void AxisAlignedBoxModel::setTexOffset(float u, float v) {
@@ -251,7 +278,20 @@ const Material& BoxModel::topMaterial() const {
   return (topMaterial_ == NULL) ? *material_ : *topMaterial_;
 }
 
+const Material* BoxModel::firstMaterial() const {
+  return &topMaterial();
+}
+
 void BoxModel::display() {
+  display(Faces::immediate());
+}
+
+bool BoxModel::bake(Mesh& mesh) {
+  display(mesh);
+  return true;
+}
+
+void BoxModel::display(Faces& f) {
   Vector size(
       (box_.x1() - box_.x0()).length(),
       (box_.x5() - box_.x0()).length(),
@@ -269,78 +309,78 @@ void BoxModel::display() {
   Vector t3 = t6 + y;
 
   /* Top. */
-  ((topMaterial_ != NULL) ? topMaterial_ : material_)->bind();
-  glBegin(GL_QUADS);
-  glNormalv(box_.top().normal());
-  glTexCoord2f(t4.x, t4.z);
-  glVertexv(box_.x4());
-  glTexCoord2f(t5.x, t5.z);
-  glVertexv(box_.x5());
-  glTexCoord2f(t6.x, t6.z);
-  glVertexv(box_.x6());
-  glTexCoord2f(t7.x, t7.z);
-  glVertexv(box_.x7());
-  glEnd();
-
-  material_->bind();
-  glBegin(GL_QUADS);
+  f.bind(topMaterial());
+  f.begin(GL_QUADS);
+  f.normal(box_.top().normal());
+  f.texCoord(t4.x, t4.z);
+  f.vertex(box_.x4());
+  f.texCoord(t5.x, t5.z);
+  f.vertex(box_.x5());
+  f.texCoord(t6.x, t6.z);
+  f.vertex(box_.x6());
+  f.texCoord(t7.x, t7.z);
+  f.vertex(box_.x7());
+  f.end();
+
+  f.bind(*material_);
+  f.begin(GL_QUADS);
 
   /* Bottom. */
-  glNormalv(box_.bottom().normal());
-  glTexCoord2f(t0.x, t0.z);
-  glVertexv(box_.x0());
-  glTexCoord2f(t1.x, t1.z);
-  glVertexv(box_.x1());
-  glTexCoord2f(t2.x, t2.z);
-  glVertexv(box_.x2());
-  glTexCoord2f(t3.x, t3.z);
-  glVertexv(box_.x3());
+  f.normal(box_.bottom().normal());
+  f.texCoord(t0.x, t0.z);
+  f.vertex(box_.x0());
+  f.texCoord(t1.x, t1.z);
+  f.vertex(box_.x1());
+  f.texCoord(t2.x, t2.z);
+  f.vertex(box_.x2());
+  f.texCoord(t3.x, t3.z);
+  f.vertex(box_.x3());
 
   /* Front. */
-  glNormalv(box_.front().normal());
-  glTexCoord2f(t7.x, t7.y);
-  glVertexv(box_.x7());
-  glTexCoord2f(t6.x, t6.y);
-  glVertexv(box_.x6());
-  glTexCoord2f(t3.x, t3.y);
-  glVertexv(box_.x3());
-  glTexCoord2f(t2.x, t2.y);
-  glVertexv(box_.x2());
+  f.normal(box_.front().normal());
+  f.texCoord(t7.x, t7.y);
+  f.vertex(box_.x7());
+  f.texCoord(t6.x, t6.y);
+  f.vertex(box_.x6());
+  f.texCoord(t3.x, t3.y);
+  f.vertex(box_.x3());
+  f.texCoord(t2.x, t2.y);
+  f.vertex(box_.x2());
 
   /* Back. */
-  glNormalv(box_.back().normal());
-  glTexCoord2f(t5.x, t5.y);
-  glVertexv(box_.x5());
-  glTexCoord2f(t4.x, t4.y);
-  glVertexv(box_.x4());
-  glTexCoord2f(t1.x, t1.y);
-  glVertexv(box_.x1());
-  glTexCoord2f(t0.x, t0.y);
-  glVertexv(box_.x0());
+  f.normal(box_.back().normal());
+  f.texCoord(t5.x, t5.y);
+  f.vertex(box_.x5());
+  f.texCoord(t4.x, t4.y);
+  f.vertex(box_.x4());
+  f.texCoord(t1.x, t1.y);
+  f.vertex(box_.x1());
+  f.texCoord(t0.x, t0.y);
+  f.vertex(box_.x0());
 
   /* Left. */
-  glNormalv(box_.left().normal());
-  glTexCoord2f(t6.z, t6.y);
-  glVertexv(box_.x6());
-  glTexCoord2f(t5.z, t5.y);
-  glVertexv(box_.x5());
-  glTexCoord2f(t0.z, t0.y);
-  glVertexv(box_.x0());
-  glTexCoord2f(t3.z, t3.y);
-  glVertexv(box_.x3());
+  f.normal(box_.left().normal());
+  f.texCoord(t6.z, t6.y);
+  f.vertex(box_.x6());
+  f.texCoord(t5.z, t5.y);
+  f.vertex(box_.x5());
+  f.texCoord(t0.z, t0.y);
+  f.vertex(box_.x0());
+  f.texCoord(t3.z, t3.y);
+  f.vertex(box_.x3());
 
   /* Right. */
-  glNormalv(box_.right().normal());
-  glTexCoord2f(t4.z, t4.y);
-  glVertexv(box_.x4());
-  glTexCoord2f(t7.z, t7.y);
-  glVertexv(box_.x7());
-  glTexCoord2f(t2.z, t2.y);
-  glVertexv(box_.x2());
-  glTexCoord2f(t1.z, t1.y);
-  glVertexv(box_.x1());
+  f.normal(box_.right().normal());
+  f.texCoord(t4.z, t4.y);
+  f.vertex(box_.x4());
+  f.texCoord(t7.z, t7.y);
+  f.vertex(box_.x7());
+  f.texCoord(t2.z, t2.y);
+  f.vertex(box_.x2());
+  f.texCoord(t1.z, t1.y);
+  f.vertex(box_.x1());
 
-  glEnd();
+  f.end();
 }
 
 QuadModel::QuadModel(const Quad& quad)
@@ -372,26 +412,39 @@ void QuadModel::setTexCoords(const Vector& t0, const Vector& t1,
   texCoords_[3] = t3;
 }
 
+const Material* QuadModel::firstMaterial() const {
+  return material_;
+}
+
 void QuadModel::display() {
-  material_->bind();
-  displaySide(true);
-  glFrontFace(GL_CW);
-  displaySide(false);
-  glFrontFace(GL_CCW);
-}
-
-void QuadModel::displaySide(bool front) {
-  glBegin(GL_QUADS);
-  glNormalv(front ? quad_.normal() : -quad_.normal());
-  glTexCoordv(texCoords_[0]);
-  glVertexv(quad_.x0());
-  glTexCoordv(texCoords_[1]);
-  glVertexv(quad_.x1());
-  glTexCoordv(texCoords_[2]);
-  glVertexv(quad_.x2());
-  glTexCoordv(texCoords_[3]);
-  glVertexv(quad_.x3());
-  glEnd();
+  display(Faces::immediate());
+}
+
+bool QuadModel::bake(Mesh& mesh) {
+  display(mesh);
+  return true;
+}
+
+void QuadModel::display(Faces& f) {
+  f.bind(*material_);
+  displaySide(f, true);
+  f.frontFace(GL_CW);
+  displaySide(f, false);
+  f.frontFace(GL_CCW);
+}
+
+void QuadModel::displaySide(Faces& f, bool front) {
+  f.begin(GL_QUADS);
+  f.normal(front ? quad_.normal() : -quad_.normal());
+  f.texCoord(texCoords_[0].x, texCoords_[0].y);
+  f.vertex(quad_.x0());
+  f.texCoord(texCoords_[1].x, texCoords_[1].y);
+  f.vertex(quad_.x1());
+  f.texCoord(texCoords_[2].x, texCoords_[2].y);
+  f.vertex(quad_.x2());
+  f.texCoord(texCoords_[3].x, texCoords_[3].y);
+  f.vertex(quad_.x3());
+  f.end();
 }
 
 TriangleModel::TriangleModel(const Triangle& triangle)
@@ -414,24 +467,37 @@ void TriangleModel::setTexCoords(const Vector& t0, const Vector& t1,
   texCoords_[2] = t2;
 }
 
+const Material* TriangleModel::firstMaterial() const {
+  return material_;
+}
+
 void TriangleModel::display() {
-  material_->bind();
-  displaySide(true);
-  glFrontFace(GL_CW);
-  displaySide(false);
-  glFrontFace(GL_CCW);
+  display(Faces::immediate());
+}
+
+bool TriangleModel::bake(Mesh& mesh) {
+  display(mesh);
+  return true;
 }
 
-void TriangleModel::displaySide(bool front) {
-  glBegin(GL_TRIANGLES);
-  glNormalv(front ? triangle_.normal() : -triangle_.normal());
-  glTexCoordv(texCoords_[0]);
-  glVertexv(triangle_.x0());
-  glTexCoordv(texCoords_[1]);
-  glVertexv(triangle_.x1());
-  glTexCoordv(texCoords_[2]);
-  glVertexv(triangle_.x2());
-  glEnd();
+void TriangleModel::display(Faces& f) {
+  f.bind(*material_);
+  displaySide(f, true);
+  f.frontFace(GL_CW);
+  displaySide(f, false);
+  f.frontFace(GL_CCW);
+}
+
+void TriangleModel::displaySide(Faces& f, bool front) {
+  f.begin(GL_TRIANGLES);
+  f.normal(front ? triangle_.normal() : -triangle_.normal());
+  f.texCoord(texCoords_[0].x, texCoords_[0].y);
+  f.vertex(triangle_.x0());
+  f.texCoord(texCoords_[1].x, texCoords_[1].y);
+  f.vertex(triangle_.x1());
+  f.texCoord(texCoords_[2].x, texCoords_[2].y);
+  f.vertex(triangle_.x2());
+  f.end();
 }
 
 CylinderModel::CylinderModel(const Cylinder& cylinder, const Vector& y)
@@ -479,6 +545,10 @@ const Material& CylinderModel::capMaterial() const {
   return (capMaterial_ == NULL) ? *material_ : *capMaterial_;
 }
 
+const Material* CylinderModel::firstMaterial() const {
+  return material_;
+}
+
 void CylinderModel::display() {
   float r = cylinder_.radius();
   float l = cylinder_.length();
@@ -523,6 +593,10 @@ void SphereModel::setMaterial(const Material& m) {
   material_ = &m;
 }
 
+const Material* SphereModel::firstMaterial() const {
+  return material_;
+}
+
 void SphereModel::display() {
   float r2 = sphere_.radius() * sphere_.radius();
   int slices = std::max(16, (int) roundf(32 * r2));
@@ -581,6 +655,11 @@ public:
 
   virtual void display() {
     glCallList(displayList_);
+    Materials::invalidate();
+  }
+
+  virtual const Material* firstMaterial() const {
+    return model_->firstMaterial();
   }
 
 private:
@@ -10,7 +10,9 @@
 
 namespace mbostock {
 
+  class Faces;
   class Material;
+  class Mesh;
 
   /**
    * A generic base class for OpenGL models. Provides a set of convenience
@@ -30,6 +32,20 @@ namespace mbostock {
     /** Displays the model. */
     virtual void display() = 0;
 
+    /**
+     * Adds the model's faces to the specified mesh, returning true; or returns
+     * false if the model can't be baked, as when it's drawn by GLU, in which
+     * case it must be displayed instead. Only models that don't move may be
+     * baked, since the mesh doesn't change once initialized.
+     */
+    virtual bool bake(Mesh& mesh) { return false; }
+
+    /**
+     * Returns the material the model binds first, if known, by which models
+     * are sorted for display so as to bind each material as rarely as possible.
+     */
+    virtual const Material* firstMaterial() const { return NULL; }
+
   protected:
 
     /** A convenience wrapper for glTranslatef. */
@@ -78,6 +94,8 @@ namespace mbostock {
     WedgeModel(const Wedge& wedge);
 
     virtual void display();
+    virtual bool bake(Mesh& mesh);
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     void setTopMaterial(const Material& m);
@@ -86,6 +104,8 @@ namespace mbostock {
     const Material& topMaterial() const;
 
   private:
+    void display(Faces& f);
+
     const Wedge& wedge_;
     const Material* material_;
     const Material* topMaterial_;
@@ -101,6 +121,8 @@ namespace mbostock {
     AxisAlignedBoxModel(const AxisAlignedBox& box);
 
     virtual void display();
+    virtual bool bake(Mesh& mesh);
+    virtual const Material* firstMaterial() const;
 
     enum Orientation { POSITIVE_X, NEGATIVE_X, POSITIVE_Z, NEGATIVE_Z };
 
@@ -113,6 +135,8 @@ namespace mbostock {
     const Material& topMaterial() const;
 
   private:
+    void display(Faces& f);
+
     const AxisAlignedBox& box_;
     const Material* material_;
     const Material* topMaterial_;
@@ -129,6 +153,8 @@ namespace mbostock {
     BoxModel(const Box& box);
 
     virtual void display();
+    virtual bool bake(Mesh& mesh);
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     void setTopMaterial(const Material& m);
@@ -137,6 +163,8 @@ namespace mbostock {
     const Material& topMaterial() const;
 
   private:
+    void display(Faces& f);
+
     const Box& box_;
     const Material* material_;
     const Material* topMaterial_;
@@ -151,6 +179,8 @@ namespace mbostock {
     QuadModel(const Quad& quad);
 
     virtual void display();
+    virtual bool bake(Mesh& mesh);
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     void setTexCoords(const Vector& t0, const Vector& t1,
@@ -159,7 +189,8 @@ namespace mbostock {
     inline const Material& material() const { return *material_; }
 
   private:
-    void displaySide(bool front);
+    void display(Faces& f);
+    void displaySide(Faces& f, bool front);
 
     const Quad& quad_;
     const Material* material_;
@@ -175,6 +206,8 @@ namespace mbostock {
     TriangleModel(const Triangle& triangle);
 
     virtual void display();
+    virtual bool bake(Mesh& mesh);
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     void setTexCoords(const Vector& t0, const Vector& t1, const Vector& t2);
@@ -182,7 +215,8 @@ namespace mbostock {
     inline const Material& material() const { return *material_; }
 
   private:
-    void displaySide(bool front);
+    void display(Faces& f);
+    void displaySide(Faces& f, bool front);
 
     const Triangle& triangle_;
     const Material* material_;
@@ -203,6 +237,7 @@ namespace mbostock {
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     void setCapMaterial(const Material& m);
@@ -229,6 +264,7 @@ namespace mbostock {
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
 
     void setMaterial(const Material& m);
     inline const Material& material() const { return *material_; }
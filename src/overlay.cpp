@@ -0,0 +1,63 @@
+// -*- C++ -*-
+
+#include <GLUT/glut.h>
+#include <OpenGL/gl.h>
+#include <OpenGL/glu.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "overlay.h"
+
+using namespace mbostock;
+
+static const int lineHeight = 15;
+static const int margin = 8;
+
+void OverlayModel::clear() {
+  lines_.clear();
+}
+
+void OverlayModel::print(const char* format, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  lines_.push_back(line);
+}
+
+void OverlayModel::display() {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_TEXTURE_2D);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_FOG);
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  gluOrtho2D(0, viewport[2], 0, viewport[3]);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+
+  glColor3f(.9f, .9f, .6f);
+  int y = viewport[3] - margin;
+  std::vector<std::string>::const_iterator i;
+  for (i = lines_.begin(); i != lines_.end(); i++) {
+    y -= lineHeight;
+    glRasterPos2i(margin, y);
+    std::string::const_iterator c;
+    for (c = i->begin(); c != i->end(); c++) {
+      glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+  }
+
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+  glPopAttrib();
+}
@@ -0,0 +1,31 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_OVERLAY_H
+#define MBOSTOCK_OVERLAY_H
+
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+namespace mbostock {
+
+  /**
+   * A model which displays lines of text in the top-left corner of the screen,
+   * on top of everything else. Used in debug mode for statistics; the lines
+   * are typically cleared and reprinted each frame.
+   */
+  class OverlayModel : public Model {
+  public:
+    virtual void display();
+
+    void clear();
+    void print(const char* format, ...);
+
+  private:
+    std::vector<std::string> lines_;
+  };
+
+}
+
+#endif
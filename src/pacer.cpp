@@ -0,0 +1,104 @@
+// -*- C++ -*-
+
+#include <SDL/SDL.h>
+
+#include "pacer.h"
+
+using namespace mbostock;
+
+/*
+ * A swap that returns in under a millisecond almost certainly didn't wait for
+ * the vertical refresh. A single slow swap proves nothing, so the pacer only
+ * changes its mind after several consecutive frames agree.
+ */
+static const uint32_t blockingSwapMs = 1;
+static const int swapSamples = 8;
+
+FrameHistogram::FrameHistogram() {
+  clear();
+}
+
+void FrameHistogram::clear() {
+  for (int i = 0; i < buckets; i++) {
+    counts_[i] = 0;
+  }
+  count_ = 0;
+  total_ = 0;
+  max_ = 0;
+}
+
+void FrameHistogram::add(uint32_t ms) {
+  counts_[(ms < buckets) ? ms : buckets - 1]++;
+  count_++;
+  total_ += ms;
+  if (ms > max_) {
+    max_ = ms;
+  }
+}
+
+float FrameHistogram::mean() const {
+  return (count_ == 0) ? 0.f : total_ / (float) count_;
+}
+
+uint32_t FrameHistogram::percentile(float p) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  uint32_t n = (uint32_t) (p * count_ + .5f);
+  uint32_t sum = 0;
+  for (int i = 0; i < buckets; i++) {
+    sum += counts_[i];
+    if ((sum >= n) && (sum > 0)) {
+      return i;
+    }
+  }
+  return buckets - 1;
+}
+
+FramePacer::FramePacer(uint32_t minPeriodMs)
+    : minPeriodMs_(minPeriodMs), throttleMs_(0), beginMs_(0), swapBeginMs_(0),
+      lastBeginMs_(0), displayMs_(0), swapMs_(0), blockedSwaps_(swapSamples),
+      synchronized_(true) {
+}
+
+void FramePacer::begin() {
+  beginMs_ = SDL_GetTicks();
+  if (lastBeginMs_ != 0) {
+    histogram_.add(beginMs_ - lastBeginMs_);
+  }
+  lastBeginMs_ = beginMs_;
+}
+
+void FramePacer::swap() {
+  swapBeginMs_ = SDL_GetTicks();
+  displayMs_ = swapBeginMs_ - beginMs_;
+}
+
+void FramePacer::end() {
+  uint32_t endMs = SDL_GetTicks();
+  swapMs_ = endMs - swapBeginMs_;
+
+  /* Decide whether the swap is synchronized with the display. */
+  if (swapMs_ >= blockingSwapMs) {
+    if (blockedSwaps_ < swapSamples) {
+      blockedSwaps_++;
+    }
+  } else if (blockedSwaps_ > 0) {
+    blockedSwaps_--;
+  }
+  if (blockedSwaps_ == swapSamples) {
+    synchronized_ = true;
+  } else if (blockedSwaps_ == 0) {
+    synchronized_ = false;
+  }
+
+  /* If not, sleep for the rest of the minimum (or throttled) period. */
+  uint32_t periodMs = throttleMs_;
+  if (!synchronized_ && (periodMs < minPeriodMs_)) {
+    periodMs = minPeriodMs_;
+  }
+  uint32_t frameMs = endMs - beginMs_;
+  if (frameMs < periodMs) {
+    SDL_Delay(periodMs - frameMs);
+  }
+}
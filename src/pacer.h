@@ -0,0 +1,86 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_PACER_H
+#define MBOSTOCK_PACER_H
+
+#include <stdint.h>
+
+namespace mbostock {
+
+  /**
+   * A histogram of frame times, in whole milliseconds. Frame times of
+   * buckets - 1 milliseconds or more are counted in the last bucket.
+   */
+  class FrameHistogram {
+  public:
+    FrameHistogram();
+
+    enum { buckets = 64 };
+
+    void add(uint32_t ms);
+    void clear();
+
+    inline uint32_t count() const { return count_; }
+    inline uint32_t count(int ms) const { return counts_[ms]; }
+    inline uint32_t max() const { return max_; }
+    float mean() const;
+
+    /** Returns the frame time that the fraction p of frames don't exceed. */
+    uint32_t percentile(float p) const;
+
+  private:
+    uint32_t counts_[buckets];
+    uint32_t count_;
+    uint32_t total_;
+    uint32_t max_;
+  };
+
+  /**
+   * Measures the time spent displaying and swapping each frame, and paces
+   * frames accordingly. If swapping blocks (as it does when synchronized to
+   * the display's vertical refresh), the swap already paces frames and the
+   * pacer never sleeps. Otherwise, the pacer sleeps for whatever remains of
+   * the minimum frame period, so that frames don't spin the CPU.
+   */
+  class FramePacer {
+  public:
+    FramePacer(uint32_t minPeriodMs = 4);
+
+    /** Marks the start of a frame. */
+    void begin();
+
+    /** Marks the end of drawing, immediately before the buffers are swapped. */
+    void swap();
+
+    /** Marks the end of the frame, just after the buffers are swapped. */
+    void end();
+
+    /**
+     * Lengthens frames to at least periodMs, even if synchronized, so as to
+     * leave more time for other work; zero restores the normal pacing.
+     */
+    inline void throttle(uint32_t periodMs) { throttleMs_ = periodMs; }
+
+    /** Returns true if swapping appears to be synchronized to the display. */
+    inline bool synchronized() const { return synchronized_; }
+    inline uint32_t displayMillis() const { return displayMs_; }
+    inline uint32_t swapMillis() const { return swapMs_; }
+
+    inline FrameHistogram& histogram() { return histogram_; }
+
+  private:
+    uint32_t minPeriodMs_;
+    uint32_t throttleMs_;
+    uint32_t beginMs_;
+    uint32_t swapBeginMs_;
+    uint32_t lastBeginMs_;
+    uint32_t displayMs_;
+    uint32_t swapMs_;
+    int blockedSwaps_;
+    bool synchronized_;
+    FrameHistogram histogram_;
+  };
+
+}
+
+#endif
@@ -117,9 +117,14 @@ bool Constraints::inside(Particle& a, const Shape& s, float r, float kr) {
 }
 
 bool Constraints::outside(Particle& a, const Shape& s, float r) {
-  p = s.project(a.position);
-  if (p.length < r) {
-    a.position = p.x - (p.x - a.position) * (r / p.length);
+  return outside(a, s, r, p);
+}
+
+bool Constraints::outside(Particle& a, const Shape& s, float r,
+    Projection& j) {
+  j = s.project(a.position);
+  if (j.length < r) {
+    a.position = j.x - (j.x - a.position) * (r / j.length);
     return true;
   }
   return false;
@@ -110,9 +110,17 @@ namespace mbostock {
      */
     static bool outside(Particle& a, const Shape& s, float r, float kr);
 
+    /**
+     * Constrains the particle to be outside the specified shape by at least
+     * radius r, storing the projection in j. Unlike the other shape-based
+     * constraints, this is safe to call from multiple threads at once.
+     */
+    static bool outside(Particle& a, const Shape& s, float r, Projection& j);
+
     /**
      * Returns the projection information for the last call to a shape-based
-     * constraint.
+     * constraint (other than those that store the projection explicitly). This
+     * is shared by all threads.
      */
     static const Projection& projection();
 
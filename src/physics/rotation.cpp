@@ -4,6 +4,7 @@
 
 #include "particle.h"
 #include "rotation.h"
+#include "snapshot.h"
 
 using namespace mbostock;
 
@@ -27,6 +28,17 @@ void Rotation::step() {
   update();
 }
 
+void Rotation::saveState(Snapshot& s) const {
+  Transform::saveState(s);
+  s.write(angle_);
+}
+
+void Rotation::loadState(Snapshot& s) {
+  Transform::loadState(s);
+  angle_ = s.read();
+  update();
+}
+
 void Rotation::update() {
   float r = angle_ * (2.f * M_PI / 360.f);
   float c = cosf(r);
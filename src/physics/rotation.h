@@ -48,6 +48,9 @@ namespace mbostock {
     /** Resets the rotation. */
     virtual void reset();
 
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
+
     /** Returns the velocity of the given point. */
     Vector velocity(const Vector& x) const;
 
@@ -0,0 +1,53 @@
+// -*- C++ -*-
+
+#include "particle.h"
+#include "snapshot.h"
+
+using namespace mbostock;
+
+Snapshot::Snapshot()
+    : position_(0) {
+}
+
+void Snapshot::clear() {
+  data_.clear();
+  position_ = 0;
+}
+
+void Snapshot::write(const Vector& v) {
+  data_.push_back(v.x);
+  data_.push_back(v.y);
+  data_.push_back(v.z);
+}
+
+/* Forces are accumulated within each step, so only positions are saved. */
+void Snapshot::write(const Particle& p) {
+  write(p.position);
+  write(p.previousPosition);
+}
+
+void Snapshot::resize(int size) {
+  data_.resize(size);
+  position_ = 0;
+}
+
+uint32_t Snapshot::hash() const {
+  uint32_t h = 2166136261u;
+  const unsigned char* p = (const unsigned char*) data();
+  const unsigned char* end = p + data_.size() * sizeof(float);
+  for (; p < end; p++) {
+    h = (h ^ *p) * 16777619u;
+  }
+  return h;
+}
+
+Vector Snapshot::readVector() {
+  Vector v(data_[position_], data_[position_ + 1], data_[position_ + 2]);
+  position_ += 3;
+  return v;
+}
+
+void Snapshot::readParticle(Particle& p) {
+  p.position = readVector();
+  p.previousPosition = readVector();
+}
@@ -0,0 +1,56 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_SNAPSHOT_H
+#define MBOSTOCK_SNAPSHOT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "vector.h"
+
+namespace mbostock {
+
+  class Particle;
+
+  /**
+   * A flat sequence of floats capturing some state of the simulation, such as
+   * the state needed to display it. Values are read back in the same order in
+   * which they were written; clearing a snapshot retains its capacity, so that
+   * a snapshot which is reused does not allocate.
+   */
+  class Snapshot {
+  public:
+    Snapshot();
+
+    /** Removes all values. */
+    void clear();
+
+    /** Moves the read position back to the first value. */
+    inline void rewind() { position_ = 0; }
+
+    inline void write(float f) { data_.push_back(f); }
+    void write(const Vector& v);
+    void write(const Particle& p);
+
+    inline float read() { return data_[position_++]; }
+    Vector readVector();
+    void readParticle(Particle& p);
+
+    /** Returns a hash (FNV-1a) of the bits of all values. */
+    uint32_t hash() const;
+
+    /** Sets the number of values, as when copying raw data into a snapshot. */
+    void resize(int size);
+
+    inline int size() const { return data_.size(); }
+    inline const float* data() const { return &data_[0]; }
+    inline float* data() { return &data_[0]; }
+
+  private:
+    std::vector<float> data_;
+    int position_;
+  };
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 // -*- C++ -*-
 
+#include "snapshot.h"
 #include "transform.h"
 
 using namespace mbostock;
@@ -11,3 +12,11 @@ Transform::Transform()
 void Transform::enable(bool enabled) {
   enabled_ = enabled;
 }
+
+void Transform::saveState(Snapshot& s) const {
+  s.write(enabled_ ? 1.f : 0.f);
+}
+
+void Transform::loadState(Snapshot& s) {
+  enabled_ = (s.read() != 0.f);
+}
@@ -5,6 +5,8 @@
 
 namespace mbostock {
 
+  class Snapshot;
+
   class Transform {
   public:
     Transform();
@@ -16,6 +18,10 @@ namespace mbostock {
     virtual void reset() = 0;
     virtual void step() = 0;
 
+    /** Saves (or loads) the mutable state of the transform. */
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
+
   private:
     bool enabled_;
   };
@@ -1,6 +1,7 @@
 // -*- C++ -*-
 
 #include "particle.h"
+#include "snapshot.h"
 #include "translation.h"
 #include "vector.h"
 
@@ -55,6 +56,24 @@ void Translation::step() {
   origin_ += dv_;
 }
 
+void Translation::saveState(Snapshot& s) const {
+  Transform::saveState(s);
+  s.write(v_);
+  s.write(dv_);
+  s.write(x_);
+  s.write(origin_);
+  s.write(reversed_ ? 1.f : 0.f);
+}
+
+void Translation::loadState(Snapshot& s) {
+  Transform::loadState(s);
+  v_ = s.readVector();
+  dv_ = s.readVector();
+  x_ = s.readVector();
+  origin_ = s.readVector();
+  reversed_ = (s.read() != 0.f);
+}
+
 void Translation::setMode(Mode m) {
   mode_ = m;
 }
@@ -31,6 +31,9 @@ namespace mbostock {
     /** Resets the translation. */
     virtual void reset();
 
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
+
     /** Returns the current velocity. */
     const Vector& velocity() const;
 
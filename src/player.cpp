@@ -14,6 +14,7 @@
 #include "physics/force.h"
 #include "physics/particle.h"
 #include "physics/shape.h"
+#include "physics/snapshot.h"
 #include "physics/vector.h"
 #include "player.h"
 #include "room.h"
@@ -155,8 +156,10 @@ void PlayerBodyModel::display() {
   glPopMatrix();
 }
 
-PlayerModel::PlayerModel(const Player& player)
-  : player_(player), quadric_(NULL),
+PlayerModel::PlayerModel()
+  : x_(Vector::X()), y_(Vector::Y()), z_(Vector::Z()),
+    leftWheelAngle_(0.f), rightWheelAngle_(0.f),
+    leftWheelFriction_(false), rightWheelFriction_(false), quadric_(NULL),
     wheelModel_(Models::compile(new PlayerWheelModel(*this))),
     bodyModel_(Models::compile(new PlayerBodyModel(*this))) {
   for (int i = 0; i < 15; i++) {
@@ -182,13 +185,21 @@ void PlayerModel::initialize() {
   bodyModel_->initialize();
 }
 
+void PlayerModel::loadDisplay(Snapshot& s) {
+  origin_ = s.readVector();
+  x_ = s.readVector();
+  y_ = s.readVector();
+  z_ = s.readVector();
+  leftWheelAngle_ = s.read();
+  rightWheelAngle_ = s.read();
+  leftWheelFriction_ = (s.read() != 0.f);
+  rightWheelFriction_ = (s.read() != 0.f);
+}
+
 float* PlayerModel::orientation() {
-  const Vector& x = player_.x();
-  const Vector& y = player_.y();
-  const Vector& z = player_.z();
-  orientation_[0] = x.x; orientation_[1] = x.y; orientation_[2] = x.z;
-  orientation_[4] = y.x; orientation_[5] = y.y; orientation_[6] = y.z;
-  orientation_[8] = z.x; orientation_[9] = z.y; orientation_[10] = z.z;
+  orientation_[0] = x_.x; orientation_[1] = x_.y; orientation_[2] = x_.z;
+  orientation_[4] = y_.x; orientation_[5] = y_.y; orientation_[6] = y_.z;
+  orientation_[8] = z_.x; orientation_[9] = z_.y; orientation_[10] = z_.z;
   return orientation_;
 }
 
@@ -196,24 +207,24 @@ void PlayerModel::display() {
   Materials::blank().bind();
 
   glPushMatrix();
-  glTranslatev(player_.origin());
+  glTranslatev(origin_);
   glMultMatrixf(orientation());
 
   /* Left wheel. */
-  if (!World::world()->debug() || player_.leftWheelFriction()) {
+  if (!World::world()->debug() || leftWheelFriction_) {
     glPushMatrix();
     glTranslatef(0.f, 0.f, -axleLength / 2.f - wheelRadius / 2.f);
-    glRotatef(player_.leftWheelAngle(), 0.f, 0.f, 1.f);
+    glRotatef(leftWheelAngle_, 0.f, 0.f, 1.f);
     glRotatef(180.f, 0.f, 1.f, 0.f);
     wheelModel_->display();
     glPopMatrix();
   }
 
   /* Right wheel. */
-  if (!World::world()->debug() || player_.rightWheelFriction()) {
+  if (!World::world()->debug() || rightWheelFriction_) {
     glPushMatrix();
     glTranslatef(0.f, 0.f, axleLength / 2.f + wheelRadius / 2.f);
-    glRotatef(player_.rightWheelAngle(), 0.f, 0.f, 1.f);
+    glRotatef(rightWheelAngle_, 0.f, 0.f, 1.f);
     wheelModel_->display();
     glPopMatrix();
   }
@@ -246,16 +257,55 @@ void PlayerModel::displayAxes() {
 
 Player::Player()
     : turnState_(NONE), moveState_(NONE),
-      sphere_(Vector::ZERO(), wheelRadius * 2.f), model_(*this) {
+      sphere_(Vector::ZERO(), wheelRadius * 2.f) {
   counterWeight_.inverseMass = 1.f / counterWeight;
 }
 
+void Player::saveDisplay(Snapshot& s) const {
+  s.write(origin_);
+  s.write(x_);
+  s.write(y_);
+  s.write(z_);
+  s.write(leftWheel_.angle);
+  s.write(rightWheel_.angle);
+  s.write(leftWheel_.friction() ? 1.f : 0.f);
+  s.write(rightWheel_.friction() ? 1.f : 0.f);
+}
+
+void Player::saveState(Snapshot& s) const {
+  leftWheel_.saveState(s);
+  rightWheel_.saveState(s);
+  s.write(body_);
+  s.write(counterWeight_);
+  s.write(turnState_);
+  s.write(moveState_);
+  s.write(sphere_.x());
+  s.write(origin_);
+  s.write(x_);
+  s.write(y_);
+  s.write(z_);
+}
+
+void Player::loadState(Snapshot& s) {
+  leftWheel_.loadState(s);
+  rightWheel_.loadState(s);
+  s.readParticle(body_);
+  s.readParticle(counterWeight_);
+  turnState_ = (Direction) s.read();
+  moveState_ = (Direction) s.read();
+  sphere_.x() = s.readVector();
+  origin_ = s.readVector();
+  x_ = s.readVector();
+  y_ = s.readVector();
+  z_ = s.readVector();
+}
+
 float Player::mass() const {
   return counterWeight + 3.f;
 }
 
 Player::Wheel::Wheel()
-    : angle(0.f), angleStep(0.f) {
+    : contact(false), angle(0.f), angleStep(0.f) {
   inverseMass = 1.f / wheelWeight;
 }
 
@@ -350,8 +400,8 @@ void Player::resetForces() {
   }
 }
 
-void Player::Wheel::applyContact(const RoomObject& o) {
-  const Vector& normal = Constraints::projection().normal;
+void Player::Wheel::applyContact(const RoomObject& o, const Projection& j) {
+  const Vector& normal = j.normal;
   if ((normal.y > o.slip()) && (!contact || (contactNormal.y < normal.y))) {
     contactNormal = normal;
     contactVelocity = o.velocity(position);
@@ -412,21 +462,22 @@ bool Player::constrainOutside(const RoomObject& o) {
   const Shape& s = o.shape();
   bool contact = false;
   if (s.intersects(sphere_)) {
-    if (Constraints::outside(leftWheel_, s, wheelRadius)) {
+    if (Constraints::outside(leftWheel_, s, wheelRadius, projection_)) {
       constrainGlancing(o);
-      leftWheel_.applyContact(o);
+      leftWheel_.applyContact(o, projection_);
       contact = true;
     }
-    if (Constraints::outside(rightWheel_, s, wheelRadius)) { 
+    if (Constraints::outside(rightWheel_, s, wheelRadius, projection_)) { 
       constrainGlancing(o);
-      rightWheel_.applyContact(o);
+      rightWheel_.applyContact(o, projection_);
       contact = true;
     }
-    if (Constraints::outside(body_, s, wheelRadius)) {
+    if (Constraints::outside(body_, s, wheelRadius, projection_)) {
       sphere_.x() = body_.position;
       contact = true;
     }
-    if (Constraints::outside(counterWeight_, s, counterWeightRadius)) {
+    if (Constraints::outside(counterWeight_, s, counterWeightRadius,
+                             projection_)) {
       contact = true;
     }
   }
@@ -434,7 +485,7 @@ bool Player::constrainOutside(const RoomObject& o) {
 }
 
 void Player::constrainGlancing(const RoomObject& o) {
-  const Projection& j = Constraints::projection();
+  const Projection& j = projection_;
 
   /*
    * This constraint only applies if we are moving parallel to the wall, so if
@@ -509,6 +560,24 @@ void Player::constrainInternal() {
   y_ = -x_.cross(z_);
 }
 
+void Player::Wheel::saveState(Snapshot& s) const {
+  s.write(*this);
+  s.write(contact ? 1.f : 0.f);
+  s.write(contactNormal);
+  s.write(contactVelocity);
+  s.write(angle);
+  s.write(angleStep);
+}
+
+void Player::Wheel::loadState(Snapshot& s) {
+  s.readParticle(*this);
+  contact = (s.read() != 0.f);
+  contactNormal = s.readVector();
+  contactVelocity = s.readVector();
+  angle = s.read();
+  angleStep = s.read();
+}
+
 void Player::Wheel::constrainDirection(const Vector& z) {
   if (!friction()) {
     angle += angleStep;
@@ -588,6 +657,11 @@ void Player::stop() {
   moveState_ = NONE;
 }
 
+void Player::setControls(Direction turn, Direction move) {
+  turnState_ = turn;
+  moveState_ = move;
+}
+
 void Player::stop(Direction d) {
   switch (d) {
     case LEFT: {
@@ -14,21 +14,40 @@ namespace mbostock {
 
   class Player;
   class RoomObject;
+  class Snapshot;
   class UnaryForce;
 
+  /**
+   * A model for Player. Rather than reading the player directly, the model
+   * displays the pose most recently loaded from a snapshot, so that the player
+   * may be simulated on another thread.
+   */
   class PlayerModel : public Model {
   public:
-    PlayerModel(const Player& player);
+    PlayerModel();
     virtual ~PlayerModel();
 
     virtual void initialize();
     virtual void display();
 
+    /** Loads the pose saved by Player::saveDisplay. */
+    void loadDisplay(Snapshot& s);
+
+    inline const Vector& origin() const { return origin_; }
+
   private:
     float* orientation();
     void displayAxes();
 
-    const Player& player_;
+    Vector origin_;
+    Vector x_;
+    Vector y_;
+    Vector z_;
+    float leftWheelAngle_;
+    float rightWheelAngle_;
+    bool leftWheelFriction_;
+    bool rightWheelFriction_;
+
     GLUquadric* quadric_;
     float orientation_[16];
     Model* wheelModel_;
@@ -47,6 +66,13 @@ namespace mbostock {
     void move(Direction d);
     void stop(Direction d);
     void stop();
+
+    /**
+     * Sets the turn (LEFT, RIGHT or NONE) and movement (FORWARD, BACKWARD or
+     * NONE) directly, rather than by toggling as move and stop do.
+     */
+    void setControls(Direction turn, Direction move);
+
     void jiggle();
     void setOrigin(const Vector& origin);
     void setVelocity(const Vector& velocity);
@@ -70,7 +96,14 @@ namespace mbostock {
     bool leftWheelFriction() const { return leftWheel_.friction(); }
     bool rightWheelFriction() const { return rightWheel_.friction(); }
 
-    inline Model& model() { return model_; }
+    /** Saves the pose needed to display the player. */
+    void saveDisplay(Snapshot& s) const;
+
+    /** Saves (or loads) the player's complete mutable state. */
+    void saveState(Snapshot& s) const;
+    void loadState(Snapshot& s);
+
+    inline PlayerModel& model() { return model_; }
 
   private:
     class Wheel : public Particle {
@@ -78,11 +111,13 @@ namespace mbostock {
       Wheel();
 
       inline bool friction() const { return contact; }
-      void applyContact(const RoomObject& o);
+      void applyContact(const RoomObject& o, const Projection& j);
       void applyForce(const Vector& z, float f);
       void applyLinearDrag(float kd);
       void applyQuadraticDrag(float kd);
       void constrainDirection(const Vector& z);
+      void saveState(Snapshot& s) const;
+      void loadState(Snapshot& s);
 
       bool contact;
       Vector contactNormal;
@@ -104,6 +139,7 @@ namespace mbostock {
     Direction moveState_;
 
     Sphere sphere_;
+    Projection projection_;
     Vector origin_;
     Vector x_;
     Vector y_;
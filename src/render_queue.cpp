@@ -0,0 +1,53 @@
+// -*- C++ -*-
+
+#include <algorithm>
+
+#include "material.h"
+#include "model.h"
+#include "render_queue.h"
+
+using namespace mbostock;
+
+/*
+ * Models whose first material is unknown sort before the others, as though
+ * they bound no texture.
+ */
+bool RenderQueue::Item::operator<(const Item& i) const {
+  if (blended != i.blended) {
+    return i.blended;
+  }
+  if (blended) {
+    return depth > i.depth;
+  }
+  if (texture != i.texture) {
+    return texture < i.texture;
+  }
+  if (material != i.material) {
+    return material < i.material;
+  }
+  return depth < i.depth;
+}
+
+void RenderQueue::add(Model& model, float depth) {
+  Item i;
+  i.model = &model;
+  i.material = model.firstMaterial();
+  i.texture = (i.material == NULL) ? NULL : i.material->texture();
+  i.blended = (i.material != NULL) && i.material->blended();
+  i.depth = depth;
+  items_.push_back(i);
+}
+
+void RenderQueue::clear() {
+  items_.clear();
+}
+
+void RenderQueue::display() {
+  std::stable_sort(items_.begin(), items_.end());
+  Materials::track();
+  std::vector<Item>::const_iterator i;
+  for (i = items_.begin(); i != items_.end(); i++) {
+    i->model->display();
+  }
+  Materials::untrack();
+}
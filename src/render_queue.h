@@ -0,0 +1,50 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_RENDER_QUEUE_H
+#define MBOSTOCK_RENDER_QUEUE_H
+
+#include <vector>
+
+namespace mbostock {
+
+  class Material;
+  class Model;
+  class Texture;
+
+  /**
+   * Models collected for display, and then displayed in an order that binds
+   * each texture and material as rarely as possible. Opaque models come first,
+   * sorted by texture, then by material, and then front to back, so that
+   * hidden fragments fail the depth test early. Blended models follow, sorted
+   * back to front only, so that they blend over whatever is behind them.
+   * Materials are tracked while the queue is displayed, so that redundant
+   * binds are skipped.
+   */
+  class RenderQueue {
+  public:
+    /** Adds a model, at the specified distance from the eye. */
+    void add(Model& model, float depth);
+
+    void clear();
+    void display();
+
+    inline int size() const { return items_.size(); }
+
+  private:
+    class Item {
+    public:
+      Model* model;
+      const Material* material;
+      const Texture* texture;
+      bool blended;
+      float depth;
+
+      bool operator<(const Item& i) const;
+    };
+
+    std::vector<Item> items_;
+  };
+
+}
+
+#endif
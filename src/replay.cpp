@@ -0,0 +1,188 @@
+// -*- C++ -*-
+
+#include <stdio.h>
+#include <string.h>
+
+#include "replay.h"
+
+using namespace mbostock;
+
+static const char magic[] = { 'P', 'B', 'G', 'L' };
+static const int version = 1;
+
+/*
+ * Events are encoded in a single byte as the type times eight plus the
+ * direction; since there are fewer than thirty types, the high codes are free
+ * to mark hashes.
+ */
+static const int hashCode = 0xff;
+
+static void writeVarint(std::vector<unsigned char>& out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(v);
+}
+
+static bool readVarint(const unsigned char*& p, const unsigned char* end,
+    uint32_t& v) {
+  v = 0;
+  for (int shift = 0; (p < end) && (shift < 32); shift += 7) {
+    unsigned char b = *p++;
+    v |= (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+InputLogEntry::InputLogEntry()
+    : step(0), type(EVENT), hash(0) {
+}
+
+InputLog::InputLog(uint32_t hashInterval)
+    : hashInterval_(hashInterval), startRoom_(0), length_(0) {
+}
+
+void InputLog::clear() {
+  entries_.clear();
+  length_ = 0;
+}
+
+void InputLog::addEvent(uint32_t step, const WorldEvent& e) {
+  InputLogEntry entry;
+  entry.step = step;
+  entry.type = InputLogEntry::EVENT;
+  entry.event = e;
+  entries_.push_back(entry);
+}
+
+void InputLog::addHash(uint32_t step, uint32_t hash) {
+  InputLogEntry entry;
+  entry.step = step;
+  entry.type = InputLogEntry::HASH;
+  entry.hash = hash;
+  entries_.push_back(entry);
+}
+
+bool InputLog::save(const char* path) const {
+  std::vector<unsigned char> out(magic, magic + sizeof(magic));
+  out.push_back(version);
+  writeVarint(out, hashInterval_);
+  writeVarint(out, startRoom_);
+  writeVarint(out, length_);
+
+  uint32_t step = 0;
+  std::vector<InputLogEntry>::const_iterator i;
+  for (i = entries_.begin(); i != entries_.end(); i++) {
+    writeVarint(out, i->step - step);
+    step = i->step;
+    if (i->type == InputLogEntry::HASH) {
+      out.push_back(hashCode);
+      for (int j = 0; j < 4; j++) {
+        out.push_back((i->hash >> (j * 8)) & 0xff);
+      }
+    } else {
+      out.push_back(i->event.type * 8 + i->event.direction);
+    }
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  bool written = fwrite(&out[0], 1, out.size(), file) == out.size();
+  return (fclose(file) == 0) && written;
+}
+
+bool InputLog::load(const char* path) {
+  clear();
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  std::vector<unsigned char> in;
+  unsigned char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    in.insert(in.end(), buffer, buffer + n);
+  }
+  fclose(file);
+
+  if ((in.size() < sizeof(magic) + 1)
+      || (memcmp(&in[0], magic, sizeof(magic)) != 0)
+      || (in[sizeof(magic)] != version)) {
+    return false;
+  }
+  const unsigned char* p = &in[0] + sizeof(magic) + 1;
+  const unsigned char* end = &in[0] + in.size();
+  uint32_t startRoom;
+  if (!readVarint(p, end, hashInterval_)
+      || !readVarint(p, end, startRoom)
+      || !readVarint(p, end, length_)
+      || ((int) startRoom < 0)) {
+    return false;
+  }
+  startRoom_ = startRoom;
+
+  uint32_t step = 0;
+  uint32_t delta;
+  while (p < end) {
+    if (!readVarint(p, end, delta) || (p == end)) {
+      return false;
+    }
+    step += delta;
+    int code = *p++;
+    if (code == hashCode) {
+      if (end - p < 4) {
+        return false;
+      }
+      addHash(step,
+          p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+      p += 4;
+    } else if ((code / 8 <= WorldEvent::REWIND)
+        && (code % 8 <= Player::BACKWARD)) {
+      addEvent(step, WorldEvent((WorldEvent::Type) (code / 8),
+          (Player::Direction) (code % 8)));
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+Replayer::Replayer(World& world, const InputLog& log)
+    : world_(world), log_(log), steps_(0), next_(0), diverged_(false),
+      divergedStep_(0) {
+  if (valid()) {
+    world_.setRoom(log_.startRoom(), 0);
+  }
+}
+
+bool Replayer::valid() const {
+  return log_.startRoom() < (int) world_.rooms().size();
+}
+
+bool Replayer::step() {
+  if (!valid()) {
+    return false;
+  }
+  const std::vector<InputLogEntry>& entries = log_.entries();
+  while ((next_ < (int) entries.size()) && (entries[next_].step == steps_)) {
+    const InputLogEntry& entry = entries[next_++];
+    if (entry.type == InputLogEntry::EVENT) {
+      world_.apply(entry.event);
+    } else if (!diverged_ && (entry.hash != world_.stateHash())) {
+      diverged_ = true;
+      divergedStep_ = steps_;
+    }
+  }
+  if (steps_ >= log_.length()) {
+    return false;
+  }
+  world_.step();
+  steps_++;
+  return true;
+}
@@ -0,0 +1,107 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_REPLAY_H
+#define MBOSTOCK_REPLAY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "world.h"
+
+namespace mbostock {
+
+  /**
+   * An entry in an input log: either an event applied to the world, or a hash
+   * of the world's state, at the given step index. Events at step n are
+   * applied after n steps have been taken, and hashes at step n are computed
+   * after n steps but before the events at step n are applied.
+   */
+  class InputLogEntry {
+  public:
+    enum Type { EVENT, HASH };
+
+    InputLogEntry();
+
+    uint32_t step;
+    Type type;
+    WorldEvent event;
+    uint32_t hash;
+  };
+
+  /**
+   * A compact log of the input applied to the world, keyed by step index, from
+   * which a session can be replayed deterministically. If the hash interval is
+   * nonzero, a hash of the player and room state is also recorded every so
+   * many steps, so that a replay can detect divergence.
+   *
+   * The binary format is a small header (magic, version, hash interval, start
+   * room and length in steps), followed by one entry per event or hash: the
+   * step delta as a variable-length integer, then a byte encoding the event
+   * type and direction, with hashes followed by four more bytes.
+   */
+  class InputLog {
+  public:
+    InputLog(uint32_t hashInterval = 0);
+
+    void clear();
+
+    void addEvent(uint32_t step, const WorldEvent& e);
+    void addHash(uint32_t step, uint32_t hash);
+
+    inline uint32_t hashInterval() const { return hashInterval_; }
+    inline int startRoom() const { return startRoom_; }
+    inline void setStartRoom(int room) { startRoom_ = room; }
+    inline uint32_t length() const { return length_; }
+    inline void setLength(uint32_t steps) { length_ = steps; }
+    inline const std::vector<InputLogEntry>& entries() const {
+      return entries_;
+    }
+
+    bool save(const char* path) const;
+    bool load(const char* path);
+
+  private:
+    uint32_t hashInterval_;
+    int startRoom_;
+    uint32_t length_;
+    std::vector<InputLogEntry> entries_;
+  };
+
+  /**
+   * Replays an input log by stepping the world directly, without a simulation
+   * thread or display. The world should be freshly loaded, as from the same
+   * world file with which the log was recorded. Entering the start room adds
+   * a trail, but trails aren't hashed, so the replay needn't match how often
+   * the recording entered it.
+   */
+  class Replayer {
+  public:
+    Replayer(World& world, const InputLog& log);
+
+    /**
+     * Returns false if the log's start room isn't in the world, as with a log
+     * recorded in another world; such a log takes no steps.
+     */
+    bool valid() const;
+
+    /** Takes the next step; returns false when the log is exhausted. */
+    bool step();
+
+    inline uint32_t steps() const { return steps_; }
+
+    /** Returns true if a recorded hash didn't match the replayed state. */
+    inline bool diverged() const { return diverged_; }
+    inline uint32_t divergedStep() const { return divergedStep_; }
+
+  private:
+    World& world_;
+    const InputLog& log_;
+    uint32_t steps_;
+    int next_;
+    bool diverged_;
+    uint32_t divergedStep_;
+  };
+
+}
+
+#endif
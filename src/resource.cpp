@@ -1,27 +1,289 @@
 // -*- C++ -*-
 
-#include <fstream>
-#include <ios>
-#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "compiled_format.h"
 #include "resource.h"
 
+namespace mbostock {
+
+  class ResourceArchiveHeader {
+  public:
+    enum Section { ENTRIES, STRINGS, CONTENTS, SECTIONS };
+
+    char magic[4];
+    int32_t version;
+
+    /** The byte offset and number of records (or bytes) of each array. */
+    CompiledRange sections[SECTIONS];
+  };
+
+  /** A resource, as its path and a range of bytes in the contents. */
+  class ResourceArchiveEntry {
+  public:
+    int32_t path;
+    int32_t offset;
+    int32_t length;
+  };
+
+}
+
 using namespace mbostock;
 
+static const char magic[] = { 'P', 'B', 'G', 'A' };
+
+/* Enough for any record in the compiled formats, which are read in place. */
+static const int alignment = 16;
+
+static ResourceArchive archive_;
+
+/* Maps the specified file, setting its data and length. */
+static bool mapFile(const char* path, const char** data, size_t* length) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    ::close(fd);
+    *data = "";
+    *length = 0;
+    return true;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  *data = (const char*) p;
+  *length = st.st_size;
+  return true;
+}
+
+Resource::Resource()
+    : data_(NULL), length_(0), mapped_(false) {
+}
+
+Resource::~Resource() {
+  close();
+}
+
+bool Resource::open(const char* path) {
+  close();
+  if (archive_.find(path, &data_, &length_)) {
+    return true;
+  }
+  std::string fullPath(Resources::path());
+  fullPath.append(path);
+  if (!mapFile(fullPath.c_str(), &data_, &length_)) {
+    return false;
+  }
+  mapped_ = (length_ > 0);
+  return true;
+}
+
+void Resource::close() {
+  if (mapped_) {
+    munmap((void*) data_, length_);
+    mapped_ = false;
+  }
+  data_ = NULL;
+  length_ = 0;
+}
+
+void Resource::swap(Resource& r) {
+  std::swap(data_, r.data_);
+  std::swap(length_, r.length_);
+  std::swap(mapped_, r.mapped_);
+}
+
+ResourceArchive::ResourceArchive()
+    : data_(NULL), length_(0) {
+  close();
+}
+
+ResourceArchive::~ResourceArchive() {
+  close();
+}
+
+bool ResourceArchive::open(const char* path) {
+  close();
+  const char* data;
+  size_t length;
+  if (!mapFile(path, &data, &length)) {
+    return false;
+  }
+  if ((length < sizeof(ResourceArchiveHeader)) || !load(data, length)) {
+    if (length > 0) {
+      munmap((void*) data, length);
+    }
+    data_ = NULL;
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ResourceArchive::close() {
+  if (data_ != NULL) {
+    munmap((void*) data_, length_);
+  }
+  data_ = NULL;
+  length_ = 0;
+  entries_ = NULL;
+  strings_ = NULL;
+  contents_ = NULL;
+  entryCount_ = stringsLength_ = contentsLength_ = 0;
+}
+
+bool ResourceArchive::find(const char* path, const char** data,
+    size_t* length) const {
+  int lo = 0, hi = entryCount_;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int c = strcmp(strings_ + entries_[mid].path, path);
+    if (c == 0) {
+      *data = contents_ + entries_[mid].offset;
+      *length = entries_[mid].length;
+      return true;
+    } else if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+/*
+ * Locates each array within the data, checking that it is aligned and within
+ * bounds, and then validates the index.
+ */
+bool ResourceArchive::load(const char* data, size_t length) {
+  data_ = data;
+  length_ = length;
+  static const size_t sizes[ResourceArchiveHeader::SECTIONS] = {
+    sizeof(ResourceArchiveEntry), 1, 1
+  };
+  const char* sections[ResourceArchiveHeader::SECTIONS];
+  if (!CompiledFormat::readSections<ResourceArchiveHeader>(data, length,
+          magic, version, sizes, sections)) {
+    return false;
+  }
+  const ResourceArchiveHeader& h = *(const ResourceArchiveHeader*) data;
+  if (h.sections[ResourceArchiveHeader::CONTENTS].begin % alignment != 0) {
+    return false;
+  }
+
+  entries_ = (const ResourceArchiveEntry*)
+      sections[ResourceArchiveHeader::ENTRIES];
+  strings_ = sections[ResourceArchiveHeader::STRINGS];
+  contents_ = sections[ResourceArchiveHeader::CONTENTS];
+  entryCount_ = h.sections[ResourceArchiveHeader::ENTRIES].count;
+  stringsLength_ = h.sections[ResourceArchiveHeader::STRINGS].count;
+  contentsLength_ = h.sections[ResourceArchiveHeader::CONTENTS].count;
+
+  /* Every string is terminated, so the table must end with a terminator. */
+  if ((stringsLength_ > 0) && (strings_[stringsLength_ - 1] != '\0')) {
+    return false;
+  }
+  return validate();
+}
+
+/*
+ * Checks that every resource lies within the contents, aligned, and that the
+ * paths are in strictly ascending order, as find expects.
+ */
+bool ResourceArchive::validate() const {
+  for (int i = 0; i < entryCount_; i++) {
+    const ResourceArchiveEntry& e = entries_[i];
+    if ((e.path < 0) || (e.path >= stringsLength_)
+        || (e.offset < 0) || (e.offset % alignment != 0) || (e.length < 0)
+        || (e.offset > contentsLength_ - e.length)) {
+      return false;
+    }
+    if ((i > 0)
+        && (strcmp(strings_ + entries_[i - 1].path, strings_ + e.path) >= 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Entries are kept sorted by path (as bytes, as strcmp compares them); adding
+ * a path again replaces its data.
+ */
+void ResourceArchiveWriter::add(const char* path, const char* data,
+    size_t length) {
+  std::vector<Entry>::iterator i = entries_.begin();
+  while ((i != entries_.end()) && (i->path < path)) {
+    i++;
+  }
+  if ((i == entries_.end()) || (i->path != path)) {
+    i = entries_.insert(i, Entry());
+    i->path = path;
+  }
+  i->data.assign(data, data + length);
+}
+
+size_t ResourceArchiveWriter::size() const {
+  size_t size = 0;
+  for (std::vector<Entry>::const_iterator i = entries_.begin();
+       i != entries_.end(); i++) {
+    size += i->data.size();
+  }
+  return size;
+}
+
+/* Each resource is padded to the alignment. */
+void ResourceArchiveWriter::write(std::vector<char>& out) const {
+  std::vector<ResourceArchiveEntry> entries;
+  std::vector<char> strings;
+  std::vector<char> contents;
+  for (std::vector<Entry>::const_iterator i = entries_.begin();
+       i != entries_.end(); i++) {
+    ResourceArchiveEntry e;
+    e.path = strings.size();
+    e.offset = contents.size();
+    e.length = i->data.size();
+    entries.push_back(e);
+    strings.insert(strings.end(), i->path.begin(), i->path.end());
+    strings.push_back('\0');
+    contents.insert(contents.end(), i->data.begin(), i->data.end());
+    contents.resize((contents.size() + alignment - 1) & ~(alignment - 1));
+  }
+
+  ResourceArchiveHeader h;
+  CompiledFormat::writeHeader(out, h, magic, ResourceArchive::version);
+  CompiledFormat::writeSection(out, h, ResourceArchiveHeader::ENTRIES, entries);
+  CompiledFormat::writeSection(out, h, ResourceArchiveHeader::STRINGS, strings);
+  out.resize((out.size() + alignment - 1) & ~(alignment - 1));
+  CompiledFormat::writeSection(out, h, ResourceArchiveHeader::CONTENTS,
+      contents);
+  memcpy(&out[0], &h, sizeof(h));
+}
+
 const char* Resources::path() {
   return "Contents/Resources/";
 }
 
-const char* Resources::readFile(const char* p) {
-  std::string fullPath(path());
-  fullPath.append(p);
-  std::ifstream file(fullPath.c_str());
-  file.seekg(0, std::ios::end);
-  std::ifstream::pos_type size = file.tellg();
-  file.seekg(0, std::ios::beg);
-  char* buffer = new char[1 + size];
-  file.read(buffer, size);
-  buffer[size] = '\0';
-  file.close();
-  return buffer;
+void Resources::initialize() {
+  std::string path(Resources::path());
+  path.append("resources.pba");
+  archive_.open(path.c_str());
+}
+
+const ResourceArchive& Resources::archive() {
+  return archive_;
 }
@@ -3,12 +3,131 @@
 #ifndef MBOSTOCK_RESOURCE_H
 #define MBOSTOCK_RESOURCE_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 namespace mbostock {
 
+  class ResourceArchiveEntry;
+
+  /**
+   * A read-only view of a resource's bytes, read in place rather than copied.
+   * Resources in the archive are views into its mapping; others are mapped
+   * from their own files, and unmapped when closed. Resources can't be
+   * copied, but can be swapped, so that a loader can take one over.
+   */
+  class Resource {
+  public:
+    Resource();
+    ~Resource();
+
+    /**
+     * Opens the resource at the specified path, relative to the resources,
+     * from the archive if it has it; returns false if it is missing.
+     */
+    bool open(const char* path);
+
+    void close();
+    void swap(Resource& r);
+
+    inline bool opened() const { return data_ != NULL; }
+    inline const char* data() const { return data_; }
+    inline size_t length() const { return length_; }
+
+  private:
+    Resource(const Resource& r);
+    Resource& operator=(const Resource& r);
+
+    const char* data_;
+    size_t length_;
+    bool mapped_;
+  };
+
+  /**
+   * An archive of resources: an index of paths, sorted so that they can be
+   * found by binary search, followed by the data of each, aligned so that
+   * compiled resources can be read in place. Opening the archive maps it into
+   * memory and validates the index; as with CompiledWorld, it is stored in
+   * native byte order.
+   */
+  class ResourceArchive {
+  public:
+    ResourceArchive();
+    ~ResourceArchive();
+
+    static const int version = 1;
+
+    /** Maps the specified file; returns false if it is missing or invalid. */
+    bool open(const char* path);
+
+    void close();
+
+    inline bool opened() const { return data_ != NULL; }
+
+    /** The size of the file in bytes. */
+    inline size_t length() const { return length_; }
+
+    inline int entries() const { return entryCount_; }
+
+    /**
+     * Finds the resource at the specified path, setting its data and length;
+     * returns false if absent.
+     */
+    bool find(const char* path, const char** data, size_t* length) const;
+
+  private:
+    bool load(const char* data, size_t length);
+    bool validate() const;
+
+    const char* data_;
+    size_t length_;
+
+    const ResourceArchiveEntry* entries_;
+    const char* strings_;
+    const char* contents_;
+    int entryCount_;
+    int stringsLength_;
+    int contentsLength_;
+  };
+
+  /**
+   * Accumulates resources and serializes them in the format read by
+   * ResourceArchive. The data is copied, so it need not outlive add.
+   */
+  class ResourceArchiveWriter {
+  public:
+    void add(const char* path, const char* data, size_t length);
+
+    /** Returns the total size of the resources, without padding. */
+    size_t size() const;
+
+    void write(std::vector<char>& out) const;
+
+  private:
+    class Entry {
+    public:
+      std::string path;
+      std::vector<char> data;
+    };
+
+    std::vector<Entry> entries_;
+  };
+
   class Resources {
   public:
     static const char* path();
-    static const char* readFile(const char* path);
+
+    /**
+     * Maps the archive of resources (resources.pba), if there is one. Call
+     * this before opening any resources; they are then read from the archive
+     * where possible, without opening their files.
+     */
+    static void initialize();
+
+    /** Returns the archive, which is not opened if there isn't one. */
+    static const ResourceArchive& archive();
 
   private:
     Resources();
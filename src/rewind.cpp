@@ -0,0 +1,134 @@
+// -*- C++ -*-
+
+#include <string.h>
+
+#include "rewind.h"
+
+using namespace mbostock;
+
+/*
+ * Differences are encoded in groups of four words: a control byte with two bits
+ * per word giving the number of low-order bytes that are stored, followed by
+ * those bytes, least significant first.
+ */
+static const int lengths[] = { 0, 2, 3, 4 };
+
+static int code(uint32_t d) {
+  if (d == 0) {
+    return 0;
+  } else if (d < 0x10000) {
+    return 1;
+  } else if (d < 0x1000000) {
+    return 2;
+  }
+  return 3;
+}
+
+static uint32_t word(const float* x, int i) {
+  uint32_t w;
+  memcpy(&w, x + i, sizeof(w));
+  return w;
+}
+
+RewindBuffer::RewindBuffer(int capacity, int keyInterval)
+    : capacity_(capacity), keyInterval_(keyInterval), sinceKey_(0) {
+}
+
+void RewindBuffer::clear() {
+  frames_.clear();
+  last_.clear();
+  sinceKey_ = 0;
+}
+
+void RewindBuffer::push(const Snapshot& s) {
+  int n = s.size();
+  bool key = frames_.empty() || (sinceKey_ + 1 >= keyInterval_)
+      || (n != last_.size());
+  frames_.push_back(Frame());
+  Frame& f = frames_.back();
+  f.key = key;
+  f.size = n;
+  if (n > 0) {
+    encode(s.data(), key ? NULL : last_.data(), n, f.data);
+    last_.resize(n);
+    memcpy(last_.data(), s.data(), n * sizeof(float));
+  }
+  sinceKey_ = key ? 0 : sinceKey_ + 1;
+
+  /* Discard the oldest key frame and its deltas. */
+  if ((int) frames_.size() > capacity_) {
+    do {
+      frames_.pop_front();
+    } while (!frames_.empty() && !frames_.front().key);
+  }
+}
+
+/* The next push can't be a delta from the popped snapshot, so it's a key. */
+void RewindBuffer::pop() {
+  if (!frames_.empty()) {
+    frames_.pop_back();
+    sinceKey_ = keyInterval_;
+  }
+}
+
+bool RewindBuffer::restore(int back, Snapshot& s) const {
+  int target = (int) frames_.size() - 1 - back;
+  if ((back < 0) || (target < 0)) {
+    return false;
+  }
+  int i = target;
+  while (!frames_[i].key) {
+    i--;
+  }
+  s.resize(frames_[target].size);
+  if (s.size() > 0) {
+    memset(s.data(), 0, s.size() * sizeof(float));
+    for (; i <= target; i++) {
+      decode(frames_[i].data, s.data(), s.size());
+    }
+  }
+  return true;
+}
+
+int RewindBuffer::bytes() const {
+  int bytes = 0;
+  std::deque<Frame>::const_iterator i;
+  for (i = frames_.begin(); i != frames_.end(); i++) {
+    bytes += i->data.size();
+  }
+  return bytes;
+}
+
+void RewindBuffer::encode(const float* x, const float* base, int n,
+    std::vector<unsigned char>& out) {
+  out.clear();
+  for (int i = 0; i < n; i += 4) {
+    int control = out.size();
+    out.push_back(0);
+    for (int j = 0; (j < 4) && (i + j < n); j++) {
+      uint32_t d = word(x, i + j) ^ ((base == NULL) ? 0 : word(base, i + j));
+      int c = code(d);
+      out[control] |= c << (j * 2);
+      for (int k = 0; k < lengths[c]; k++) {
+        out.push_back((d >> (k * 8)) & 0xff);
+      }
+    }
+  }
+}
+
+void RewindBuffer::decode(const std::vector<unsigned char>& in, float* x,
+    int n) {
+  const unsigned char* p = &in[0];
+  for (int i = 0; i < n; i += 4) {
+    int control = *p++;
+    for (int j = 0; (j < 4) && (i + j < n); j++) {
+      int c = (control >> (j * 2)) & 3;
+      uint32_t d = 0;
+      for (int k = 0; k < lengths[c]; k++) {
+        d |= (uint32_t) *p++ << (k * 8);
+      }
+      uint32_t w = word(x, i + j) ^ d;
+      memcpy(x + i + j, &w, sizeof(w));
+    }
+  }
+}
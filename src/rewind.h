@@ -0,0 +1,67 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_REWIND_H
+#define MBOSTOCK_REWIND_H
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+#include "physics/snapshot.h"
+
+namespace mbostock {
+
+  /**
+   * A bounded history of state snapshots, for rewinding. Each snapshot is
+   * stored as the bitwise difference from the one before it, and since
+   * consecutive snapshots differ mostly in the low bits of a few values, most
+   * of each difference compresses away. Every so often (or whenever the size
+   * of the state changes, as when changing rooms) a snapshot is stored whole
+   * as a key frame. When full, the oldest key frame and its deltas are
+   * discarded together.
+   */
+  class RewindBuffer {
+  public:
+    RewindBuffer(int capacity = 64, int keyInterval = 16);
+
+    void clear();
+
+    /** Appends a copy of the specified snapshot. */
+    void push(const Snapshot& s);
+
+    /** Removes the most recent snapshot. */
+    void pop();
+
+    /**
+     * Copies the snapshot saved the specified number of pushes ago (where zero
+     * is the most recent) into s. Returns false if there is no such snapshot.
+     */
+    bool restore(int back, Snapshot& s) const;
+
+    inline int size() const { return frames_.size(); }
+
+    /** Returns the compressed size of all snapshots, in bytes. */
+    int bytes() const;
+
+  private:
+    class Frame {
+    public:
+      bool key;
+      int size;
+      std::vector<unsigned char> data;
+    };
+
+    static void encode(const float* x, const float* base, int n,
+        std::vector<unsigned char>& out);
+    static void decode(const std::vector<unsigned char>& in, float* x, int n);
+
+    int capacity_;
+    int keyInterval_;
+    int sinceKey_;
+    std::deque<Frame> frames_;
+    Snapshot last_;
+  };
+
+}
+
+#endif
@@ -3,7 +3,11 @@
 #include <algorithm>
 #include <iostream>
 
+#include "jobs.h"
 #include "lighting.h"
+#include "material.h"
+#include "mesh.h"
+#include "physics/snapshot.h"
 #include "physics/transform.h"
 #include "physics/vector.h"
 #include "portal.h"
@@ -16,43 +20,164 @@
 
 using namespace mbostock;
 
+/*
+ * The static objects built of planar faces are baked into a mesh, in one batch
+ * per material. The others (such as tubes and balls, drawn by GLU) are each
+ * compiled into their own display list, which is called with the first
+ * material the object binds already bound; the room's lists then call the
+ * objects' lists grouped by that material, binding it only when it changes,
+ * rather than for every object. Objects with blended materials are drawn
+ * last, so that whatever they cover is drawn first.
+ */
 class RoomStaticModel : public Model {
 public:
-  RoomStaticModel(const Room& room) : room_(room) {}
-
-  virtual void initialize() {
-    staticObjects_.clear();
-    std::vector<RoomObject*>::const_iterator i;
-    for (i = room_.objects().begin(); i != room_.objects().end(); i++) {
-      RoomObject* o = *i;
-      if (!o->dynamic()) {
-        o->model().initialize();
-        staticObjects_.push_back(o);
-      }
+  RoomStaticModel(const Room& room);
+  virtual ~RoomStaticModel();
+
+  virtual void initialize();
+  virtual void display();
+
+private:
+  class Entry {
+  public:
+    RoomObject* object;
+    std::vector<const Material*> materials;
+    bool blended;
+    int group;
+    int index;
+
+    bool operator<(const Entry& e) const;
+  };
+
+  void clear();
+
+  const Room& room_;
+  Mesh mesh_;
+  std::vector<Entry> entries_;
+  GLuint lists_;
+  GLuint list_;
+};
+
+/*
+ * Objects that bind a second material come last in their group, so that the
+ * group's material is bound again as rarely as possible.
+ */
+bool RoomStaticModel::Entry::operator<(const Entry& e) const {
+  if (blended != e.blended) {
+    return e.blended;
+  }
+  if (group != e.group) {
+    return group < e.group;
+  }
+  if ((materials.size() > 1) != (e.materials.size() > 1)) {
+    return e.materials.size() > 1;
+  }
+  return index < e.index;
+}
+
+RoomStaticModel::RoomStaticModel(const Room& room)
+    : room_(room), lists_(GL_NONE), list_(GL_NONE) {
+}
+
+RoomStaticModel::~RoomStaticModel() {
+  clear();
+}
+
+void RoomStaticModel::clear() {
+  if (list_ != GL_NONE) {
+    glDeleteLists(lists_, entries_.size());
+    glDeleteLists(list_, 2);
+    lists_ = list_ = GL_NONE;
+  }
+  mesh_.clear();
+  entries_.clear();
+}
+
+void RoomStaticModel::initialize() {
+  clear();
+  std::vector<RoomObject*>::const_iterator i;
+  for (i = room_.objects().begin(); i != room_.objects().end(); i++) {
+    if ((*i)->dynamic()) {
+      continue;
+    }
+    (*i)->model().initialize();
+    if (!(*i)->model().bake(mesh_)) {
+      Entry e;
+      e.object = *i;
+      e.index = entries_.size();
+      entries_.push_back(e);
     }
   }
+  mesh_.initialize();
 
-  virtual void display() {
-    std::vector<RoomObject*>::const_iterator i;
-    for (i = staticObjects_.begin(); i != staticObjects_.end(); i++) {
-      (*i)->model().display();
+  /* Groups are numbered by first appearance, to keep the order if possible. */
+  std::vector<const Material*> groups;
+  lists_ = glGenLists(entries_.size());
+  std::vector<Entry>::iterator e;
+  for (e = entries_.begin(); e != entries_.end(); e++) {
+    Materials::record(e->materials);
+    glNewList(lists_ + e->index, GL_COMPILE);
+    e->object->model().display();
+    glEndList();
+    Materials::stop();
+    e->blended = false;
+    std::vector<const Material*>::const_iterator m;
+    for (m = e->materials.begin(); m != e->materials.end(); m++) {
+      e->blended |= (*m)->blended();
+    }
+    const Material* first = e->materials.empty() ? NULL : e->materials[0];
+    e->group = std::find(groups.begin(), groups.end(), first) - groups.begin();
+    if (e->group == (int) groups.size()) {
+      groups.push_back(first);
     }
   }
+  std::stable_sort(entries_.begin(), entries_.end());
 
-private:
-  const Room& room_;
-  std::vector<RoomObject*> staticObjects_;
-};
+  /*
+   * The first list calls the opaque objects, and the second the blended ones;
+   * the mesh's batches are drawn in between, so nothing is bound on entry.
+   */
+  list_ = glGenLists(2);
+  e = entries_.begin();
+  for (int blended = 0; blended < 2; blended++) {
+    const Material* bound = NULL;
+    glNewList(list_ + blended, GL_COMPILE);
+    for (; (e != entries_.end()) && (e->blended == (blended == 1)); e++) {
+      if (!e->materials.empty()) {
+        if (e->materials.front() != bound) {
+          e->materials.front()->bind();
+        }
+        bound = e->materials.back();
+      }
+      glCallList(lists_ + e->index);
+    }
+    glEndList();
+  }
+}
+
+void RoomStaticModel::display() {
+  mesh_.display(false);
+  glCallList(list_);
+  mesh_.display(true);
+  glCallList(list_ + 1);
+}
 
 RoomModel::RoomModel(const Room& room)
-    : room_(room), staticModel_(Models::compile(new RoomStaticModel(room))) {
+    : room_(room), staticModel_(new RoomStaticModel(room)),
+      initialized_(false) {
 }
 
 RoomModel::~RoomModel() {
   delete staticModel_;
 }
 
+/*
+ * The textures bound while compiling are recorded, so that they stay resident
+ * for as long as the room is loaded; they are uploaded once compiled.
+ */
 void RoomModel::initialize() {
+  textures_.clear();
+  textures_.record();
   room_.lighting().initialize();
   staticModel_->initialize();
   dynamicObjects_.clear();
@@ -64,25 +189,44 @@ void RoomModel::initialize() {
       dynamicObjects_.push_back(o);
     }
   }
+  textures_.stop();
+  initialized_ = true;
 }
 
 void RoomModel::display() {
-  if (World::world()->paused()) {
+  if (World::world()->model().paused()) {
     World::world()->pauseLighting().display();
   } else {
     room_.lighting().display();
   }
   staticModel_->display();
-  std::vector<RoomObject*>::const_iterator i;
-  for (i = dynamicObjects_.begin(); i != dynamicObjects_.end(); i++) {
-    (*i)->model().display();
+
+  /* The eye is recovered from the modelview matrix, to sort by depth. */
+  float m[16];
+  glGetFloatv(GL_MODELVIEW_MATRIX, m);
+  Vector eye(
+      -(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]),
+      -(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]),
+      -(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]));
+
+  /*
+   * Objects are sorted by the published point closest to the player, as their
+   * shapes belong to the simulation thread; until a snapshot of this room is
+   * loaded, the objects are displayed unsorted.
+   */
+  queue_.clear();
+  bool sorted = (depthPoints_.size() == dynamicObjects_.size());
+  for (size_t i = 0; i < dynamicObjects_.size(); i++) {
+    float d = sorted ? (depthPoints_[i] - eye).length() : 0.f;
+    queue_.add(dynamicObjects_[i]->model(), d);
   }
+  queue_.display();
 }
 
 Room::Room()
     : lighting_(&(Lightings::standard())), music_(NULL),
       cameraBounds_(-Vector::INF(), Vector::INF()),
-      model_(*this), trail_(NULL) {
+      model_(*this), trailModel_(trails_) {
 }
 
 Room::~Room() {
@@ -106,20 +250,10 @@ Room::~Room() {
   for (iz = transforms_.begin(); iz != transforms_.end(); iz++) {
     delete (*iz);
   }
-  std::vector<Trail*>::const_iterator it;
-  for (it = trails_.begin(); it != trails_.end(); it++) {
-    delete (*it);
-  }
-  if (trail_ != NULL) {
-    delete trail_;
-  }
 }
 
 void Room::nextTrail(const Vector& origin) {
-  if (trail_ != NULL) {
-    trails_.push_back(trail_);
-  }
-  trail_ = new Trail(origin);
+  trails_.next(origin);
 }
 
 void Room::setMusic(const Sound& music) {
@@ -148,14 +282,129 @@ void Room::applyForce(UnaryForce& force) {
   }
 }
 
+/*
+ * Rooms with many transforms or objects step them in parallel. Within each
+ * phase, every transform or object updates only its own state, so the result
+ * is the same however the work is divided; the phases themselves remain in
+ * order, since objects depend on their transforms.
+ */
+static const int parallelThreshold = 256;
+static const int parallelGrain = 64;
+
+namespace {
+
+  class RoomStep {
+  public:
+    const std::vector<Transform*>* transforms;
+    const std::vector<RoomObject*>* objects;
+    const ParticleSimulator* simulator;
+  };
+
+}
+
+static void stepTransforms(void* data, int begin, int end) {
+  const std::vector<Transform*>& transforms = *((RoomStep*) data)->transforms;
+  for (int i = begin; i < end; i++) {
+    transforms[i]->step();
+  }
+}
+
+static void stepObjects(void* data, int begin, int end) {
+  RoomStep* r = (RoomStep*) data;
+  const std::vector<RoomObject*>& objects = *r->objects;
+  for (int i = begin; i < end; i++) {
+    objects[i]->step(*r->simulator);
+  }
+}
+
+static void constrainObjects(void* data, int begin, int end) {
+  const std::vector<RoomObject*>& objects = *((RoomStep*) data)->objects;
+  for (int i = begin; i < end; i++) {
+    objects[i]->constrainInternal();
+  }
+}
+
+static void phase(void (*f)(void* data, int begin, int end), RoomStep& r,
+    int n) {
+  if (n < parallelThreshold) {
+    f(&r, 0, n);
+  } else {
+    Jobs::parallelFor(0, n, parallelGrain, f, &r);
+  }
+}
+
 void Room::step(const ParticleSimulator& s) {
-  std::vector<Transform*>::const_iterator ir;
-  for (ir = transforms_.begin(); ir != transforms_.end(); ir++) {
-    (*ir)->step();
+  RoomStep r;
+  r.transforms = &transforms_;
+  r.objects = &objects_;
+  r.simulator = &s;
+  phase(stepTransforms, r, transforms_.size());
+  phase(stepObjects, r, objects_.size());
+}
+
+void Room::constrainInternal() {
+  RoomStep r;
+  r.transforms = &transforms_;
+  r.objects = &objects_;
+  r.simulator = NULL;
+  phase(constrainObjects, r, objects_.size());
+}
+
+void Room::saveDisplay(Snapshot& s, const Vector& origin) const {
+  std::vector<RoomObject*>::const_iterator i;
+  for (i = objects_.begin(); i != objects_.end(); i++) {
+    if ((*i)->dynamic()) {
+      (*i)->saveDisplay(s);
+      s.write((*i)->shape().project(origin).x);
+    }
   }
+}
+
+void Room::loadDisplay(Snapshot& s) {
+  model_.depthPoints_.clear();
   std::vector<RoomObject*>::const_iterator i;
   for (i = objects_.begin(); i != objects_.end(); i++) {
-    (*i)->step(s);
+    if ((*i)->dynamic()) {
+      (*i)->loadDisplay(s);
+      model_.depthPoints_.push_back(s.readVector());
+    }
+  }
+}
+
+void Room::saveState(Snapshot& s) const {
+  saveObjectState(s);
+  s.write(trails_.count());
+  s.write(trails_.points());
+}
+
+void Room::saveObjectState(Snapshot& s) const {
+  std::vector<Transform*>::const_iterator it;
+  for (it = transforms_.begin(); it != transforms_.end(); it++) {
+    (*it)->saveState(s);
+  }
+  std::vector<RoomObject*>::const_iterator i;
+  for (i = objects_.begin(); i != objects_.end(); i++) {
+    if ((*i)->dynamic()) {
+      (*i)->saveState(s);
+    }
+  }
+}
+
+void Room::loadState(Snapshot& s) {
+  std::vector<Transform*>::const_iterator it;
+  for (it = transforms_.begin(); it != transforms_.end(); it++) {
+    (*it)->loadState(s);
+  }
+  std::vector<RoomObject*>::const_iterator i;
+  for (i = objects_.begin(); i != objects_.end(); i++) {
+    if ((*i)->dynamic()) {
+      (*i)->loadState(s);
+    }
+  }
+  int trails = (int) s.read();
+  int points = (int) s.read();
+  if (trails > 0) {
+    trails_.truncate(trails, points);
   }
 }
 
@@ -6,6 +6,9 @@
 #include <vector>
 
 #include "model.h"
+#include "render_queue.h"
+#include "texture.h"
+#include "trail.h"
 
 namespace mbostock {
 
@@ -17,8 +20,8 @@ namespace mbostock {
   class RoomObject;
   class RoomOrigin;
   class Shape;
+  class Snapshot;
   class Sound;
-  class Trail;
   class Transform;
   class UnaryForce;
 
@@ -30,10 +33,19 @@ namespace mbostock {
     virtual void initialize();
     virtual void display();
 
+    /** Returns true once initialized, as rooms may be built at any time. */
+    inline bool initialized() const { return initialized_; }
+
   private:
     const Room& room_;
     std::vector<RoomObject*> dynamicObjects_;
+    std::vector<Vector> depthPoints_;
     Model* staticModel_;
+    RenderQueue queue_;
+    TextureSet textures_;
+    bool initialized_;
+
+    friend class Room;
   };
 
   class Room {
@@ -51,10 +63,10 @@ namespace mbostock {
     inline const std::vector<RoomOrigin*>& origins() const { return origins_; }
     inline const std::vector<RoomObject*>& objects() const { return objects_; }
     inline const std::vector<Portal*>& portals() const { return portals_; }
-    inline const std::vector<Trail*>& trails() const { return trails_; }
 
-    inline Model& model() { return model_; }
-    inline Trail& trail() { return *trail_; }
+    inline RoomModel& model() { return model_; }
+    inline Trails& trails() { return trails_; }
+    inline TrailModel& trailModel() { return trailModel_; }
     inline const Lighting& lighting() const { return *lighting_; }
     inline const AxisAlignedBox& cameraBounds() const { return cameraBounds_; }
     inline const Sound* music() const { return music_; }
@@ -65,21 +77,48 @@ namespace mbostock {
     void resetForces();
     void applyForce(UnaryForce& force);
     void step(const ParticleSimulator& s);
+
+    /** Applies each object's internal constraints. */
+    void constrainInternal();
+
     void reset();
     void nextTrail(const Vector& origin);
 
+    /**
+     * Saves the display state of the room's dynamic objects, for loading by
+     * another thread into the room's models. The closest point on each object
+     * to the specified origin (the player) is saved too, so that the objects
+     * can be sorted by depth without reading their shapes while displaying.
+     */
+    void saveDisplay(Snapshot& s, const Vector& origin) const;
+    void loadDisplay(Snapshot& s);
+
+    /**
+     * Saves (or loads) the mutable state of the room's transforms and dynamic
+     * objects, and the length of its trails. Loading truncates any trails that
+     * have grown since the state was saved.
+     */
+    void saveState(Snapshot& s) const;
+    void loadState(Snapshot& s);
+
+    /**
+     * Saves the state as saveState does, but without the trails, which depend
+     * on how often the room was entered rather than on the simulation.
+     */
+    void saveObjectState(Snapshot& s) const;
+
   private:
     std::vector<RoomForce*> forces_;
     std::vector<RoomOrigin*> origins_;
     std::vector<RoomObject*> objects_;
     std::vector<Portal*> portals_;
-    std::vector<Trail*> trails_;
     std::vector<Transform*> transforms_;
     const Lighting* lighting_;
     const Sound* music_;
     AxisAlignedBox cameraBounds_;
     RoomModel model_;
-    Trail* trail_;
+    Trails trails_;
+    TrailModel trailModel_;
   };
 
   class RoomOrigin {
@@ -0,0 +1,353 @@
+// -*- C++ -*-
+
+#include <SDL/SDL.h>
+#include <algorithm>
+
+#include "physics/vector.h"
+#include "room.h"
+#include "room_cache.h"
+#include "trail.h"
+
+using namespace mbostock;
+
+RoomLoader::~RoomLoader() {
+}
+
+RoomCache::Slot::Slot()
+    : cache(NULL), index(-1), status(UNLOADED), room(NULL), built(NULL),
+      used(0), size(0), owner(-1), saved(false) {
+}
+
+RoomCache::RoomCache()
+    : loader_(NULL), budget_(defaultBudget), bytes_(0), clock_(0),
+      trailCapacity_(Trails::defaultCapacity), displayed_(false),
+      retiredLock_(SDL_CreateMutex()) {
+}
+
+RoomCache::~RoomCache() {
+  clear();
+  collect(NULL);
+  SDL_DestroyMutex(retiredLock_);
+}
+
+/*
+ * Rooms still being built must be waited for, since their jobs refer to the
+ * slots (and the loader).
+ */
+void RoomCache::clear() {
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    Slot& s = *slots_[i];
+    if ((s.status == LOADING) && (s.owner == i)) {
+      Jobs::wait(s.job);
+    }
+  }
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    Slot* s = slots_[i];
+    delete s->room;
+    delete s->built;
+    delete s;
+  }
+  slots_.clear();
+  bytes_ = 0;
+  delete loader_;
+  loader_ = NULL;
+}
+
+void RoomCache::setLoader(RoomLoader* loader) {
+  clear();
+  loader_ = loader;
+  for (int i = 0; i < loader_->rooms(); i++) {
+    Slot* s = new Slot();
+    s->cache = this;
+    s->index = i;
+    slots_.push_back(s);
+  }
+}
+
+/* Marks every room of the group; returns true if any wasn't marked already. */
+static bool mark(const std::vector<int>& group, std::vector<bool>& marked) {
+  bool changed = false;
+  std::vector<int>::const_iterator k;
+  for (k = group.begin(); k != group.end(); k++) {
+    if (!marked[*k]) {
+      marked[*k] = changed = true;
+    }
+  }
+  return changed;
+}
+
+/*
+ * Rooms still being built are finished first, since their jobs refer to the
+ * old loader. A changed room is rebuilt along with the rest of its group, as
+ * grouped by either loader; if the number of rooms changed, every room is
+ * rebuilt. Rebuilt rooms start afresh, since any saved state was for the old
+ * room.
+ */
+void RoomCache::reload(RoomLoader* loader, std::vector<int>& changed) {
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    Slot& s = *slots_[i];
+    if ((s.status == LOADING) && (s.owner == i)) {
+      finish(i);
+    }
+  }
+
+  int n = loader->rooms();
+  bool same = (n == (int) slots_.size());
+  std::vector<bool> dirty(n, !same);
+  if (same) {
+    std::vector<char> a, b;
+    for (int i = 0; i < n; i++) {
+      a.clear();
+      b.clear();
+      loader_->fingerprint(i, a);
+      loader->fingerprint(i, b);
+      dirty[i] = (a != b);
+    }
+    std::vector<int> group;
+    for (bool spread = true; spread;) {
+      spread = false;
+      for (int i = 0; i < n; i++) {
+        if (dirty[i]) {
+          loader_->group(i, group);
+          spread |= mark(group, dirty);
+          loader->group(i, group);
+          spread |= mark(group, dirty);
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    Slot& s = *slots_[i];
+    if ((i < n) && !dirty[i]) {
+      continue;
+    }
+    if (s.status == LOADED) {
+      retire(s.room);
+      s.room = NULL;
+      bytes_ -= s.size;
+    }
+    s.status = UNLOADED;
+    s.state.clear();
+    s.saved = false;
+  }
+  retire(loader_);
+  loader_ = loader;
+  while ((int) slots_.size() > n) {
+    delete slots_.back();
+    slots_.pop_back();
+  }
+  while ((int) slots_.size() < n) {
+    Slot* s = new Slot();
+    s->cache = this;
+    s->index = slots_.size();
+    slots_.push_back(s);
+  }
+  for (int i = 0; i < n; i++) {
+    if (dirty[i]) {
+      changed.push_back(i);
+    }
+  }
+}
+
+int RoomCache::size() const {
+  return slots_.size();
+}
+
+Room* RoomCache::room(int i) {
+  Slot& s = *slots_[i];
+  if (s.status == UNLOADED) {
+    request(i);
+  }
+  if (s.status == LOADING) {
+    finish(s.owner);
+  }
+  s.used = ++clock_;
+  return s.room;
+}
+
+void RoomCache::prefetch(int i) {
+  if ((i < 0) || (i >= (int) slots_.size())) {
+    return;
+  }
+  Slot& s = *slots_[i];
+  if (s.status == UNLOADED) {
+    request(i);
+  }
+  s.used = ++clock_;
+}
+
+/*
+ * Submits a job to build the room's group. The first room of the group owns
+ * the job; the others just refer to it. Each room is assumed to fill its
+ * trails, which often outweigh the rest of the room.
+ */
+void RoomCache::request(int i) {
+  std::vector<int> group;
+  loader_->group(i, group);
+  std::vector<int>::const_iterator k;
+  for (k = group.begin(); k != group.end(); k++) {
+    Slot& s = *slots_[*k];
+    s.status = LOADING;
+    s.owner = group[0];
+    s.size = loader_->size(*k) + trailCapacity_ * sizeof(Vector);
+    bytes_ += s.size;
+  }
+  Slot& o = *slots_[group[0]];
+  o.group = group;
+  o.job = Job(build, &o);
+  Jobs::submit(o.job);
+}
+
+/* Runs on any thread: builds the group, leaving the rooms to be adopted. */
+void RoomCache::build(void* data) {
+  Slot& o = *(Slot*) data;
+  RoomCache& cache = *o.cache;
+  std::vector<Room*> rooms;
+  cache.loader_->load(o.group, rooms);
+  for (int k = 0; k < (int) o.group.size(); k++) {
+    cache.slots_[o.group[k]]->built = rooms[k];
+  }
+}
+
+void RoomCache::finish(int owner) {
+  Slot& o = *slots_[owner];
+  Jobs::wait(o.job);
+  std::vector<int>::const_iterator k;
+  for (k = o.group.begin(); k != o.group.end(); k++) {
+    adopt(*slots_[*k]);
+  }
+}
+
+/*
+ * Adopting a room restores the state it had when it was last evicted, so that
+ * reloading is invisible to the simulation. Only the end of its trails is
+ * kept, enough for the newest trail to continue as it would have.
+ */
+void RoomCache::adopt(Slot& s) {
+  s.room = s.built;
+  s.built = NULL;
+  s.status = LOADED;
+  s.room->trails().setCapacity(trailCapacity_);
+  if (s.saved) {
+    s.state.rewind();
+    s.room->loadState(s.state);
+    s.room->trails().loadTail(s.state);
+  }
+}
+
+/*
+ * Rooms that have finished building in the background are adopted first, so
+ * that they can be evicted too. Then the least-recently used groups are
+ * evicted until the cache is within budget, or only the kept group remains.
+ */
+void RoomCache::evict(int keep) {
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    Slot& s = *slots_[i];
+    if ((s.status == LOADING) && (s.owner == i) && s.job.done()) {
+      finish(i);
+    }
+  }
+
+  std::vector<int> kept;
+  if (keep >= 0) {
+    loader_->group(keep, kept);
+  }
+  while (bytes_ > budget_) {
+    Slot* lru = NULL;
+    for (int i = 0; i < (int) slots_.size(); i++) {
+      Slot* s = slots_[i];
+      if ((s->status == LOADED)
+          && (std::find(kept.begin(), kept.end(), i) == kept.end())
+          && ((lru == NULL) || (s->used < lru->used))) {
+        lru = s;
+      }
+    }
+    if (lru == NULL) {
+      break;
+    }
+    std::vector<int> group;
+    loader_->group(lru->index, group);
+    std::vector<int>::const_iterator k;
+    for (k = group.begin(); k != group.end(); k++) {
+      Slot& s = *slots_[*k];
+      s.state.clear();
+      s.room->saveState(s.state);
+      s.room->trails().saveTail(s.state);
+      s.saved = true;
+      retire(s.room);
+      s.room = NULL;
+      s.status = UNLOADED;
+      bytes_ -= s.size;
+    }
+  }
+}
+
+void RoomCache::setBudget(size_t bytes) {
+  budget_ = bytes;
+}
+
+void RoomCache::setTrailCapacity(int points) {
+  trailCapacity_ = points;
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    if (slots_[i]->status == LOADED) {
+      slots_[i]->room->trails().setCapacity(points);
+    }
+  }
+}
+
+void RoomCache::loaded(std::vector<Room*>& out) const {
+  for (int i = 0; i < (int) slots_.size(); i++) {
+    if (slots_[i]->status == LOADED) {
+      out.push_back(slots_[i]->room);
+    }
+  }
+}
+
+void RoomCache::retire(Room* r) {
+  if (!displayed_) {
+    delete r;
+    return;
+  }
+  SDL_mutexP(retiredLock_);
+  retired_.push_back(r);
+  SDL_mutexV(retiredLock_);
+}
+
+/*
+ * A replaced loader owns the materials and lightings of the rooms it built, so
+ * it outlives every evicted room.
+ */
+void RoomCache::retire(RoomLoader* loader) {
+  if (!displayed_) {
+    delete loader;
+    return;
+  }
+  SDL_mutexP(retiredLock_);
+  retiredLoaders_.push_back(loader);
+  SDL_mutexV(retiredLock_);
+}
+
+void RoomCache::collect(const Room* displayed) {
+  std::vector<Room*> retired;
+  std::vector<RoomLoader*> loaders;
+  SDL_mutexP(retiredLock_);
+  retired.swap(retired_);
+  std::vector<Room*>::iterator i = std::find(retired.begin(), retired.end(),
+      displayed);
+  if (i != retired.end()) {
+    retired_.push_back(*i);
+    retired.erase(i);
+  }
+  if (retired_.empty()) {
+    loaders.swap(retiredLoaders_);
+  }
+  SDL_mutexV(retiredLock_);
+  for (i = retired.begin(); i != retired.end(); i++) {
+    delete *i;
+  }
+  std::vector<RoomLoader*>::const_iterator l;
+  for (l = loaders.begin(); l != loaders.end(); l++) {
+    delete *l;
+  }
+}
@@ -0,0 +1,167 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_ROOM_CACHE_H
+#define MBOSTOCK_ROOM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "jobs.h"
+#include "physics/snapshot.h"
+
+struct SDL_mutex;
+
+namespace mbostock {
+
+  class Room;
+
+  /**
+   * Builds a world's rooms on demand. Rooms whose switches target transforms
+   * in other rooms can't be built apart, so rooms are built in groups; nearly
+   * always, a room's group is just the room itself.
+   */
+  class RoomLoader {
+  public:
+    virtual ~RoomLoader();
+
+    virtual int rooms() const = 0;
+
+    /** Returns the rooms that are built along with the specified room. */
+    virtual void group(int room, std::vector<int>& rooms) const = 0;
+
+    /** Returns an estimate of the memory used by the room, in bytes. */
+    virtual size_t size(int room) const = 0;
+
+    /**
+     * Builds the specified group of rooms, in order, appending them to out.
+     * May be called from any thread, and by several threads at once.
+     */
+    virtual void load(const std::vector<int>& rooms,
+        std::vector<Room*>& out) const = 0;
+
+    /**
+     * Appends a fingerprint of everything the room is built from, so that
+     * rooms with equal fingerprints (in this loader or another) are built the
+     * same.
+     */
+    virtual void fingerprint(int room, std::vector<char>& out) const = 0;
+  };
+
+  /**
+   * The rooms of a world, built on demand by a RoomLoader and cached. Rooms can
+   * be prefetched, in which case they are built by the job system in the
+   * background. When the estimated size of the cached rooms exceeds the
+   * budget, the least-recently used rooms are evicted; an evicted room's state
+   * is saved, and restored if the room is built again, so that eviction can't
+   * be observed (except that only the end of its trails is kept).
+   *
+   * Rooms are only requested and evicted by the simulation thread. Once a
+   * display is attached, an evicted room may still be displayed (from an
+   * older snapshot), so it is only deleted when the display collects it.
+   */
+  class RoomCache {
+  public:
+    RoomCache();
+    ~RoomCache();
+
+    static const size_t defaultBudget = 64 << 20;
+
+    /** Sets the loader, which is then owned by the cache. */
+    void setLoader(RoomLoader* loader);
+    inline RoomLoader* loader() const { return loader_; }
+
+    /**
+     * Replaces the loader (as setLoader), keeping the rooms whose fingerprints
+     * are unchanged, along with their state and models. The other rooms are
+     * evicted, to be built by the new loader when next requested, and their
+     * indexes appended to changed. The old loader is deleted along with the
+     * rooms it built, once none is displayed. Only call this while the
+     * simulation thread is stopped (or locked out).
+     */
+    void reload(RoomLoader* loader, std::vector<int>& changed);
+
+    /** Returns the number of rooms in the world, loaded or not. */
+    int size() const;
+
+    /** Returns the specified room, building it (or waiting for it) first. */
+    Room* room(int i);
+
+    /** Starts building the specified room in the background. */
+    void prefetch(int i);
+
+    /** Evicts rooms until within the budget, except the specified room. */
+    void evict(int keep);
+
+    void setBudget(size_t bytes);
+    inline size_t budget() const { return budget_; }
+
+    /** Returns the estimated size of the rooms built or being built. */
+    inline size_t bytes() const { return bytes_; }
+
+    /** Sets the number of trail points kept, for current and future rooms. */
+    void setTrailCapacity(int points);
+
+    /** Appends the rooms currently built to out. */
+    void loaded(std::vector<Room*>& out) const;
+
+    /**
+     * Defers deleting evicted rooms until collect is called, as when they may
+     * be displayed. Only call this while the simulation thread is stopped.
+     */
+    inline void setDisplayed(bool displayed) { displayed_ = displayed; }
+
+    /**
+     * Deletes evicted rooms, except the specified room (if displayed), and
+     * replaced loaders once no evicted room remains.
+     */
+    void collect(const Room* displayed);
+
+  private:
+    enum Status { UNLOADED, LOADING, LOADED };
+
+    class Slot {
+    public:
+      Slot();
+
+      RoomCache* cache;
+      int index;
+      Status status;
+      Room* room;
+      Room* built;
+      uint32_t used;
+      size_t size;
+
+      /** For loading slots, the first room of the group, which has the job. */
+      int owner;
+      std::vector<int> group;
+      Job job;
+
+      /** The room's state when it was last evicted, if ever. */
+      Snapshot state;
+      bool saved;
+    };
+
+    static void build(void* slot);
+    void request(int i);
+    void finish(int owner);
+    void adopt(Slot& s);
+    void retire(Room* r);
+    void retire(RoomLoader* loader);
+    void clear();
+
+    RoomLoader* loader_;
+    std::vector<Slot*> slots_;
+    size_t budget_;
+    size_t bytes_;
+    uint32_t clock_;
+    int trailCapacity_;
+    bool displayed_;
+    SDL_mutex* retiredLock_;
+    std::vector<Room*> retired_;
+    std::vector<RoomLoader*> retiredLoaders_;
+  };
+
+}
+
+#endif
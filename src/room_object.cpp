@@ -35,6 +35,18 @@ void RoomObject::constrainInternal() {
 void RoomObject::reset() {
 }
 
+void RoomObject::saveDisplay(Snapshot& s) const {
+}
+
+void RoomObject::loadDisplay(Snapshot& s) {
+}
+
+void RoomObject::saveState(Snapshot& s) const {
+}
+
+void RoomObject::loadState(Snapshot& s) {
+}
+
 bool DynamicRoomObject::dynamic() const {
   return true;
 }
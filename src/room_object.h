@@ -8,6 +8,7 @@ namespace mbostock {
   class Model;
   class ParticleSimulator;
   class Shape;
+  class Snapshot;
   class UnaryForce;
   class Vector;
 
@@ -24,6 +25,16 @@ namespace mbostock {
     virtual void step(const ParticleSimulator& s);
     virtual void constrainInternal();
     virtual void reset();
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+
+    /**
+     * Saves (or loads) the mutable state of the object, such that loading it
+     * restores the object exactly, as for rewinding. Transforms are saved with
+     * the room rather than with the objects they transform.
+     */
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
   };
 
   class DynamicRoomObject : public RoomObject {
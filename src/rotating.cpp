@@ -3,12 +3,13 @@
 #include <math.h>
 
 #include "physics/particle.h"
+#include "physics/snapshot.h"
 #include "rotating.h"
 
 using namespace mbostock;
 
 RotatingModel::RotatingModel(Model& m, const Rotation& r)
-    : model_(m), rotation_(r) {
+    : model_(m), rotation_(r), angle_(r.angle()) {
 }
 
 void RotatingModel::initialize() {
@@ -18,12 +19,16 @@ void RotatingModel::initialize() {
 void RotatingModel::display() {
   glPushMatrix();
   glTranslatev(rotation_.origin());
-  glRotatev(rotation_.angle(), rotation_.axis());
+  glRotatev(angle_, rotation_.axis());
   glTranslatev(-rotation_.origin());
   model_.display();
   glPopMatrix();
 }
 
+const Material* RotatingModel::firstMaterial() const {
+  return model_.firstMaterial();
+}
+
 RotatingRoomObject::RotatingRoomObject(RoomObject* o, const Rotation& r)
     : TransformingRoomObject(o), rotation_(r),
       shape_(o->shape(), r), model_(o->model(), r) {
@@ -44,3 +49,13 @@ Vector RotatingRoomObject::velocity(const Vector& x) const {
   }
   return v;
 }
+
+void RotatingRoomObject::saveDisplay(Snapshot& s) const {
+  s.write(rotation_.angle());
+  TransformingRoomObject::saveDisplay(s);
+}
+
+void RotatingRoomObject::loadDisplay(Snapshot& s) {
+  model_.setAngle(s.read());
+  TransformingRoomObject::loadDisplay(s);
+}
@@ -12,16 +12,25 @@
 
 namespace mbostock {
 
+  /**
+   * Displays a model rotated by a rotation. The angle is displayed as most
+   * recently set, rather than read from the rotation, so that the rotation may
+   * be stepped on another thread.
+   */
   class RotatingModel : public Model {
   public:
     RotatingModel(Model& m, const Rotation& r);
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
+
+    inline void setAngle(float angle) { angle_ = angle; }
 
   private:
     Model& model_;
     const Rotation& rotation_;
+    float angle_;
   };
 
   class RotatingRoomObject : public TransformingRoomObject {
@@ -31,6 +40,8 @@ namespace mbostock {
     virtual Model& model();
     virtual const Shape& shape() const;
     virtual Vector velocity(const Vector& x) const;
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
 
   private:
     const Rotation& rotation_;
@@ -7,6 +7,7 @@
 #include "physics/force.h"
 #include "physics/particle.h"
 #include "physics/shape.h"
+#include "physics/snapshot.h"
 #include "physics/vector.h"
 #include "seesaw.h"
 
@@ -16,7 +17,7 @@ static const float centerOffset = .1f;
 
 Seesaw::Seesaw(const Vector& min, const Vector& max, float mass)
     : origin_((min + max) / 2.f), size_(max - min), drag_(1.f),
-      model_(box_) {
+      model_(displayBox_) {
   left_.inverseMass = 1.f / (mass * .1f);
   right_.inverseMass = 1.f / (mass * .1f);
   center_.inverseMass = 1.f / (mass * .8f);
@@ -58,22 +59,48 @@ void Seesaw::step(const ParticleSimulator& s) {
   s.step(left_);
   s.step(right_);
   s.step(center_);
-  updateBox();
+  box_ = box(left_.position, right_.position);
 }
 
-void Seesaw::updateBox() {
-  Vector x = (right_.position - left_.position) / size_.x;
+Box Seesaw::box(const Vector& left, const Vector& right) const {
+  Vector x = (right - left) / size_.x;
   Vector y = -x.cross(Vector::Z()) * size_.y / 2.f;
   Vector z = Vector::Z() * size_.z / 2.f;
-  box_ = Box(
-      left_.position - z - y,
-      right_.position - z - y,
-      right_.position + z - y,
-      left_.position + z - y,
-      right_.position - z + y,
-      left_.position - z + y,
-      left_.position + z + y,
-      right_.position + z + y);
+  return Box(
+      left - z - y,
+      right - z - y,
+      right + z - y,
+      left + z - y,
+      right - z + y,
+      left - z + y,
+      left + z + y,
+      right + z + y);
+}
+
+/* The displayed box is rebuilt from the end particles. */
+
+void Seesaw::saveDisplay(Snapshot& s) const {
+  s.write(left_.position);
+  s.write(right_.position);
+}
+
+void Seesaw::loadDisplay(Snapshot& s) {
+  Vector left = s.readVector();
+  Vector right = s.readVector();
+  displayBox_ = box(left, right);
+}
+
+void Seesaw::saveState(Snapshot& s) const {
+  s.write(left_);
+  s.write(right_);
+  s.write(center_);
+}
+
+void Seesaw::loadState(Snapshot& s) {
+  s.readParticle(left_);
+  s.readParticle(right_);
+  s.readParticle(center_);
+  box_ = box(left_.position, right_.position);
 }
 
 void Seesaw::constrainInternal() {
@@ -101,7 +128,7 @@ void Seesaw::reset() {
   left_.previousPosition = left_.position;
   right_.previousPosition = right_.position;
   center_.previousPosition = center_.position;
-  updateBox();
+  box_ = box(left_.position, right_.position);
 }
 
 void Seesaw::setMaterial(const Material& m) {
@@ -27,18 +27,23 @@ namespace mbostock {
     virtual void constrainInternal();
     virtual void reset();
     virtual float slip() const;
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
 
     void setMaterial(const Material& m);
     void setTopMaterial(const Material& m);
 
   private:
-    void updateBox();
+    Box box(const Vector& left, const Vector& right) const;
 
     const Vector origin_;
     const Vector size_;
     LinearDragForce drag_;
 
     Box box_;
+    Box displayBox_;
     Particle left_;
     Particle right_;
     Particle center_;
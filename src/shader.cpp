@@ -50,8 +50,7 @@ Shader* Shaders::normalShader() {
 }
 
 GlslShader::GlslShader(const char* vertexPath, const char* fragmentPath)
-  : vertexPath_(vertexPath), fragmentPath_(fragmentPath),
-    program_(GL_NONE) {
+  : vertexPath_(vertexPath), fragmentPath_(fragmentPath), program_(GL_NONE) {
 }
 
 GlslShader::~GlslShader() {
@@ -60,21 +59,31 @@ GlslShader::~GlslShader() {
   }
 }
 
+/* The sources are kept, since the program is rebuilt with each context. */
+void GlslShader::load() {
+  if (!vertexSource_.opened()) {
+    vertexSource_.open(vertexPath_);
+    fragmentSource_.open(fragmentPath_);
+  }
+}
+
 void GlslShader::initialize() {
   if (program_ != GL_NONE) {
     glDeleteProgram(program_);
   }
+  load();
   program_ = glCreateProgram();
-  attach(vertexPath_, GL_VERTEX_SHADER);
-  attach(fragmentPath_, GL_FRAGMENT_SHADER);
+  attach(vertexSource_, GL_VERTEX_SHADER);
+  attach(fragmentSource_, GL_FRAGMENT_SHADER);
   link();
 }
 
-void GlslShader::attach(const char* path, GLenum shaderType) {
+/* The source is given with its length, as it isn't terminated. */
+void GlslShader::attach(const Resource& source, GLenum shaderType) {
+  const GLchar* data = source.data();
+  GLint length = source.length();
   GLuint shader = glCreateShader(shaderType);
-  const char* source = Resources::readFile(path);
-  glShaderSource(shader, 1, &source, NULL);
-  delete[] source;
+  glShaderSource(shader, 1, &data, &length);
   glCompileShader(shader);
   glAttachShader(program_, shader);
 }
@@ -5,6 +5,8 @@
 
 #include <OpenGL/gl.h>
 
+#include "resource.h"
+
 namespace mbostock {
 
   class Model;
@@ -13,6 +15,12 @@ namespace mbostock {
   public:
     virtual ~Shader() {};
 
+    /**
+     * Reads whatever the shader needs that doesn't need a GL context, such as
+     * its sources, ahead of initialize. May be called from any thread.
+     */
+    virtual void load() {}
+
     virtual void initialize() {}
     virtual void display(Model& model) = 0;
   };
@@ -22,15 +30,18 @@ namespace mbostock {
     GlslShader(const char* vertexPath, const char* fragmentPath);
     virtual ~GlslShader();
 
+    virtual void load();
     virtual void initialize();
     virtual void display(Model& model);
 
   private:
-    void attach(const char* path, GLenum shaderType);
+    void attach(const Resource& source, GLenum shaderType);
     void link();
 
     const char* vertexPath_;
     const char* fragmentPath_;
+    Resource vertexSource_;
+    Resource fragmentSource_;
     GLuint program_;
   };
 
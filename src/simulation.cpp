@@ -1,6 +1,7 @@
 // -*- C++ -*-
 
 #include <SDL/sdl.h>
+#include <SDL/SDL_thread.h>
 
 #include "simulation.h"
 
@@ -14,32 +15,198 @@ using namespace mbostock;
  */
 static const uint32_t maxSkippedMs = 500;
 
+/*
+ * Similarly, if the steps themselves are slow, then catching up on all the
+ * skipped time makes the next simulate slower still. So a single simulate takes
+ * at most this many steps by default, and the overload policy decides what to
+ * do with the rest.
+ */
+static const uint32_t defaultStepBudget = 8;
+
+/* The slowest rate of the dilated clock, and its recovery per simulate. */
+static const float minDilation = .1f;
+static const float dilationRecovery = .005f;
+
+/*
+ * The quality is lowered after a quarter second of overload, and raised again
+ * after two seconds without; the overload pressure moves eight times faster
+ * up than down.
+ */
+static const int32_t qualityMs = 2000;
+static const int32_t overloadWeight = 8;
+
+/* The wall time over which the time ratio is measured. */
+static const uint32_t ratioWindowMs = 500;
+
 Simulation::Simulation(uint32_t timeStepMs)
-  : timeStepMs_(timeStepMs), skippedMs_(0), lastTimeMs_(0), paused_(false) {
+  : timeStepMs_(timeStepMs), skippedMs_(0), lastTimeMs_(0), paused_(false),
+    stepBudget_(defaultStepBudget), policy_(DROP_TIME), overloaded_(false),
+    dilation_(1.f), dilatedMs_(0.f), quality_(0), pressureMs_(0),
+    windowWallMs_(0), windowSimulatedMs_(0), timeRatio_(1.f),
+    mutex_(SDL_CreateMutex()), thread_(NULL), stopped_(true) {
 }
 
-uint32_t Simulation::elapsedMillis() {
-  uint32_t currentTimeMs = SDL_GetTicks();
-  uint32_t differenceMs = currentTimeMs - lastTimeMs_;
-  lastTimeMs_ = currentTimeMs;
-  return differenceMs;
+Simulation::~Simulation() {
+  SDL_DestroyMutex(mutex_);
 }
 
 void Simulation::togglePaused() {
   paused_ = !paused_;
 }
 
+void Simulation::setOverloadPolicy(OverloadPolicy policy) {
+  policy_ = policy;
+  dilation_ = 1.f;
+  dilatedMs_ = 0.f;
+  quality_ = 0;
+  pressureMs_ = 0;
+}
+
+void Simulation::lock() {
+  SDL_mutexP(mutex_);
+}
+
+void Simulation::unlock() {
+  SDL_mutexV(mutex_);
+}
+
+/*
+ * The skipped time is the interval between the last simulated step and now, so
+ * the pending steps begin at successive times starting from now minus the
+ * skipped time. Input is applied between steps up to its arrival time, and any
+ * input may pause the simulation partway through.
+ */
 void Simulation::simulate() {
+  lock();
+  uint32_t currentTimeMs = SDL_GetTicks();
   if (paused_ || (lastTimeMs_ == 0)) {
-    lastTimeMs_ = SDL_GetTicks();
-    return;
+    lastTimeMs_ = currentTimeMs;
+    input(currentTimeMs);
+    overloaded_ = false;
+  } else {
+    uint32_t elapsedMs = currentTimeMs - lastTimeMs_;
+    float dilatedMs = elapsedMs * dilation_ + dilatedMs_;
+    skippedMs_ += (uint32_t) dilatedMs;
+    dilatedMs_ = dilatedMs - (uint32_t) dilatedMs;
+    lastTimeMs_ = currentTimeMs;
+    if (skippedMs_ > maxSkippedMs) {
+      skippedMs_ = timeStepMs_;
+    }
+    uint32_t stepTimeMs = currentTimeMs - skippedMs_;
+    uint32_t steps = 0;
+    while ((skippedMs_ >= timeStepMs_) && (steps < stepBudget_)) {
+      input(stepTimeMs);
+      if (paused_) {
+        break;
+      }
+      step();
+      skippedMs_ -= timeStepMs_;
+      stepTimeMs += timeStepMs_;
+      steps++;
+    }
+    overloaded_ = !paused_ && (skippedMs_ >= timeStepMs_);
+    overload(elapsedMs, steps);
+    measure(elapsedMs, steps);
   }
-  skippedMs_ += elapsedMillis();
-  if (skippedMs_ > maxSkippedMs) {
-    skippedMs_ = timeStepMs_;
+  publish();
+  unlock();
+}
+
+/*
+ * Applies the overload policy to whatever time remains after the step budget
+ * is spent. When dilating, the clock slows in proportion to the shortfall, and
+ * the remaining time is dropped since the slower clock now accounts for it.
+ * When degrading, the remaining time is kept (up to maxSkippedMs) and
+ * simulated once the rest of the game sheds enough work.
+ */
+void Simulation::overload(uint32_t elapsedMs, uint32_t steps) {
+  switch (policy_) {
+    case DROP_TIME: {
+      if (overloaded_) {
+        skippedMs_ %= timeStepMs_;
+      }
+      break;
+    }
+    case DILATE_TIME: {
+      if (overloaded_) {
+        uint32_t simulatedMs = steps * timeStepMs_;
+        uint32_t droppedMs = skippedMs_ - skippedMs_ % timeStepMs_;
+        dilation_ *= simulatedMs / (float) (simulatedMs + droppedMs);
+        if (dilation_ < minDilation) {
+          dilation_ = minDilation;
+        }
+        skippedMs_ -= droppedMs;
+      } else if (dilation_ < 1.f) {
+        dilation_ += dilationRecovery;
+        if (dilation_ > 1.f) {
+          dilation_ = 1.f;
+        }
+      }
+      break;
+    }
+    case DEGRADE_QUALITY: {
+      if (overloaded_) {
+        pressureMs_ += elapsedMs * overloadWeight;
+      } else {
+        pressureMs_ -= elapsedMs;
+      }
+      if (pressureMs_ >= qualityMs) {
+        if (quality_ < maxQuality) {
+          quality_++;
+        }
+        pressureMs_ = 0;
+      } else if (pressureMs_ <= -qualityMs) {
+        if (quality_ > 0) {
+          quality_--;
+        }
+        pressureMs_ = 0;
+      }
+      break;
+    }
   }
-  while (skippedMs_ >= timeStepMs_) {
-    step();
-    skippedMs_ -= timeStepMs_;
+}
+
+void Simulation::measure(uint32_t elapsedMs, uint32_t steps) {
+  windowWallMs_ += elapsedMs;
+  windowSimulatedMs_ += steps * timeStepMs_;
+  if (windowWallMs_ >= ratioWindowMs) {
+    timeRatio_ = windowSimulatedMs_ / (float) windowWallMs_;
+    windowWallMs_ = 0;
+    windowSimulatedMs_ = 0;
+  }
+}
+
+void Simulation::start() {
+  if (thread_ == NULL) {
+    stopped_ = false;
+    thread_ = SDL_CreateThread(run, this);
+  }
+}
+
+void Simulation::stop() {
+  if (thread_ != NULL) {
+    stopped_ = true;
+    SDL_WaitThread(thread_, NULL);
+    thread_ = NULL;
+  }
+}
+
+/*
+ * The simulation thread sleeps until the next step is due, rather than
+ * spinning; while paused, it polls for input once per time step. If steps are
+ * still pending after an overloaded simulate, it only yields.
+ */
+int Simulation::run(void* simulation) {
+  Simulation* s = (Simulation*) simulation;
+  while (!s->stopped_) {
+    s->simulate();
+    if (s->paused_) {
+      SDL_Delay(s->timeStepMs_);
+    } else if (s->skippedMs_ < s->timeStepMs_) {
+      SDL_Delay(s->timeStepMs_ - s->skippedMs_);
+    } else {
+      SDL_Delay(0);
+    }
   }
+  return 0;
 }
@@ -4,29 +4,101 @@
 #define MBOSTOCK_SIMULATION_H
 
 #include <stdint.h>
+#include <stdlib.h>
+
+struct SDL_mutex;
+struct SDL_Thread;
 
 namespace mbostock {
 
   class Simulation {
   public:
     Simulation(uint32_t timeStepMs);
-    virtual ~Simulation() {}
+    virtual ~Simulation();
 
     virtual void togglePaused();
     inline bool paused() const { return paused_; }
 
     void simulate();
 
+    /**
+     * What to do with time that can't be simulated within the step budget.
+     * DROP_TIME discards it, so that the simulation falls behind the wall clock
+     * in small jumps. DILATE_TIME slows the simulated clock relative to the
+     * wall clock until the budget suffices, so that the simulation runs
+     * uniformly slower. DEGRADE_QUALITY keeps the time to catch up on later,
+     * and lowers the quality level so that the rest of the game does less work.
+     */
+    enum OverloadPolicy { DROP_TIME, DILATE_TIME, DEGRADE_QUALITY };
+
+    /** The maximum number of steps taken by a single simulate. */
+    inline uint32_t stepBudget() const { return stepBudget_; }
+    inline void setStepBudget(uint32_t steps) { stepBudget_ = steps; }
+
+    inline OverloadPolicy overloadPolicy() const { return policy_; }
+    void setOverloadPolicy(OverloadPolicy policy);
+
+    /** Returns true if the last simulate ran out of step budget. */
+    inline bool overloaded() const { return overloaded_; }
+
+    /** Returns the recent ratio of simulated time to wall time. */
+    inline float timeRatio() const { return timeRatio_; }
+
+    /** Returns the quality level, from 0 (full quality) to maxQuality. */
+    inline int quality() const { return quality_; }
+    enum { maxQuality = 3 };
+
+    /**
+     * Runs the simulation on a dedicated thread at its fixed rate, until
+     * stopped. While the thread is running, simulate should not be called
+     * directly, and any state shared with other threads must be guarded by
+     * lock and unlock.
+     */
+    void start();
+    void stop();
+    inline bool running() const { return thread_ != NULL; }
+
+    /** Excludes the simulation thread from running simulate. */
+    void lock();
+    void unlock();
+
   protected:
     virtual void step() = 0;
 
+    /**
+     * Called before each step with the simulated time (in SDL ticks) at which
+     * the step begins, so that input which arrived up to that time may be
+     * applied. When catching up, the steps of a single simulate begin at
+     * successive times in the past. If paused, this is called once with the
+     * current time instead.
+     */
+    virtual void input(uint32_t timeMs) {}
+
+    /** Called on each simulate, after stepping (even if paused). */
+    virtual void publish() {}
+
   private:
-    uint32_t elapsedMillis();
+    static int run(void* simulation);
+    void overload(uint32_t elapsedMs, uint32_t steps);
+    void measure(uint32_t elapsedMs, uint32_t steps);
 
     uint32_t timeStepMs_;
     uint32_t skippedMs_;
     uint32_t lastTimeMs_;
     bool paused_;
+    uint32_t stepBudget_;
+    OverloadPolicy policy_;
+    volatile bool overloaded_;
+    float dilation_;
+    float dilatedMs_;
+    volatile int quality_;
+    int32_t pressureMs_;
+    uint32_t windowWallMs_;
+    uint32_t windowSimulatedMs_;
+    volatile float timeRatio_;
+    SDL_mutex* mutex_;
+    SDL_Thread* thread_;
+    volatile bool stopped_;
   };
 
 }
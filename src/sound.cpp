@@ -1,6 +1,8 @@
 // -*- C++ -*-
 
 #include <SDL/SDL_error.h>
+#include <SDL/SDL_mutex.h>
+#include <SDL/SDL_rwops.h>
 #include <SDL_mixer/SDL_mixer.h>
 #include <iostream>
 #include <string>
@@ -32,6 +34,8 @@ namespace mbostock {
     virtual void stop() const;
 
   private:
+    Resource resource_;
+    SDL_RWops* rw_;
     Mix_Music* music_;
   };
 
@@ -54,11 +58,18 @@ SoundImpl::SoundImpl(const char* path)
     : path_(path) {
 }
 
+/*
+ * Music is streamed from the resource as it plays, so the resource stays open
+ * for as long as the music.
+ */
 MusicImpl::MusicImpl(const char* path)
-    : SoundImpl(path) {
-  std::string fullPath(Resources::path());
-  fullPath.append(path);
-  music_ = Mix_LoadMUS(fullPath.c_str());
+    : SoundImpl(path), rw_(NULL), music_(NULL) {
+  if (!resource_.open(path)) {
+    std::cerr << "Couldn't open " << path << "\n";
+    return;
+  }
+  rw_ = SDL_RWFromConstMem(resource_.data(), resource_.length());
+  music_ = Mix_LoadMUS_RW(rw_);
   if (music_ == NULL) {
     std::cerr << SDL_GetError() << "\n";
   }
@@ -68,6 +79,9 @@ MusicImpl::~MusicImpl() {
   if (music_ != NULL) {
     Mix_FreeMusic(music_);
   }
+  if (rw_ != NULL) {
+    SDL_FreeRW(rw_);
+  }
 }
 
 void MusicImpl::play(int loops) const {
@@ -81,11 +95,16 @@ void MusicImpl::stop() const {
   Mix_HaltMusic();
 }
 
+/* Chunks are decoded as they are loaded, so the resource is closed after. */
 ChunkImpl::ChunkImpl(const char* path)
-    : SoundImpl(path), channel_(-1) {
-  std::string fullPath(Resources::path());
-  fullPath.append(path);
-  chunk_ = Mix_LoadWAV(fullPath.c_str());
+    : SoundImpl(path), chunk_(NULL), channel_(-1) {
+  Resource resource;
+  if (!resource.open(path)) {
+    std::cerr << "Couldn't open " << path << "\n";
+    return;
+  }
+  chunk_ = Mix_LoadWAV_RW(
+      SDL_RWFromConstMem(resource.data(), resource.length()), 1);
   if (chunk_ == NULL) {
     std::cerr << SDL_GetError() << "\n";
   }
@@ -116,6 +135,9 @@ static std::vector<SoundImpl*>& sounds() {
   return v;
 }
 
+/* Rooms are built on job threads, and open their music as they are. */
+static SDL_mutex* soundsLock = SDL_CreateMutex();
+
 void Sounds::initialize() {
   Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 1024);
 }
@@ -123,19 +145,25 @@ void Sounds::initialize() {
 void Sounds::dispose() {
   Mix_HaltMusic();
   Mix_HaltChannel(-1);
+  SDL_mutexP(soundsLock);
   std::vector<SoundImpl*>::const_iterator i;
   for (i = sounds().begin(); i != sounds().end(); i++) {
     delete *i;
   }
+  sounds().clear();
+  SDL_mutexV(soundsLock);
   Mix_CloseAudio();
 }
 
 Sound& Sounds::fromFile(const char* path) {
+  SDL_mutexP(soundsLock);
+
   /* First check to see if we've loaded this sound already. */
   std::vector<SoundImpl*>::const_iterator i;
   for (i = sounds().begin(); i != sounds().end(); i++) {
     SoundImpl& s = **i;
     if (strcmp(s.path(), path) == 0) {
+      SDL_mutexV(soundsLock);
       return s;
     }
   }
@@ -149,6 +177,7 @@ Sound& Sounds::fromFile(const char* path) {
           ? (SoundImpl*) new MusicImpl(path)
           : (SoundImpl*) new ChunkImpl(path);
   sounds().push_back(sound);
+  SDL_mutexV(soundsLock);
   return *sound;
 }
 
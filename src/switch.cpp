@@ -1,6 +1,7 @@
 // -*- C++ -*-
 
 #include "material.h"
+#include "physics/snapshot.h"
 #include "physics/transform.h"
 #include "physics/vector.h"
 #include "switch.h"
@@ -8,7 +9,7 @@
 using namespace mbostock;
 
 Switch::Switch(const Vector& min, const Vector& max)
-    : AxisAlignedBlock(min, max), activeMaterial_(NULL) {
+    : AxisAlignedBlock(min, max), active_(false), activeMaterial_(NULL) {
 }
 
 bool Switch::dynamic() const {
@@ -26,11 +27,19 @@ void Switch::setActiveMaterial(const Material& m) {
   inactiveTopMaterial_ = &model_.topMaterial();
 }
 
-void Switch::reset() {
-  if (activeMaterial_ != NULL) {
-    setMaterial(*inactiveMaterial_);
-    setTopMaterial(*inactiveTopMaterial_);
+/*
+ * The model's material is only changed when the display state is loaded, so
+ * the slip is derived from the active state rather than read from the model.
+ */
+float Switch::slip() const {
+  if (activeMaterial_ == NULL) {
+    return AxisAlignedBlock::slip();
   }
+  return (active_ ? activeMaterial_ : inactiveMaterial_)->slip();
+}
+
+void Switch::reset() {
+  active_ = false;
   std::vector<Transform*>::const_iterator i;
   for (i = targets_.begin(); i != targets_.end(); i++) {
     (*i)->enable(false);
@@ -38,12 +47,30 @@ void Switch::reset() {
 }
 
 void Switch::applyWeight(float w, const Vector& x) {
-  if (activeMaterial_ != NULL) {
-    setMaterial(*activeMaterial_);
-    setTopMaterial(*activeMaterial_);
-  }
+  active_ = true;
   std::vector<Transform*>::const_iterator i;
   for (i = targets_.begin(); i != targets_.end(); i++) {
     (*i)->enable();
   }
 }
+
+void Switch::saveDisplay(Snapshot& s) const {
+  s.write(active_ ? 1.f : 0.f);
+}
+
+void Switch::loadDisplay(Snapshot& s) {
+  bool active = (s.read() != 0.f);
+  if (activeMaterial_ != NULL) {
+    setMaterial(active ? *activeMaterial_ : *inactiveMaterial_);
+    setTopMaterial(active ? *activeMaterial_ : *inactiveTopMaterial_);
+  }
+}
+
+/* The targets' state is saved with the room's transforms. */
+void Switch::saveState(Snapshot& s) const {
+  s.write(active_ ? 1.f : 0.f);
+}
+
+void Switch::loadState(Snapshot& s) {
+  active_ = (s.read() != 0.f);
+}
@@ -16,14 +16,20 @@ namespace mbostock {
     Switch(const Vector& min, const Vector& max);
 
     virtual bool dynamic() const;
+    virtual float slip() const;
     virtual void applyWeight(float w, const Vector& x);
     virtual void reset();
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
 
     void addTarget(Transform& t);
     void setActiveMaterial(const Material& m);
 
   private:
     std::vector<Transform*> targets_;
+    bool active_;
     const Material* inactiveMaterial_;
     const Material* inactiveTopMaterial_;
     const Material* activeMaterial_;
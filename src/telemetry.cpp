@@ -0,0 +1,263 @@
+// -*- C++ -*-
+
+#include <SDL/SDL.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+using namespace mbostock;
+
+static const char magic[] = { 'P', 'B', 'G', 'T' };
+static const int version = 1;
+
+/* Positions are quantized to about a millimeter, and axes to 1/16384. */
+static const float originScale = 1024.f;
+static const float axisScale = 16384.f;
+
+/* How long the writer sleeps when there's nothing to write. */
+static const int writerDelayMs = 20;
+
+static void writeVarint(std::vector<unsigned char>& out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(v);
+}
+
+static bool readVarint(const unsigned char*& p, const unsigned char* end,
+    uint32_t& v) {
+  v = 0;
+  for (int shift = 0; (p < end) && (shift < 32); shift += 7) {
+    unsigned char b = *p++;
+    v |= (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Signed differences are zigzag encoded, so that small negatives are short. */
+static void writeDelta(std::vector<unsigned char>& out, int32_t d) {
+  writeVarint(out, ((uint32_t) d << 1) ^ (d >> 31));
+}
+
+static bool readDelta(const unsigned char*& p, const unsigned char* end,
+    int32_t& v) {
+  uint32_t u;
+  if (!readVarint(p, end, u)) {
+    return false;
+  }
+  v += (int32_t) ((u >> 1) ^ -(u & 1));
+  return true;
+}
+
+static int32_t quantize(float f, float scale) {
+  return (int32_t) lrintf(f * scale);
+}
+
+static void writeVector(std::vector<unsigned char>& out, const Vector& v,
+    const Vector& last, float scale) {
+  writeDelta(out, quantize(v.x, scale) - quantize(last.x, scale));
+  writeDelta(out, quantize(v.y, scale) - quantize(last.y, scale));
+  writeDelta(out, quantize(v.z, scale) - quantize(last.z, scale));
+}
+
+static bool readVector(const unsigned char*& p, const unsigned char* end,
+    int32_t* q, Vector& v, float scale) {
+  if (!readDelta(p, end, q[0])
+      || !readDelta(p, end, q[1])
+      || !readDelta(p, end, q[2])) {
+    return false;
+  }
+  v = Vector(q[0] / scale, q[1] / scale, q[2] / scale);
+  return true;
+}
+
+TelemetrySample::TelemetrySample()
+    : step(0), room(0), contacts(0) {
+}
+
+TelemetryRecorder::TelemetryRecorder(int interval)
+    : interval_(interval), file_(NULL), thread_(NULL), stopped_(false),
+      dropped_(0), chunkCount_(0) {
+}
+
+TelemetryRecorder::~TelemetryRecorder() {
+  close();
+}
+
+bool TelemetryRecorder::open(const char* path) {
+  close();
+  file_ = fopen(path, "wb");
+  if (file_ == NULL) {
+    return false;
+  }
+  std::vector<unsigned char> out(magic, magic + sizeof(magic));
+  out.push_back(version);
+  writeVarint(out, interval_);
+  fwrite(&out[0], 1, out.size(), file_);
+  chunk_.clear();
+  chunkCount_ = 0;
+  last_ = TelemetrySample();
+  stopped_ = false;
+  thread_ = SDL_CreateThread(run, this);
+  return true;
+}
+
+void TelemetryRecorder::close() {
+  if (file_ == NULL) {
+    return;
+  }
+  stopped_ = true;
+  SDL_WaitThread(thread_, NULL);
+  thread_ = NULL;
+  drain();
+  flush();
+  fclose(file_);
+  file_ = NULL;
+}
+
+void TelemetryRecorder::record(const TelemetrySample& s) {
+  if ((file_ != NULL) && !queue_.push(s)) {
+    dropped_++;
+  }
+}
+
+int TelemetryRecorder::run(void* recorder) {
+  TelemetryRecorder* r = (TelemetryRecorder*) recorder;
+  while (!r->stopped_) {
+    r->drain();
+    SDL_Delay(writerDelayMs);
+  }
+  return 0;
+}
+
+/* Encodes the queued samples, writing each chunk as it fills. */
+void TelemetryRecorder::drain() {
+  TelemetrySample s;
+  while (queue_.pop(s)) {
+    writeVarint(chunk_, s.step - last_.step);
+    writeDelta(chunk_, s.room - last_.room);
+    writeVector(chunk_, s.origin, last_.origin, originScale);
+    writeVector(chunk_, s.x, last_.x, axisScale);
+    writeVector(chunk_, s.y, last_.y, axisScale);
+    chunk_.push_back(s.contacts);
+    last_ = s;
+    if (++chunkCount_ == chunkSamples) {
+      flush();
+    }
+  }
+}
+
+void TelemetryRecorder::flush() {
+  if (chunkCount_ == 0) {
+    return;
+  }
+  std::vector<unsigned char> header;
+  writeVarint(header, chunkCount_);
+  writeVarint(header, chunk_.size());
+  fwrite(&header[0], 1, header.size(), file_);
+  fwrite(&chunk_[0], 1, chunk_.size(), file_);
+  fflush(file_);
+  chunk_.clear();
+  chunkCount_ = 0;
+  last_ = TelemetrySample();
+}
+
+TelemetryReader::TelemetryReader()
+    : data_(NULL), length_(0), interval_(0), size_(0) {
+}
+
+TelemetryReader::~TelemetryReader() {
+  close();
+}
+
+bool TelemetryReader::open(const char* path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(magic) + 2)) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = (const unsigned char*) data;
+  length_ = st.st_size;
+
+  const unsigned char* end = data_ + length_;
+  const unsigned char* p = data_ + sizeof(magic) + 1;
+  uint32_t interval;
+  if ((memcmp(data_, magic, sizeof(magic)) != 0)
+      || (data_[sizeof(magic)] != version)
+      || !readVarint(p, end, interval)) {
+    close();
+    return false;
+  }
+  interval_ = interval;
+
+  /* Index the chunks, stopping at any incomplete chunk at the end. */
+  uint32_t count, length;
+  while (readVarint(p, end, count) && readVarint(p, end, length)
+         && (length <= (uint32_t) (end - p))) {
+    Chunk c;
+    c.data = p;
+    c.count = count;
+    c.length = length;
+    chunks_.push_back(c);
+    size_ += count;
+    p += length;
+  }
+  return true;
+}
+
+void TelemetryReader::close() {
+  if (data_ != NULL) {
+    munmap((void*) data_, length_);
+  }
+  data_ = NULL;
+  length_ = 0;
+  interval_ = 0;
+  size_ = 0;
+  chunks_.clear();
+}
+
+void TelemetryReader::read(int chunk,
+    std::vector<TelemetrySample>& out) const {
+  const Chunk& c = chunks_[chunk];
+  const unsigned char* p = c.data;
+  const unsigned char* end = c.data + c.length;
+  uint32_t step = 0;
+  int32_t room = 0;
+  int32_t q[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  for (int i = 0; i < c.count; i++) {
+    TelemetrySample s;
+    uint32_t d;
+    if (!readVarint(p, end, d)
+        || !readDelta(p, end, room)
+        || !readVector(p, end, q, s.origin, originScale)
+        || !readVector(p, end, q + 3, s.x, axisScale)
+        || !readVector(p, end, q + 6, s.y, axisScale)
+        || (p == end)) {
+      return;
+    }
+    step += d;
+    s.step = step;
+    s.room = room;
+    s.contacts = *p++;
+    out.push_back(s);
+  }
+}
@@ -0,0 +1,124 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_TELEMETRY_H
+#define MBOSTOCK_TELEMETRY_H
+
+#include <SDL/SDL_thread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "physics/vector.h"
+
+namespace mbostock {
+
+  /**
+   * A sample of the player's state: the step index, the room index, the
+   * player's origin and orientation (its x and y axes; z is their cross
+   * product), and which wheels are touching the ground.
+   */
+  class TelemetrySample {
+  public:
+    enum Contact { LEFT = 1, RIGHT = 2 };
+
+    TelemetrySample();
+
+    uint32_t step;
+    int32_t room;
+    Vector origin;
+    Vector x;
+    Vector y;
+    uint8_t contacts;
+  };
+
+  /**
+   * Streams telemetry samples to a file on a background thread. Samples are
+   * passed through a lock-free queue, so recording never blocks the
+   * simulation; if the writer falls behind and the queue fills, samples are
+   * dropped (and counted) rather than waited for.
+   *
+   * The file is a small header (magic, version, and sample interval) followed
+   * by chunks of up to chunkSamples samples. Each chunk begins with its sample
+   * count and length in bytes, so that a reader can skip between chunks, and a
+   * chunk left incomplete by a crash is detectable. Within a chunk, positions
+   * and axes are quantized to fixed point, and every field is stored as the
+   * zigzag variable-length difference from the previous sample (the first
+   * sample of a chunk is stored relative to zero, so chunks are independent).
+   */
+  class TelemetryRecorder {
+  public:
+    TelemetryRecorder(int interval = 10);
+    ~TelemetryRecorder();
+
+    static const int chunkSamples = 1024;
+
+    /** Opens the file and starts the writer thread; returns false on error. */
+    bool open(const char* path);
+
+    /** Writes any queued samples, stops the writer, and closes the file. */
+    void close();
+
+    /** The number of steps between samples. */
+    inline int interval() const { return interval_; }
+
+    /** Queues a sample for writing. Only call from one thread. */
+    void record(const TelemetrySample& s);
+
+    inline int dropped() const { return dropped_; }
+
+  private:
+    static int run(void* recorder);
+    void drain();
+    void flush();
+
+    int interval_;
+    FILE* file_;
+    SDL_Thread* thread_;
+    volatile bool stopped_;
+    volatile int dropped_;
+    ConcurrentQueue<TelemetrySample, 4096> queue_;
+    std::vector<unsigned char> chunk_;
+    int chunkCount_;
+    TelemetrySample last_;
+  };
+
+  /**
+   * Reads a telemetry file by mapping it into memory. Only the chunk headers
+   * are read up front; chunks are decoded on demand, so that many long
+   * sessions can be scanned cheaply.
+   */
+  class TelemetryReader {
+  public:
+    TelemetryReader();
+    ~TelemetryReader();
+
+    bool open(const char* path);
+    void close();
+
+    inline int interval() const { return interval_; }
+    inline int chunks() const { return chunks_.size(); }
+    inline int size() const { return size_; }
+
+    /** Appends the samples in the specified chunk to out. */
+    void read(int chunk, std::vector<TelemetrySample>& out) const;
+
+  private:
+    class Chunk {
+    public:
+      const unsigned char* data;
+      int count;
+      int length;
+    };
+
+    const unsigned char* data_;
+    size_t length_;
+    int interval_;
+    int size_;
+    std::vector<Chunk> chunks_;
+  };
+
+}
+
+#endif
@@ -1,15 +1,21 @@
 // -*- C++ -*-
 
 #include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
 #include <OpenGL/glu.h>
 #include <SDL/sdl.h>
 #include <SDL_image/SDL_image.h>
+#include <algorithm>
 #include <iostream>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
+#include "compiled_texture.h"
+#include "jobs.h"
 #include "resource.h"
 #include "texture.h"
+#include "texture_image.h"
 
 using namespace mbostock;
 
@@ -18,61 +24,163 @@ public:
   TextureImpl(const char* path);
   virtual ~TextureImpl();
 
-  void initialize();
+  inline const std::string& path() const { return path_; }
+  inline bool resident() const { return resident_; }
+  inline size_t residentSize() const { return resident_ ? residentSize_ : 0; }
+  inline size_t size() const { return (image_ == NULL) ? 0 : image_->size(); }
+  inline uint32_t used() const { return used_; }
+  inline uint32_t bound() const { return bound_; }
+
+  void load();
+  void unload();
+  void reset();
+  void upload(GLuint buffer);
   virtual void bind() const;
+  virtual bool alpha() const;
+
+  /** References from materials and sets; and from sets alone. */
+  int refs;
+  int users;
 
 private:
+  void use();
+  void uploadCompiled();
+
   GLuint id_;
   bool alpha_;
+  bool resident_;
+  bool failed_;
   const std::string path_;
+  const CompiledTexture* compiled_;
+  TextureImage* image_;
+  size_t residentSize_;
+  uint32_t used_;
+  uint32_t bound_;
 };
 
+static size_t cacheBudget = Textures::defaultCacheBudget;
+static uint32_t cacheClock = 0;
+static TextureSet* recording = NULL;
+static CompiledTextures compiledTextures;
+static bool compression = false;
+
 TextureImpl::TextureImpl(const char* path)
-    : id_(GL_NONE), alpha_(false), path_(path) {
+    : refs(0), users(0), id_(GL_NONE), alpha_(false), resident_(false),
+      failed_(false), path_(path), compiled_(NULL), image_(NULL),
+      residentSize_(0), used_(0), bound_(0) {
 }
 
 TextureImpl::~TextureImpl() {
   if (id_ != GL_NONE) {
     glDeleteTextures(1, &id_);
   }
+  delete image_;
+}
+
+/*
+ * Textures are taken from the compiled textures if there, and otherwise
+ * decoded. Images that fail to load aren't tried again.
+ */
+void TextureImpl::load() {
+  if ((compiled_ != NULL) || (image_ != NULL) || failed_) {
+    return;
+  }
+  compiled_ = compiledTextures.find(path_.c_str());
+  if (compiled_ != NULL) {
+    return;
+  }
+  Resource resource;
+  if (!resource.open(path_.c_str())) {
+    std::cerr << "Couldn't open " << path_ << "\n";
+    failed_ = true;
+    return;
+  }
+  SDL_Surface* image = IMG_Load_RW(
+      SDL_RWFromConstMem(resource.data(), resource.length()), 1);
+  if (image == NULL) {
+    std::cerr << "Couldn't load " << path_ << ": " << SDL_GetError() << "\n";
+    failed_ = true;
+    return;
+  }
+  image_ = new TextureImage(image);
+  SDL_FreeSurface(image);
+}
+
+void TextureImpl::unload() {
+  delete image_;
+  image_ = NULL;
 }
 
-void TextureImpl::initialize() {
+void TextureImpl::reset() {
   if (id_ != GL_NONE) {
     glDeleteTextures(1, &id_);
+    id_ = GL_NONE;
   }
+  resident_ = false;
+}
 
-  std::string path(Resources::path());
-  path.append(path_);
-  SDL_Surface* image = IMG_Load(path.c_str());
-  if (image == NULL) {
-    std::cerr << "Couldn't load " << path << ": " << SDL_GetError() << "\n";
-    id_ = GL_NONE;
+/*
+ * The decoded image is kept after uploading, so that uploading again needn't
+ * decode it; see trim.
+ */
+void TextureImpl::upload(GLuint buffer) {
+  load();
+  if ((compiled_ == NULL) && (image_ == NULL)) {
     return;
   }
-
-	glGenTextures(1, &id_);
-	glBindTexture(GL_TEXTURE_2D, id_);
+  if (id_ == GL_NONE) {
+    glGenTextures(1, &id_);
+  }
+  glBindTexture(GL_TEXTURE_2D, id_);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  alpha_ = alpha();
+  if (compiled_ != NULL) {
+    uploadCompiled();
+  } else {
+    image_->upload(buffer);
+    residentSize_ = image_->size();
+  }
+  resident_ = true;
+  used_ = ++cacheClock;
+}
 
-  alpha_ = (image->format->BytesPerPixel == 4);
-  GLenum byteOrder = alpha_
-          ? ((image->format->Rmask == 0x000000FF) ? GL_RGBA : GL_BGRA)
-          : ((image->format->Rmask == 0x000000FF) ? GL_RGB : GL_BGR);
-
-	glTexImage2D(GL_TEXTURE_2D, 0,
-      image->format->BytesPerPixel, image->w, image->h, 0,
-      byteOrder, GL_UNSIGNED_BYTE, image->pixels);
-
-  gluBuild2DMipmaps(GL_TEXTURE_2D,
-      image->format->BytesPerPixel, image->w, image->h,
-      byteOrder, GL_UNSIGNED_BYTE, image->pixels);
+/*
+ * Compiled levels are uploaded straight from the mapped file, compressed if
+ * the driver supports it, so there is nothing to decode, filter or copy.
+ */
+void TextureImpl::uploadCompiled() {
+  const CompiledRange& r = compression
+      ? compiled_->compressedLevels
+      : compiled_->levels;
+  GLenum format = compression
+      ? (alpha_
+          ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+          : GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+      : (alpha_ ? GL_RGBA : GL_RGB);
+  residentSize_ = 0;
+  for (int i = 0; i < r.count; i++) {
+    const CompiledTextureLevel& l = compiledTextures.level(r.begin + i);
+    if (compression) {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, format, l.width, l.height, 0,
+          l.size, compiledTextures.pixels(l));
+    } else {
+      glTexImage2D(GL_TEXTURE_2D, i, alpha_ ? 4 : 3, l.width, l.height, 0,
+          format, GL_UNSIGNED_BYTE, compiledTextures.pixels(l));
+    }
+    residentSize_ += l.size;
+  }
+}
 
-  SDL_FreeSurface(image);
+bool TextureImpl::alpha() const {
+  const_cast<TextureImpl*>(this)->load();
+  return (compiled_ != NULL)
+      ? (compiled_->flags & CompiledTexture::ALPHA)
+      : ((image_ != NULL) && image_->alpha());
 }
 
 void TextureImpl::bind() const {
+  const_cast<TextureImpl*>(this)->use();
   if (alpha_) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -80,20 +188,208 @@ void TextureImpl::bind() const {
   glBindTexture(GL_TEXTURE_2D, id_);
 }
 
+static void uploadTextures(const std::vector<TextureImpl*>& textures);
+
+/*
+ * A texture bound while a set is recording needs a name, and to know whether
+ * it has alpha, but isn't uploaded until the set stops recording, since a
+ * display list may be being compiled. Otherwise, a texture that isn't
+ * resident is uploaded as it is bound.
+ */
+void TextureImpl::use() {
+  bound_ = SDL_GetTicks();
+  if (recording != NULL) {
+    recording->add(*this);
+    if (!resident_) {
+      load();
+      alpha_ = alpha();
+      if (id_ == GL_NONE) {
+        glGenTextures(1, &id_);
+      }
+    }
+  } else if (!resident_ && !failed_) {
+    uploadTextures(std::vector<TextureImpl*>(1, this));
+  }
+}
+
 static std::vector<TextureImpl*>& textures() {
   static std::vector<TextureImpl*> v;
   return v;
 }
 
+/* Discards the least-recently uploaded images until within the budget. */
+static void trim() {
+  while (Textures::cacheBytes() > cacheBudget) {
+    TextureImpl* lru = NULL;
+    std::vector<TextureImpl*>::const_iterator i;
+    for (i = textures().begin(); i != textures().end(); i++) {
+      if (((*i)->size() > 0)
+          && ((lru == NULL) || ((*i)->used() < lru->used()))) {
+        lru = *i;
+      }
+    }
+    lru->unload();
+  }
+}
+
+/* The levels are packed tightly, so rows needn't be aligned. */
+static void uploadTextures(const std::vector<TextureImpl*>& textures) {
+  if (textures.empty()) {
+    return;
+  }
+  GLuint buffer;
+  glGenBuffers(1, &buffer);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures.begin(); i != textures.end(); i++) {
+    (*i)->upload(buffer);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glDeleteBuffers(1, &buffer);
+  trim();
+}
+
+TextureSet::~TextureSet() {
+  clear();
+}
+
+void TextureSet::record() {
+  recording = this;
+}
+
+void TextureSet::stop() {
+  recording = NULL;
+  std::vector<TextureImpl*> pending;
+  std::vector<const Texture*>::const_iterator i;
+  for (i = textures_.begin(); i != textures_.end(); i++) {
+    TextureImpl* t = (TextureImpl*) *i;
+    if (!t->resident()) {
+      pending.push_back(t);
+    }
+  }
+  uploadTextures(pending);
+}
+
+void TextureSet::clear() {
+  std::vector<const Texture*>::const_iterator i;
+  for (i = textures_.begin(); i != textures_.end(); i++) {
+    ((TextureImpl*) *i)->users--;
+    Textures::release(**i);
+  }
+  textures_.clear();
+}
+
+void TextureSet::add(const Texture& t) {
+  if (std::find(textures_.begin(), textures_.end(), &t) == textures_.end()) {
+    TextureImpl& impl = (TextureImpl&) t;
+    impl.refs++;
+    impl.users++;
+    textures_.push_back(&t);
+  }
+}
+
 const Texture& Textures::fromFile(const char* path) {
+  /* First check to see if we've loaded this texture already. */
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures().begin(); i != textures().end(); i++) {
+    if ((*i)->path() == path) {
+      (*i)->refs++;
+      return **i;
+    }
+  }
+
+  /* If not, add the new texture. */
   TextureImpl* texture = new TextureImpl(path);
+  texture->refs++;
   textures().push_back(texture);
   return *texture;
 }
 
+void Textures::release(const Texture& t) {
+  TextureImpl* texture = (TextureImpl*) &t;
+  if (--texture->refs == 0) {
+    textures().erase(std::find(textures().begin(), textures().end(),
+        texture));
+    delete texture;
+  }
+}
+
+static void loadTextures(void* data, int begin, int end) {
+  for (int i = begin; i < end; i++) {
+    textures()[i]->load();
+  }
+}
+
+void Textures::load() {
+  Resource resource;
+  if (resource.open("textures.pbx")) {
+    compiledTextures.open(resource);
+  }
+  Jobs::parallelFor(0, textures().size(), 1, loadTextures, NULL);
+  trim();
+}
+
+/*
+ * Compiled textures are uploaded compressed if the new context supports S3TC,
+ * and uncompressed otherwise.
+ */
 void Textures::initialize() {
+  compression = gluCheckExtension(
+      (const GLubyte*) "GL_EXT_texture_compression_s3tc",
+      glGetString(GL_EXTENSIONS));
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures().begin(); i != textures().end(); i++) {
+    (*i)->reset();
+  }
+}
+
+/* No display list refers to an unused texture, so its name can go too. */
+void Textures::update() {
+  uint32_t now = SDL_GetTicks();
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures().begin(); i != textures().end(); i++) {
+    TextureImpl* t = *i;
+    if (t->resident() && (t->users == 0)
+        && (now - t->bound() > (uint32_t) residencyMillis)) {
+      t->reset();
+    }
+  }
+}
+
+void Textures::setCacheBudget(size_t bytes) {
+  cacheBudget = bytes;
+  trim();
+}
+
+size_t Textures::cacheBytes() {
+  size_t bytes = 0;
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures().begin(); i != textures().end(); i++) {
+    bytes += (*i)->size();
+  }
+  return bytes;
+}
+
+int Textures::count() {
+  return textures().size();
+}
+
+int Textures::residentCount() {
+  int count = 0;
+  std::vector<TextureImpl*>::const_iterator i;
+  for (i = textures().begin(); i != textures().end(); i++) {
+    if ((*i)->resident()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+size_t Textures::residentBytes() {
+  size_t bytes = 0;
   std::vector<TextureImpl*>::const_iterator i;
   for (i = textures().begin(); i != textures().end(); i++) {
-    (*i)->initialize();
+    bytes += (*i)->residentSize();
   }
+  return bytes;
 }
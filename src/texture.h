@@ -4,6 +4,8 @@
 #define MBOSTOCK_TEXTURE_H
 
 #include <OpenGL/gl.h>
+#include <stddef.h>
+#include <vector>
 
 namespace mbostock {
 
@@ -12,13 +14,86 @@ namespace mbostock {
     virtual ~Texture() {}
 
     virtual void bind() const = 0;
+
+    /** Returns true if the texture has alpha, loading it if needed. */
+    virtual bool alpha() const = 0;
   };
 
+  /**
+   * The textures used by a model, such as a room's, which are kept resident
+   * for as long as the set holds them. While recording, each texture bound is
+   * added to the set; since a model may be compiling a display list, any
+   * textures that aren't resident are only uploaded when recording stops.
+   * Only use on the display thread.
+   */
+  class TextureSet {
+  public:
+    ~TextureSet();
+
+    void record();
+    void stop();
+    void clear();
+
+    void add(const Texture& t);
+
+  private:
+    std::vector<const Texture*> textures_;
+  };
+
+  /**
+   * The textures used by materials, interned by path and counted, so that
+   * each image is decoded and uploaded once however many materials use it.
+   *
+   * A texture is resident (uploaded) while a TextureSet holds it, as when a
+   * loaded room's model uses it; other textures are released from the GL
+   * once they haven't been bound for a while, and uploaded again when next
+   * bound. Decoded images (and their mipmaps) are kept in a separate cache, so
+   * that uploading again (or recreating the GL context) needn't decode them;
+   * when the cache exceeds its budget, the images uploaded least recently are
+   * discarded, to be decoded again if needed. Compiled textures need no
+   * decoding, and are uploaded straight from the mapped file instead.
+   */
   class Textures {
   public:
+    static const size_t defaultCacheBudget = 32 << 20;
+    static const int residencyMillis = 10000;
+
+    /** Returns the texture with the specified path, adding a reference. */
     static const Texture& fromFile(const char* path);
+
+    /** Removes a reference, deleting the texture if it was the last. */
+    static void release(const Texture& t);
+
+    /**
+     * Maps the compiled textures (textures.pbx), if present, and decodes the
+     * images of any textures not compiled, in parallel, ahead of uploading;
+     * only as many as fit the cache budget are kept. Needs no GL context, so
+     * may run on any thread (but not concurrently with any other method).
+     */
+    static void load();
+
+    /**
+     * Prepares the textures for a new GL context. Textures are then uploaded
+     * as TextureSets record them or they are bound.
+     */
     static void initialize();
 
+    /** Releases textures no longer in use; call once per frame. */
+    static void update();
+
+    /** Sets the memory budget for decoded images, in bytes. */
+    static void setCacheBudget(size_t bytes);
+
+    /** Returns the memory used by decoded images, in bytes. */
+    static size_t cacheBytes();
+
+    /** Returns the number of textures, resident or not. */
+    static int count();
+
+    /** Returns the number of resident textures, and their memory. */
+    static int residentCount();
+    static size_t residentBytes();
+
   private:
     Textures();
   };
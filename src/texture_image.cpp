@@ -0,0 +1,129 @@
+// -*- C++ -*-
+
+#include <OpenGL/gl.h>
+#include <SDL/sdl.h>
+#include <algorithm>
+#include <string.h>
+
+#include "texture_image.h"
+
+using namespace mbostock;
+
+/* Returns the nearest power of two, rounding 3 * 2^k up, as GLU does. */
+static int nearestPower(int n) {
+  int p = 1;
+  while ((n != 1) && (n != 3)) {
+    n >>= 1;
+    p <<= 1;
+  }
+  return (n == 3) ? p * 4 : p;
+}
+
+TextureImage::TextureImage(const SDL_Surface* image)
+    : components_(image->format->BytesPerPixel) {
+  bool rgb = (image->format->Rmask == 0x000000FF);
+  format_ = alpha()
+      ? (rgb ? GL_RGBA : GL_BGRA)
+      : (rgb ? GL_RGB : GL_BGR);
+
+  int width = nearestPower(image->w);
+  int height = nearestPower(image->h);
+  addLevel(width, height);
+  while ((width > 1) || (height > 1)) {
+    width = (width > 1) ? width / 2 : 1;
+    height = (height > 1) ? height / 2 : 1;
+    addLevel(width, height);
+  }
+  pixels_.resize(levels_.back().offset
+      + levels_.back().width * levels_.back().height * components_);
+
+  scale(image, levels_[0]);
+  for (int i = 1; i < (int) levels_.size(); i++) {
+    halve(levels_[i - 1], levels_[i]);
+  }
+}
+
+void TextureImage::addLevel(int width, int height) {
+  Level l;
+  l.width = width;
+  l.height = height;
+  l.offset = levels_.empty() ? 0 : (levels_.back().offset
+      + levels_.back().width * levels_.back().height * components_);
+  levels_.push_back(l);
+}
+
+/*
+ * Copies the image into the first level, averaging the pixels that each
+ * pixel of the level covers if the level is smaller. (Images are never
+ * scaled up by more than a third, so those are just sampled.)
+ */
+void TextureImage::scale(const SDL_Surface* image, const Level& l) {
+  const uint8_t* src = (const uint8_t*) image->pixels;
+  uint8_t* dst = &pixels_[l.offset];
+  if ((l.width == image->w) && (l.height == image->h)) {
+    for (int y = 0; y < l.height; y++) {
+      memcpy(dst + y * l.width * components_, src + y * image->pitch,
+          l.width * components_);
+    }
+    return;
+  }
+  for (int y = 0; y < l.height; y++) {
+    int y0 = y * image->h / l.height;
+    int y1 = std::max(y0 + 1, (y + 1) * image->h / l.height);
+    for (int x = 0; x < l.width; x++) {
+      int x0 = x * image->w / l.width;
+      int x1 = std::max(x0 + 1, (x + 1) * image->w / l.width);
+      for (int c = 0; c < components_; c++) {
+        int sum = 0;
+        for (int sy = y0; sy < y1; sy++) {
+          for (int sx = x0; sx < x1; sx++) {
+            sum += src[sy * image->pitch + sx * components_ + c];
+          }
+        }
+        *dst++ = sum / ((y1 - y0) * (x1 - x0));
+      }
+    }
+  }
+}
+
+/* Averages each 2x2 block (or 2x1, once a side reaches 1) of the level. */
+void TextureImage::halve(const Level& from, const Level& to) {
+  const uint8_t* src = &pixels_[from.offset];
+  uint8_t* dst = &pixels_[to.offset];
+  int dx = (from.width > 1) ? components_ : 0;
+  int dy = (from.height > 1) ? from.width * components_ : 0;
+  for (int y = 0; y < to.height; y++) {
+    for (int x = 0; x < to.width; x++) {
+      const uint8_t* p = src + ((dy ? 2 * y : y) * from.width
+          + (dx ? 2 * x : x)) * components_;
+      for (int c = 0; c < components_; c++) {
+        *dst++ = (p[c] + p[c + dx] + p[c + dy] + p[c + dx + dy] + 2) / 4;
+      }
+    }
+  }
+}
+
+/*
+ * The pixels are copied into the buffer, which the driver can then transfer
+ * to the texture without the CPU waiting. If the buffer can't be mapped, the
+ * pixels are uploaded directly instead.
+ */
+void TextureImage::upload(GLuint buffer) const {
+  const uint8_t* base = NULL;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, pixels_.size(), NULL, GL_STREAM_DRAW);
+  void* mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+  if (mapped != NULL) {
+    memcpy(mapped, &pixels_[0], pixels_.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  } else {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+    base = &pixels_[0];
+  }
+  for (int i = 0; i < (int) levels_.size(); i++) {
+    const Level& l = levels_[i];
+    glTexImage2D(GL_TEXTURE_2D, i, components_, l.width, l.height, 0,
+        format_, GL_UNSIGNED_BYTE, base + l.offset);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+}
@@ -0,0 +1,62 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_TEXTURE_IMAGE_H
+#define MBOSTOCK_TEXTURE_IMAGE_H
+
+#include <OpenGL/gl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace mbostock {
+
+  /**
+   * A decoded image along with its mipmaps, tightly packed one after another so
+   * that they can be uploaded from a single pixel buffer. Images whose sides
+   * aren't powers of two are scaled to the nearest powers of two first, as
+   * gluBuild2DMipmaps did.
+   */
+  class TextureImage {
+  public:
+    TextureImage(const SDL_Surface* image);
+
+    inline size_t size() const { return pixels_.size(); }
+    inline bool alpha() const { return components_ == 4; }
+
+    /** Returns GL_RGB, GL_RGBA, GL_BGR or GL_BGRA. */
+    inline GLenum format() const { return format_; }
+    inline int components() const { return components_; }
+
+    inline int levels() const { return levels_.size(); }
+    inline int width(int i) const { return levels_[i].width; }
+    inline int height(int i) const { return levels_[i].height; }
+    inline const uint8_t* pixels(int i) const {
+      return &pixels_[levels_[i].offset];
+    }
+
+    /** Uploads every level to the bound texture, through the buffer. */
+    void upload(GLuint buffer) const;
+
+  private:
+    class Level {
+    public:
+      int width;
+      int height;
+      size_t offset;
+    };
+
+    void addLevel(int width, int height);
+    void scale(const SDL_Surface* image, const Level& l);
+    void halve(const Level& from, const Level& to);
+
+    GLenum format_;
+    int components_;
+    std::vector<Level> levels_;
+    std::vector<uint8_t> pixels_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,342 @@
+// -*- C++ -*-
+
+#include <algorithm>
+#include <math.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../batch.h"
+#include "../jobs.h"
+#include "../portal.h"
+#include "../room.h"
+#include "../world.h"
+#include "../worlds.h"
+
+using namespace mbostock;
+
+/*
+ * Explores each room with randomized input on every core, to find where the
+ * player gets stuck or falls into a chasm, and which portals can be reached.
+ *
+ * Each explorer is a job that steps a batch of environments in its own copy of
+ * the world. An environment holds a random action for a random duration, then
+ * picks another. A run ends when the player takes a portal, falls, gets stuck,
+ * or runs out of steps. Runs start either from the room's starting state or
+ * from a state saved when an earlier run first reached a new part of the room,
+ * so that exploration branches from intermediate states rather than replaying
+ * from the start.
+ *
+ * The player is stuck if it has moved less than stuckDistance during each of
+ * stuckActions consecutive actions. A fall is reported at the last position
+ * where the player had a wheel on the ground.
+ *
+ * Usage: fuzz [-r room] [-n runs] [-s steps] [-t threads] [-x seed] [world.xml]
+ */
+
+static const int batchSize = 32;
+static const int minActionSteps = 100;
+static const int maxActionSteps = 1000;
+static const float stuckDistance = .05f;
+static const int stuckActions = 3;
+static const float cellSize = 1.f;
+static const int maxArchive = 1024;
+static const float branchProbability = .5f;
+static const float clusterRadius = .5f;
+static const int maxClusters = 10;
+
+static double seconds() {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+/* A xorshift generator, so that each thread's sequence is reproducible. */
+static uint32_t next(uint32_t& s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+static float uniform(uint32_t& s) {
+  return (next(s) & 0xffffff) / (float) 0x1000000;
+}
+
+static Vector position(const float* v, int k) {
+  return Vector(v[3 * k], v[3 * k + 1], v[3 * k + 2]);
+}
+
+namespace {
+
+  class Cluster {
+  public:
+    Cluster(const Vector& x) : sum(x), count(1) {}
+
+    inline Vector center() const { return sum / count; }
+    inline bool operator<(const Cluster& c) const { return count > c.count; }
+
+    Vector sum;
+    int count;
+  };
+
+  /** Explores one room with a batch of environments, on one thread. */
+  class Explorer {
+  public:
+    Explorer(World& world, int room, int runs, int steps, uint32_t seed);
+
+    void explore();
+
+    int runs;
+    int steps;
+    uint32_t seed;
+    std::vector<int> portals;
+    std::vector<Vector> stuck;
+    std::vector<Vector> falls;
+
+  private:
+    void start(int k);
+    void act(int k);
+
+    class Environment {
+    public:
+      bool active;
+      int runSteps;
+      int actionSteps;
+      int stuckCount;
+      Vector actionStart;
+      Vector ground;
+    };
+
+    BatchEnvironment batch_;
+    int started_;
+    std::vector<Environment> environments_;
+    std::vector<uint8_t> actions_;
+    std::vector<Snapshot> archive_;
+    std::set<long> cells_;
+  };
+
+}
+
+Explorer::Explorer(World& world, int room, int runs, int steps,
+    uint32_t seed)
+    : runs(runs), steps(steps), seed(seed),
+      portals(world.rooms().room(room)->portals().size()),
+      batch_(world, room, batchSize), started_(0),
+      environments_(batchSize), actions_(batchSize) {
+}
+
+void Explorer::start(int k) {
+  Environment& e = environments_[k];
+  if (started_ == runs) {
+    e.active = false;
+    actions_[k] = 0;
+    return;
+  }
+  started_++;
+  if (!archive_.empty() && (uniform(seed) < branchProbability)) {
+    batch_.setState(k, archive_[next(seed) % archive_.size()]);
+  } else {
+    batch_.reset(k);
+  }
+  e.active = true;
+  e.runSteps = steps;
+  e.stuckCount = 0;
+  e.ground = position(batch_.positions(), k);
+  act(k);
+}
+
+void Explorer::act(int k) {
+  Environment& e = environments_[k];
+  actions_[k] = next(seed) & 15;
+  e.actionSteps = minActionSteps
+      + next(seed) % (maxActionSteps - minActionSteps);
+  e.actionStart = position(batch_.positions(), k);
+}
+
+void Explorer::explore() {
+  for (int k = 0; k < batchSize; k++) {
+    start(k);
+  }
+  int active = batchSize;
+  while (active > 0) {
+    batch_.step(&actions_[0]);
+    active = 0;
+    for (int k = 0; k < batchSize; k++) {
+      Environment& e = environments_[k];
+      if (!e.active) {
+        continue;
+      }
+      Vector x = position(batch_.positions(), k);
+
+      /* Runs end at portals and chasms. */
+      if (batch_.portals()[k] >= 0) {
+        portals[batch_.portals()[k]]++;
+        start(k);
+      } else if (batch_.falls()[k]) {
+        falls.push_back(e.ground);
+        start(k);
+      } else {
+        if (batch_.leftContacts()[k] || batch_.rightContacts()[k]) {
+          e.ground = x;
+        }
+
+        /* Save the state when first reaching a new cell, for branching. */
+        long cell = ((long) floorf(x.x / cellSize) * 4096
+            + (long) floorf(x.y / cellSize)) * 4096
+            + (long) floorf(x.z / cellSize);
+        if (cells_.insert(cell).second && (archive_.size() < maxArchive)) {
+          archive_.push_back(batch_.state(k));
+        }
+
+        /* At the end of each action, check whether the player is stuck. */
+        bool done = (--e.runSteps == 0);
+        if (--e.actionSteps == 0) {
+          bool moving = actions_[k] & (BatchEnvironment::FORWARD
+                                       | BatchEnvironment::BACKWARD);
+          if (moving && ((x - e.actionStart).length() < stuckDistance)) {
+            if (++e.stuckCount == stuckActions) {
+              stuck.push_back(x);
+              done = true;
+            }
+          } else if (moving) {
+            e.stuckCount = 0;
+          }
+          act(k);
+        }
+        if (done) {
+          start(k);
+        }
+      }
+      if (e.active) {
+        active++;
+      }
+    }
+  }
+}
+
+static void explore(void* explorer) {
+  ((Explorer*) explorer)->explore();
+}
+
+static void cluster(const std::vector<Vector>& points,
+    std::vector<Cluster>& clusters) {
+  std::vector<Vector>::const_iterator i;
+  for (i = points.begin(); i != points.end(); i++) {
+    std::vector<Cluster>::iterator j;
+    for (j = clusters.begin(); j != clusters.end(); j++) {
+      if ((j->center() - *i).length() < clusterRadius) {
+        j->sum += *i;
+        j->count++;
+        break;
+      }
+    }
+    if (j == clusters.end()) {
+      clusters.push_back(Cluster(*i));
+    }
+  }
+  std::sort(clusters.begin(), clusters.end());
+}
+
+static void report(const char* label, const std::vector<Vector>& points) {
+  std::vector<Cluster> clusters;
+  cluster(points, clusters);
+  for (int i = 0; (i < (int) clusters.size()) && (i < maxClusters); i++) {
+    Vector c = clusters[i].center();
+    printf("  %s at (%.2f, %.2f, %.2f): %d times\n",
+        label, c.x, c.y, c.z, clusters[i].count);
+  }
+}
+
+int main(int argc, char** argv) {
+  int room = -1;
+  int runs = 1024;
+  int steps = 3000;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t seed = 1;
+  int c;
+  while ((c = getopt(argc, argv, "r:n:s:t:x:")) != -1) {
+    switch (c) {
+      case 'r': room = atoi(optarg); break;
+      case 'n': runs = atoi(optarg); break;
+      case 's': steps = atoi(optarg); break;
+      case 't': threads = atoi(optarg); break;
+      case 'x': seed = atoi(optarg); break;
+      default: {
+        fprintf(stderr, "usage: %s [-r room] [-n runs] [-s steps] "
+            "[-t threads] [-x seed] [world.xml]\n", argv[0]);
+        return 2;
+      }
+    }
+  }
+  const char* worldPath = (optind < argc) ? argv[optind] : "world.xml";
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  /* Loading isn't thread-safe, so each thread's world is loaded up front. */
+  std::vector<World*> worlds;
+  for (int t = 0; t < threads; t++) {
+    World* world = Worlds::fromFile(worldPath);
+    if (world == NULL) {
+      return 2;
+    }
+    world->setMuted(true);
+    worlds.push_back(world);
+  }
+
+  Jobs::initialize(threads - 1);
+  int rooms = worlds[0]->rooms().size();
+  for (int r = (room < 0) ? 0 : room; r < ((room < 0) ? rooms : room + 1);
+       r++) {
+    double start = seconds();
+    std::vector<Explorer*> explorers;
+    std::vector<Job> jobs(threads);
+    for (int t = 0; t < threads; t++) {
+      int n = runs / threads + ((t < runs % threads) ? 1 : 0);
+      uint32_t s = seed * 2654435761u + r * 40503u + t * 2246822519u;
+      explorers.push_back(new Explorer(*worlds[t], r, n, steps, s | 1));
+      jobs[t] = Job(explore, explorers[t]);
+      Jobs::submit(jobs[t]);
+    }
+
+    Explorer& total = *explorers[0];
+    Jobs::wait(jobs[0]);
+    for (int t = 1; t < threads; t++) {
+      Explorer& e = *explorers[t];
+      Jobs::wait(jobs[t]);
+      for (int p = 0; p < (int) e.portals.size(); p++) {
+        total.portals[p] += e.portals[p];
+      }
+      total.stuck.insert(total.stuck.end(), e.stuck.begin(), e.stuck.end());
+      total.falls.insert(total.falls.end(), e.falls.begin(), e.falls.end());
+    }
+
+    printf("room %d: %d runs of up to %d steps in %.1f s\n",
+        r, runs, steps, seconds() - start);
+    const std::vector<Portal*>& portals = worlds[0]->rooms().room(r)->portals();
+    for (int p = 0; p < (int) portals.size(); p++) {
+      if (total.portals[p] > 0) {
+        printf("  portal %d to room %d: reached %d times\n",
+            p, portals[p]->room(), total.portals[p]);
+      } else {
+        printf("  portal %d to room %d: UNREACHED\n", p, portals[p]->room());
+      }
+    }
+    report("stuck", total.stuck);
+    report("fell", total.falls);
+
+    for (int t = 0; t < threads; t++) {
+      delete explorers[t];
+    }
+  }
+
+  for (int t = 0; t < threads; t++) {
+    delete worlds[t];
+  }
+  Jobs::dispose();
+  return 0;
+}
@@ -0,0 +1,125 @@
+// -*- C++ -*-
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "../jobs.h"
+
+using namespace mbostock;
+
+/*
+ * Measures the overhead of the job system: the latency of submitting and
+ * waiting for an empty job, the cost of parallelFor over a cheap loop body at
+ * various grain sizes (relative to a plain loop), and the throughput of a
+ * chain of dependent jobs and of a wide fan-in.
+ *
+ * Usage: jobs_benchmark [workers]
+ */
+
+static const int jobCount = 100000;
+static const int forCount = 1000000;
+static const int forRepeat = 20;
+static const int grains[] = {64, 1024, 16384};
+
+static double seconds() {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+static void empty(void* data) {
+}
+
+static void halve(void* data, int begin, int end) {
+  float* x = (float*) data;
+  for (int i = begin; i < end; i++) {
+    x[i] = x[i] * .5f + 1.f;
+  }
+}
+
+static void submitWait() {
+  double start = seconds();
+  for (int i = 0; i < jobCount; i++) {
+    Job job(empty);
+    Jobs::submit(job);
+    Jobs::wait(job);
+  }
+  double t = seconds() - start;
+  printf("submit+wait: %.2f us per job\n", t / jobCount * 1e6);
+}
+
+static void batch() {
+  std::vector<Job> jobs(jobCount, Job(empty));
+  double start = seconds();
+  for (int i = 0; i < jobCount; i++) {
+    Jobs::submit(jobs[i]);
+  }
+  for (int i = 0; i < jobCount; i++) {
+    Jobs::wait(jobs[i]);
+  }
+  double t = seconds() - start;
+  printf("batch of %d: %.2f us per job\n", jobCount, t / jobCount * 1e6);
+}
+
+static void chain() {
+  std::vector<Job> jobs(jobCount, Job(empty));
+  for (int i = 1; i < jobCount; i++) {
+    jobs[i].dependOn(jobs[i - 1]);
+  }
+  double start = seconds();
+  for (int i = jobCount - 1; i >= 0; i--) {
+    Jobs::submit(jobs[i]);
+  }
+  Jobs::wait(jobs[jobCount - 1]);
+  double t = seconds() - start;
+  printf("chain of %d: %.2f us per job\n", jobCount, t / jobCount * 1e6);
+}
+
+static void fanIn() {
+  std::vector<Job> jobs(jobCount, Job(empty));
+  Job join(empty);
+  for (int i = 0; i < jobCount; i++) {
+    join.dependOn(jobs[i]);
+  }
+  double start = seconds();
+  Jobs::submit(join);
+  for (int i = 0; i < jobCount; i++) {
+    Jobs::submit(jobs[i]);
+  }
+  Jobs::wait(join);
+  double t = seconds() - start;
+  printf("fan-in of %d: %.2f us per job\n", jobCount, t / jobCount * 1e6);
+}
+
+static void loops() {
+  std::vector<float> x(forCount, 1.f);
+  double start = seconds();
+  for (int r = 0; r < forRepeat; r++) {
+    halve(&x[0], 0, forCount);
+  }
+  double serial = seconds() - start;
+  printf("serial loop: %.2f ms\n", serial / forRepeat * 1e3);
+  for (int g = 0; g < (int) (sizeof(grains) / sizeof(grains[0])); g++) {
+    start = seconds();
+    for (int r = 0; r < forRepeat; r++) {
+      Jobs::parallelFor(0, forCount, grains[g], halve, &x[0]);
+    }
+    double t = seconds() - start;
+    printf("parallelFor grain %d: %.2f ms (%.2fx)\n",
+        grains[g], t / forRepeat * 1e3, serial / t);
+  }
+}
+
+int main(int argc, char** argv) {
+  Jobs::initialize((argc > 1) ? atoi(argv[1]) : -1);
+  printf("concurrency: %d\n", Jobs::concurrency());
+  submitWait();
+  batch();
+  chain();
+  fanIn();
+  loops();
+  Jobs::dispose();
+  return 0;
+}
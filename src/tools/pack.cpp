@@ -0,0 +1,73 @@
+// -*- C++ -*-
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../resource.h"
+
+using namespace mbostock;
+
+/*
+ * Packs files into the archive of resources mapped by Resources::initialize,
+ * and reports the size of the result. Each resource is keyed by the name of
+ * its file, without the directory, as the game refers to it within the
+ * resources.
+ *
+ * Usage: pack resources.pba file...
+ */
+
+static bool readFile(const char* path, std::vector<char>& out) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  out.clear();
+  char buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    out.insert(out.end(), buffer, buffer + n);
+  }
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s resources.pba file...\n", argv[0]);
+    return 2;
+  }
+
+  ResourceArchiveWriter writer;
+  std::vector<char> file;
+  for (int i = 2; i < argc; i++) {
+    if (!readFile(argv[i], file)) {
+      fprintf(stderr, "%s: could not read\n", argv[i]);
+      return 1;
+    }
+    const char* name = strrchr(argv[i], '/');
+    writer.add((name == NULL) ? argv[i] : name + 1,
+        file.empty() ? NULL : &file[0], file.size());
+  }
+
+  std::vector<char> data;
+  writer.write(data);
+  FILE* f = fopen(argv[1], "wb");
+  if ((f == NULL)
+      || (fwrite(&data[0], 1, data.size(), f) != data.size())
+      || (fclose(f) != 0)) {
+    fprintf(stderr, "%s: could not write\n", argv[1]);
+    return 1;
+  }
+
+  ResourceArchive archive;
+  if (!archive.open(argv[1])) {
+    fprintf(stderr, "%s: invalid\n", argv[1]);
+    return 1;
+  }
+  printf("%s: %d resources, %d bytes packed, %d bytes\n",
+      argv[1], archive.entries(), (int) writer.size(),
+      (int) archive.length());
+  return 0;
+}
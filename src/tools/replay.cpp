@@ -0,0 +1,69 @@
+// -*- C++ -*-
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "../replay.h"
+#include "../world.h"
+#include "../worlds.h"
+
+using namespace mbostock;
+
+/*
+ * Replays a recorded input log headlessly, as fast as possible, and reports the
+ * simulation rate and whether the replayed state diverged from the recorded
+ * hashes. The world is loaded from the resources path, as in the game.
+ *
+ * Usage: replay input.log [world.xml] [repeat]
+ */
+
+static double seconds() {
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s input.log [world.xml] [repeat]\n", argv[0]);
+    return 2;
+  }
+  const char* worldPath = (argc > 2) ? argv[2] : "world.xml";
+  int repeat = (argc > 3) ? atoi(argv[3]) : 1;
+
+  InputLog log;
+  if (!log.load(argv[1])) {
+    fprintf(stderr, "error loading input log \"%s\"\n", argv[1]);
+    return 2;
+  }
+
+  int returnCode = 0;
+  for (int i = 0; i < repeat; i++) {
+    World* world = Worlds::fromFile(worldPath);
+    if (world == NULL) {
+      return 2;
+    }
+    Replayer replayer(*world, log);
+    if (!replayer.valid()) {
+      fprintf(stderr, "input log \"%s\" doesn't match the world\n", argv[1]);
+      delete world;
+      return 2;
+    }
+    double start = seconds();
+    while (replayer.step());
+    double elapsed = seconds() - start;
+
+    printf("%u steps in %.3f s (%.0f steps/s), final hash %08x",
+        replayer.steps(), elapsed, replayer.steps() / elapsed,
+        world->stateHash());
+    if (replayer.diverged()) {
+      printf(", diverged at step %u\n", replayer.divergedStep());
+      returnCode = 1;
+    } else {
+      printf("\n");
+    }
+    delete world;
+  }
+  return returnCode;
+}
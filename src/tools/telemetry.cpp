@@ -0,0 +1,79 @@
+// -*- C++ -*-
+
+#include <map>
+#include <stdio.h>
+#include <vector>
+
+#include "../telemetry.h"
+
+using namespace mbostock;
+
+/*
+ * Summarizes one or more telemetry files, as recorded with --telemetry: for
+ * each session, the number of samples and the simulated time covered, the
+ * distance traveled, and how often the player's wheels were on the ground;
+ * then, across all sessions, the time spent in each room.
+ *
+ * Usage: telemetry file...
+ */
+
+static const float stepSeconds = .003f;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    return 2;
+  }
+
+  std::map<int, long> roomSamples;
+  std::map<int, float> roomSeconds;
+  int errors = 0;
+  for (int f = 1; f < argc; f++) {
+    TelemetryReader reader;
+    if (!reader.open(argv[f])) {
+      fprintf(stderr, "%s: not a telemetry file\n", argv[f]);
+      errors++;
+      continue;
+    }
+
+    float distance = 0.f;
+    long grounded = 0;
+    uint32_t first = 0, last = 0;
+    std::vector<TelemetrySample> samples;
+    TelemetrySample previous;
+    bool started = false;
+    for (int c = 0; c < reader.chunks(); c++) {
+      samples.clear();
+      reader.read(c, samples);
+      std::vector<TelemetrySample>::const_iterator i;
+      for (i = samples.begin(); i != samples.end(); i++) {
+        if (!started) {
+          first = i->step;
+          started = true;
+        } else if (i->room == previous.room) {
+          distance += (i->origin - previous.origin).length();
+        }
+        if (i->contacts != 0) {
+          grounded++;
+        }
+        roomSamples[i->room]++;
+        roomSeconds[i->room] += reader.interval() * stepSeconds;
+        last = i->step;
+        previous = *i;
+      }
+    }
+
+    printf("%s: %d samples in %d chunks, %.1f s, %.1f m traveled, "
+        "%.0f%% grounded\n",
+        argv[f], reader.size(), reader.chunks(),
+        (last - first) * stepSeconds, distance,
+        reader.size() ? 100.f * grounded / reader.size() : 0.f);
+  }
+
+  std::map<int, long>::const_iterator r;
+  for (r = roomSamples.begin(); r != roomSamples.end(); r++) {
+    printf("  room %d: %ld samples, %.1f s\n",
+        r->first, r->second, roomSeconds[r->first]);
+  }
+  return errors ? 1 : 0;
+}
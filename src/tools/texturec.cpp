@@ -0,0 +1,68 @@
+// -*- C++ -*-
+
+#include <SDL/sdl.h>
+#include <SDL_image/SDL_image.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../compiled_texture.h"
+
+/* SDL renames main for its Cocoa entry point, which tools don't use. */
+#undef main
+
+using namespace mbostock;
+
+/*
+ * Compiles images into the textures file loaded by Textures::load, filtering
+ * their mipmaps and compressing them, and reports the size of the result.
+ * Each texture is keyed by the name of its image, without the directory, as
+ * materials refer to it within the resources.
+ *
+ * Usage: texturec textures.pbx image...
+ */
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s textures.pbx image...\n", argv[0]);
+    return 2;
+  }
+
+  CompiledTexturesWriter writer;
+  for (int i = 2; i < argc; i++) {
+    SDL_Surface* image = IMG_Load(argv[i]);
+    if (image == NULL) {
+      fprintf(stderr, "%s: %s\n", argv[i], SDL_GetError());
+      return 1;
+    }
+    int bytes = image->format->BytesPerPixel;
+    if ((bytes != 3) && (bytes != 4)) {
+      fprintf(stderr, "%s: not RGB or RGBA\n", argv[i]);
+      SDL_FreeSurface(image);
+      return 1;
+    }
+    const char* name = strrchr(argv[i], '/');
+    writer.add((name == NULL) ? argv[i] : name + 1, image);
+    SDL_FreeSurface(image);
+  }
+
+  std::vector<char> data;
+  writer.write(data);
+  FILE* f = fopen(argv[1], "wb");
+  if ((f == NULL)
+      || (fwrite(&data[0], 1, data.size(), f) != data.size())
+      || (fclose(f) != 0)) {
+    fprintf(stderr, "%s: could not write\n", argv[1]);
+    return 1;
+  }
+
+  CompiledTextures textures;
+  if (!textures.open(argv[1])) {
+    fprintf(stderr, "%s: invalid\n", argv[1]);
+    return 1;
+  }
+  printf("%s: %d textures, %d bytes uncompressed, %d compressed, %d bytes\n",
+      argv[1], textures.textures(), (int) writer.size(false),
+      (int) writer.size(true), (int) textures.length());
+  return 0;
+}
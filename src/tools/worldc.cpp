@@ -0,0 +1,45 @@
+// -*- C++ -*-
+
+#include <stdio.h>
+#include <vector>
+
+#include "../compiled_world.h"
+#include "../worlds.h"
+
+using namespace mbostock;
+
+/*
+ * Compiles an XML world into the binary format loaded by Worlds::fromFile,
+ * and reports the size of the result.
+ *
+ * Usage: worldc world.xml world.pbw
+ */
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s world.xml world.pbw\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<char> data;
+  if (!Worlds::compile(argv[1], data)) {
+    return 1;
+  }
+  FILE* f = fopen(argv[2], "wb");
+  if ((f == NULL)
+      || (fwrite(&data[0], 1, data.size(), f) != data.size())
+      || (fclose(f) != 0)) {
+    fprintf(stderr, "%s: could not write\n", argv[2]);
+    return 1;
+  }
+
+  CompiledWorld world;
+  if (!world.open(data)) {
+    fprintf(stderr, "%s: invalid\n", argv[2]);
+    return 1;
+  }
+  printf("%s: %d rooms, %d objects, %d transforms, %d materials, %d bytes\n",
+      argv[2], world.rooms(), world.objects(), world.transforms(),
+      world.materials(), (int) world.length());
+  return 0;
+}
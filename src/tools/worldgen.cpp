@@ -0,0 +1,353 @@
+// -*- C++ -*-
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Generates a world of the specified size for benchmarking, using the same
+ * elements as resources/world.xml. Each room is a square field of cells on a
+ * single floor, with one object per cell chosen at random from the available
+ * kinds: blocks, walls, ramps, tubes, balls, fans, seesaws, escalators,
+ * switches, and regions of constant force. A fraction of the objects are
+ * placed inside nested rotations and translations, and each switch targets one
+ * of the translations in its room. The player starts at one corner of each
+ * room, and a portal at the opposite corner leads to the next room (the last
+ * room leads back to the first).
+ *
+ * The output is deterministic for a given seed and set of parameters.
+ *
+ * Usage: worldgen [-r rooms] [-n objects] [-d depth] [-t transformed]
+ *                 [-s spacing] [-x seed] > stress.xml
+ *
+ *   -r  the number of rooms (default 4)
+ *   -n  the number of objects per room (default 1000)
+ *   -d  the maximum nesting depth of transforms (default 2)
+ *   -t  the fraction of objects inside transforms (default .5)
+ *   -s  the distance between cells; smaller is denser (default 3)
+ *   -x  the random seed (default 1)
+ */
+
+static uint32_t seed = 1;
+static int depth = 0;
+
+static uint32_t next() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static float uniform(float min, float max) {
+  return min + (max - min) * ((next() & 0xffffff) / (float) 0x1000000);
+}
+
+static void indent() {
+  printf("%*s", depth * 2, "");
+}
+
+static void begin(const char* element) {
+  indent();
+  printf("<%s>\n", element);
+  depth++;
+}
+
+static void end(const char* element) {
+  depth--;
+  indent();
+  printf("</%s>\n", element);
+}
+
+static void vector(const char* name, float x, float y, float z) {
+  indent();
+  printf("<%s x=\"%g\" y=\"%g\" z=\"%g\"/>\n", name, x, y, z);
+}
+
+static void color(const char* name, float r, float g, float b) {
+  indent();
+  printf("<%s r=\"%g\" g=\"%g\" b=\"%g\" a=\"1\"/>\n", name, r, g, b);
+}
+
+static void material(const char* name, float r, float g, float b,
+    const char* texture) {
+  indent();
+  printf("<material name=\"%s\">\n", name);
+  depth++;
+  color("diffuse", r, g, b);
+  color("ambient", r, g, b);
+  if (texture != NULL) {
+    indent();
+    printf("<texture path=\"%s\"/>\n", texture);
+  }
+  end("material");
+}
+
+static void header() {
+  begin("world");
+  printf("\n");
+  indent();
+  printf("<lighting name=\"default\">\n");
+  depth++;
+  color("ambient", .2f, .2f, .2f);
+  begin("light");
+  color("diffuse", .8f, .8f, .8f);
+  color("specular", .1f, .1f, .1f);
+  indent();
+  printf("<position x=\"-4.5\" y=\"15\" z=\"-4.5\" w=\"1\"/>\n");
+  end("light");
+  end("lighting");
+  printf("\n");
+  material("concrete", 1.f, 1.f, 1.f, "concrete.jpg");
+  material("drain", 1.f, 1.f, 1.f, "drain.jpg");
+  material("ceramic", .9f, .9f, .85f, NULL);
+  material("red", 1.f, 0.f, 0.f, NULL);
+  material("green", 0.f, 1.f, 0.f, NULL);
+  printf("\n");
+}
+
+/* A room's translations that can be targeted by its switches. */
+static std::vector<int> targets;
+static int transforms = 0;
+
+static void block(float x, float y, float z, float w, float h, float d) {
+  indent();
+  printf("<block material=\"concrete\" top-material=\"drain\">\n");
+  depth++;
+  vector("min", x - w / 2.f, y - h, z - d / 2.f);
+  vector("max", x + w / 2.f, y, z + d / 2.f);
+  end("block");
+}
+
+static void wall(float x, float y, float z, float w, float h) {
+  float a = uniform(0.f, 2.f * M_PI);
+  float dx = cosf(a) * w / 2.f, dz = sinf(a) * w / 2.f;
+  indent();
+  printf("<wall material=\"concrete\">\n");
+  depth++;
+  vector("x0", x - dx, y + h, z - dz);
+  vector("x1", x + dx, y + h, z + dz);
+  vector("x2", x + dx, y, z + dz);
+  vector("x3", x - dx, y, z - dz);
+  end("wall");
+}
+
+static void ramp(float x, float y, float z, float w, float h, float d) {
+  indent();
+  printf("<ramp material=\"concrete\" top-material=\"drain\">\n");
+  depth++;
+  vector("x0", x - w / 2.f, y, z + d / 2.f);
+  vector("x1", x + w / 2.f, y + h, z + d / 2.f);
+  vector("x2", x + w / 2.f, y + h, z - d / 2.f);
+  vector("x3", x - w / 2.f, y, z - d / 2.f);
+  end("ramp");
+}
+
+static void tube(float x, float y, float z, float r) {
+  indent();
+  printf("<tube material=\"ceramic\" cap-material=\"drain\" radius=\"%g\">\n",
+      r);
+  depth++;
+  vector("x0", x, y - .1f, z);
+  vector("x1", x, y, z);
+  vector("y", 1.f, 0.f, 0.f);
+  end("tube");
+}
+
+static void ball(float x, float y, float z, float r) {
+  indent();
+  printf("<ball material=\"ceramic\" radius=\"%g\">\n", r);
+  depth++;
+  vector("x", x, y + r, z);
+  end("ball");
+}
+
+static void fan(float x, float y, float z, float r) {
+  indent();
+  printf("<fan material=\"ceramic\" radius=\"%g\" speed=\"%g\">\n",
+      r, uniform(90.f, 720.f));
+  depth++;
+  vector("x", x, y, z);
+  vector("v", 0.f, 1.f, 0.f);
+  end("fan");
+}
+
+static void seesaw(float x, float y, float z, float w, float d) {
+  indent();
+  printf("<seesaw material=\"concrete\" top-material=\"drain\" mass=\"%g\">\n",
+      uniform(.5f, 2.f));
+  depth++;
+  vector("min", x - w / 2.f, y - .1f, z - d / 2.f);
+  vector("max", x + w / 2.f, y, z + d / 2.f);
+  end("seesaw");
+}
+
+static void escalator(float x, float y, float z, float w, float d) {
+  indent();
+  printf("<escalator material=\"drain\">\n");
+  depth++;
+  vector("min", x - w / 2.f, y - .05f, z - d / 2.f);
+  vector("max", x + w / 2.f, y, z + d / 2.f);
+  vector("v", uniform(-1.f, 1.f), 0.f, uniform(-1.f, 1.f));
+  end("escalator");
+}
+
+static void svitch(int room, float x, float y, float z) {
+  indent();
+  printf("<switch material=\"red\" active-material=\"green\">\n");
+  depth++;
+  vector("min", x - .25f, y, z - .25f);
+  vector("max", x + .25f, y + .01f, z + .25f);
+  if (!targets.empty()) {
+    indent();
+    printf("<target name=\"r%dt%d\"/>\n",
+        room, targets[next() % targets.size()]);
+  }
+  end("switch");
+}
+
+static void force(float x, float y, float z, float w, float h) {
+  indent();
+  printf("<constant-force>\n");
+  depth++;
+  vector("min", x - w / 2.f, y, z - w / 2.f);
+  vector("max", x + w / 2.f, y + h, z + w / 2.f);
+  vector("force", 0.f, uniform(5.f, 15.f), 0.f);
+  end("constant-force");
+}
+
+/* Emits a random object centered on the cell at x, z. */
+static void object(int room, float x, float z, float spacing) {
+  float y = uniform(.2f, 2.f);
+  float w = uniform(.25f, .8f) * spacing;
+  float d = uniform(.25f, .8f) * spacing;
+  switch (next() % 10) {
+    case 0: block(x, y, z, w, uniform(.1f, y), d); break;
+    case 1: wall(x, 0.f, z, w, uniform(.5f, 2.f)); break;
+    case 2: ramp(x, 0.f, z, w, uniform(.1f, 1.f), d); break;
+    case 3: tube(x, y, z, w / 2.f); break;
+    case 4: ball(x, 0.f, z, w / 4.f); break;
+    case 5: fan(x, y, z, w / 2.f); break;
+    case 6: seesaw(x, y, z, w, d); break;
+    case 7: escalator(x, y, z, w, d); break;
+    case 8: svitch(room, x, 0.f, z); break;
+    case 9: force(x, 0.f, z, w, uniform(1.f, 4.f)); break;
+  }
+}
+
+/* Emits n levels of nested transforms around a single object. */
+static void transformed(int room, float x, float z, float spacing, int n) {
+  if (n == 0) {
+    object(room, x, z, spacing);
+    return;
+  }
+  if (next() & 1) {
+    indent();
+    printf("<rotation speed=\"%g\" angle=\"%g\">\n",
+        uniform(-40.f, 40.f), uniform(0.f, 360.f));
+    depth++;
+    vector("origin", x, 0.f, z);
+    vector("axis", 0.f, 1.f, 0.f);
+    transformed(room, x, z, spacing, n - 1);
+    end("rotation");
+  } else {
+    int name = transforms++;
+    targets.push_back(name);
+    indent();
+    printf("<translation name=\"r%dt%d\" speed=\"%g\" start=\"%g\" "
+        "dampen=\".99\">\n",
+        room, name, uniform(.1f, .5f), uniform(0.f, 1.f));
+    depth++;
+    vector("x0", 0.f, 0.f, 0.f);
+    vector("x1", uniform(-.5f, .5f) * spacing, uniform(0.f, 1.f),
+        uniform(-.5f, .5f) * spacing);
+    transformed(room, x, z, spacing, n - 1);
+    end("translation");
+  }
+}
+
+static void generateRoom(int room, int rooms, int objects, int maxDepth,
+    float transformedFraction, float spacing) {
+  int side = (int) ceilf(sqrtf(objects));
+  float size = side * spacing;
+  targets.clear();
+  transforms = 0;
+
+  indent();
+  printf("<room name=\"r%d\" lighting=\"default\">\n", room);
+  depth++;
+  vector("camera-min", -spacing, 4.f, -spacing);
+  vector("camera-max", size, 40.f, size);
+  printf("\n");
+  indent();
+  printf("<origin name=\"start\">\n");
+  depth++;
+  vector("position", -spacing / 2.f, .1f, -spacing / 2.f);
+  vector("velocity", 0.f, 0.f, 0.f);
+  end("origin");
+  indent();
+  printf("<portal origin=\"r%d.start\">\n", (room + 1) % rooms);
+  depth++;
+  vector("min", size - spacing, 0.f, size - spacing);
+  vector("max", size, 1.f, size);
+  end("portal");
+  printf("\n");
+  indent();
+  printf("<block material=\"concrete\"> <!-- floor -->\n");
+  depth++;
+  vector("min", -spacing, -1.f, -spacing);
+  vector("max", size, 0.f, size);
+  end("block");
+  printf("\n");
+
+  for (int i = 0; i < objects; i++) {
+    float x = (i % side) * spacing + spacing / 2.f;
+    float z = (i / side) * spacing + spacing / 2.f;
+    int n = ((maxDepth > 0) && (uniform(0.f, 1.f) < transformedFraction))
+        ? 1 + next() % maxDepth
+        : 0;
+    transformed(room, x, z, spacing, n);
+  }
+  end("room");
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  int rooms = 4;
+  int objects = 1000;
+  int maxDepth = 2;
+  float transformedFraction = .5f;
+  float spacing = 3.f;
+  int c;
+  while ((c = getopt(argc, argv, "r:n:d:t:s:x:")) != -1) {
+    switch (c) {
+      case 'r': rooms = atoi(optarg); break;
+      case 'n': objects = atoi(optarg); break;
+      case 'd': maxDepth = atoi(optarg); break;
+      case 't': transformedFraction = atof(optarg); break;
+      case 's': spacing = atof(optarg); break;
+      case 'x': seed = atoi(optarg); break;
+      default: {
+        fprintf(stderr, "usage: %s [-r rooms] [-n objects] [-d depth] "
+            "[-t transformed] [-s spacing] [-x seed]\n", argv[0]);
+        return 2;
+      }
+    }
+  }
+  if ((rooms < 1) || (objects < 0) || (spacing <= 0.f)) {
+    fprintf(stderr, "%s: invalid parameters\n", argv[0]);
+    return 2;
+  }
+  if (seed == 0) {
+    seed = 1;
+  }
+
+  header();
+  for (int r = 0; r < rooms; r++) {
+    generateRoom(r, rooms, objects, maxDepth, transformedFraction, spacing);
+  }
+  end("world");
+  return 0;
+}
@@ -1,25 +1,234 @@
 // -*- C++ -*-
 
+#include <OpenGL/gl.h>
+#include <algorithm>
+
+#include "physics/snapshot.h"
 #include "trail.h"
 
 using namespace mbostock;
 
 static const float minsq = .1f * .1f;
 
-Trail::Trail(const Vector& origin) {
-  points_.push_back(origin);
+/*
+ * A point is merged into the next if it lies within this distance of the line
+ * between its neighbors, unless that line would be longer than maxSegment.
+ */
+static const float tolerance = .02f;
+static const float maxSegment = 4.f;
+
+TrailChunk::TrailChunk()
+    : size(0), begin(0), uploaded(0), buffer(0) {
+}
+
+Trail::Trail()
+    : size_(0) {
+}
+
+Trails::Trails(int capacity)
+    : count_(0) {
+  setCapacity(capacity);
+}
+
+Trails::~Trails() {
+  std::deque<Trail*>::const_iterator it;
+  for (it = trails_.begin(); it != trails_.end(); it++) {
+    delete *it;
+  }
+  std::vector<TrailChunk*>::const_iterator i;
+  for (i = chunks_.begin(); i != chunks_.end(); i++) {
+    if ((*i)->buffer != 0) {
+      glDeleteBuffers(1, &(*i)->buffer);
+    }
+    delete *i;
+  }
 }
 
-bool Trail::add(const Vector& p) {
-  if ((points_.back() - p).squared() >= minsq) {
-    points_.push_back(p);
+void Trails::setCapacity(int points) {
+  maxChunks_ = (points + TrailChunk::capacity - 1) / TrailChunk::capacity;
+  if (maxChunks_ < 2) {
+    maxChunks_ = 2;
+  }
+}
+
+TrailChunk* Trails::allocate() {
+  while (free_.empty() && ((int) chunks_.size() >= maxChunks_)) {
+    if (!discard()) {
+      break;
+    }
+  }
+  TrailChunk* c;
+  if (free_.empty()) {
+    c = new TrailChunk();
+    chunks_.push_back(c);
+  } else {
+    c = free_.back();
+    free_.pop_back();
+  }
+  c->size = 0;
+  c->uploaded = 0;
+  return c;
+}
+
+void Trails::release(TrailChunk* c) {
+  free_.push_back(c);
+}
+
+/*
+ * Discards the oldest chunk of the oldest trail, and the trail itself if that
+ * was its last chunk. The newest trail always keeps its newest chunk.
+ */
+bool Trails::discard() {
+  Trail* t = trails_.front();
+  if (t->chunks_.empty()
+      || ((trails_.size() == 1) && (t->chunks_.size() == 1))) {
+    return false;
+  }
+  release(t->chunks_.front());
+  t->chunks_.pop_front();
+  if (t->chunks_.empty()) {
+    delete t;
+    trails_.pop_front();
+  }
+  return true;
+}
+
+void Trails::push(Trail& t, const Vector& p) {
+  TrailChunk* c = t.chunks_.empty() ? NULL : t.chunks_.back();
+  if ((c == NULL) || (c->size == TrailChunk::capacity)) {
+    TrailChunk* d = allocate();
+    d->begin = t.size_;
+    if (c != NULL) {
+      d->points[d->size++] = c->points[c->size - 1];
+      d->begin--;
+    }
+    t.chunks_.push_back(d);
+    c = d;
+  }
+  c->points[c->size++] = p;
+  t.size_++;
+}
+
+void Trails::next(const Vector& origin) {
+  trails_.push_back(new Trail());
+  count_++;
+  push(*trails_.back(), origin);
+}
+
+bool Trails::add(const Vector& p) {
+  if (trails_.empty()) {
+    next(p);
     return true;
   }
-  return false;
+  Trail& t = *trails_.back();
+  TrailChunk* c = t.chunks_.back();
+  Vector& b = c->points[c->size - 1];
+  if ((b - p).squared() < minsq) {
+    return false;
+  }
+
+  /* Merge the last point into this one if it's nearly on the way. */
+  if (c->size > 1) {
+    const Vector& a = c->points[c->size - 2];
+    Vector ap = p - a;
+    float l = ap.squared();
+    if (l < maxSegment * maxSegment) {
+      float u = (b - a).dot(ap) / l;
+      if ((u > 0.f) && (u < 1.f)
+          && ((a + ap * u - b).squared() < tolerance * tolerance)) {
+        b = p;
+        if (c->uploaded >= c->size) {
+          c->uploaded = c->size - 1;
+        }
+        return true;
+      }
+    }
+  }
+
+  push(t, p);
+  return true;
+}
+
+int Trails::points() const {
+  return trails_.empty() ? 0 : trails_.back()->size_;
+}
+
+void Trails::truncate(int count, int points) {
+  while ((count_ > count) && !trails_.empty()) {
+    Trail* t = trails_.back();
+    std::deque<TrailChunk*>::const_iterator i;
+    for (i = t->chunks_.begin(); i != t->chunks_.end(); i++) {
+      release(*i);
+    }
+    delete t;
+    trails_.pop_back();
+    count_--;
+  }
+  count_ = count;
+  if (trails_.empty() || (points >= trails_.back()->size_)) {
+    return;
+  }
+  Trail& t = *trails_.back();
+  while ((t.chunks_.size() > 1) && (t.chunks_.back()->begin >= points - 1)) {
+    release(t.chunks_.back());
+    t.chunks_.pop_back();
+  }
+  TrailChunk* c = t.chunks_.back();
+  c->size = std::max(1, points - c->begin);
+  if (c->uploaded > c->size) {
+    c->uploaded = c->size;
+  }
+  t.size_ = c->begin + c->size;
+}
+
+void Trails::saveTail(Snapshot& s) const {
+  s.write(count_);
+  if (trails_.empty()) {
+    s.write(0);
+    return;
+  }
+  const Trail& t = *trails_.back();
+  const TrailChunk& c = *t.chunks_.back();
+  s.write(c.size);
+  s.write(c.begin);
+  s.write(t.size_);
+  for (int i = 0; i < c.size; i++) {
+    s.write(c.points[i]);
+  }
+}
+
+void Trails::loadTail(Snapshot& s) {
+  count_ = (int) s.read();
+  int size = (int) s.read();
+  if (size == 0) {
+    return;
+  }
+  Trail* t = new Trail();
+  TrailChunk* c = allocate();
+  c->size = size;
+  c->begin = (int) s.read();
+  t->size_ = (int) s.read();
+  for (int i = 0; i < size; i++) {
+    c->points[i] = s.readVector();
+  }
+  t->chunks_.push_back(c);
+  trails_.push_back(t);
+}
+
+void Trails::invalidate() {
+  std::vector<TrailChunk*>::const_iterator i;
+  for (i = chunks_.begin(); i != chunks_.end(); i++) {
+    (*i)->buffer = 0;
+    (*i)->uploaded = 0;
+  }
+}
+
+TrailModel::TrailModel(Trails& trails)
+    : trails_(trails) {
 }
 
-TrailModel::TrailModel(const Trail& trail)
-    : trail_(trail) {
+void TrailModel::initialize() {
+  trails_.invalidate();
 }
 
 void TrailModel::display() {
@@ -27,12 +236,32 @@ void TrailModel::display() {
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glColor4f(.6f, .2f, .3f, .5f);
-  glBegin(GL_LINE_STRIP);
-  std::vector<Vector>::const_iterator i;
-  for (i = trail_.points().begin(); i != trail_.points().end(); i++) {
-    glVertexv(*i);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  std::deque<Trail*>::const_iterator it;
+  for (it = trails_.trails().begin(); it != trails_.trails().end(); it++) {
+    std::deque<TrailChunk*>::const_iterator i;
+    for (i = (*it)->chunks().begin(); i != (*it)->chunks().end(); i++) {
+      TrailChunk& c = **i;
+      if (c.buffer == 0) {
+        glGenBuffers(1, &c.buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, c.buffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(c.points), NULL,
+            GL_DYNAMIC_DRAW);
+        c.uploaded = 0;
+      } else {
+        glBindBuffer(GL_ARRAY_BUFFER, c.buffer);
+      }
+      if (c.uploaded < c.size) {
+        glBufferSubData(GL_ARRAY_BUFFER, c.uploaded * sizeof(Vector),
+            (c.size - c.uploaded) * sizeof(Vector), &c.points[c.uploaded]);
+        c.uploaded = c.size;
+      }
+      glVertexPointer(3, GL_FLOAT, sizeof(Vector), NULL);
+      glDrawArrays(GL_LINE_STRIP, 0, c.size);
+    }
   }
-  glEnd();
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glDisableClientState(GL_VERTEX_ARRAY);
   glDisable(GL_BLEND);
   glEnable(GL_LIGHTING);
 }
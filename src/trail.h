@@ -3,6 +3,7 @@
 #ifndef MBOSTOCK_TRAIL_H
 #define MBOSTOCK_TRAIL_H
 
+#include <deque>
 #include <vector>
 
 #include "model.h"
@@ -10,25 +11,127 @@
 
 namespace mbostock {
 
+  class Snapshot;
+
+  /**
+   * A fixed-size run of trail points, along with the vertex buffer they are
+   * drawn from. Every chunk after the first in a trail begins with a copy of
+   * the previous chunk's last point, so that the line strips join up.
+   */
+  class TrailChunk {
+  public:
+    static const int capacity = 256;
+
+    TrailChunk();
+
+    Vector points[capacity];
+    int size;
+
+    /** The index in the trail of this chunk's first point. */
+    int begin;
+
+    /** The points before this index are current in the vertex buffer. */
+    int uploaded;
+    GLuint buffer;
+  };
+
+  /**
+   * A path traced by the player, as a sequence of chunks. Points close to the
+   * line between their neighbors are merged as they are added, so a straight
+   * run costs two points however long it is.
+   */
   class Trail {
   public:
-    Trail(const Vector& origin);
+    Trail();
+
+    /** Returns the number of points added, including any since discarded. */
+    inline int size() const { return size_; }
+    inline const std::deque<TrailChunk*>& chunks() const { return chunks_; }
+
+  private:
+    std::deque<TrailChunk*> chunks_;
+    int size_;
+
+    friend class Trails;
+  };
+
+  /**
+   * The trails in a room, from oldest to newest; the newest is the one being
+   * added to. The trails share a pool of chunks, which is capped: when the pool
+   * is exhausted, the oldest chunk of the oldest trail is discarded, so that
+   * memory stays bounded over a long session. Chunks are recycled along with
+   * their vertex buffers.
+   */
+  class Trails {
+  public:
+    Trails(int capacity = defaultCapacity);
+    ~Trails();
+
+    static const int defaultCapacity = 64 * TrailChunk::capacity;
+
+    /** Sets the maximum number of points kept, rounded up to whole chunks. */
+    void setCapacity(int points);
+
+    /** Starts a new trail at the specified origin. */
+    void next(const Vector& origin);
 
+    /** Adds a point to the newest trail; returns true if the trail changed. */
     bool add(const Vector& p);
-    inline const std::vector<Vector>& points() const { return points_; }
+
+    /**
+     * Returns the number of trails started, including any since discarded, and
+     * the number of points in the newest trail, for saving state.
+     */
+    inline int count() const { return count_; }
+    int points() const;
+
+    /**
+     * Restores the specified number of trails and points, as returned by count
+     * and points, discarding any trails and points since. Note that points
+     * merged into a later point, or discarded to stay within the capacity, are
+     * not recovered.
+     */
+    void truncate(int count, int points);
+
+    /**
+     * Saves (or loads) the number of trails and the newest chunk of the newest
+     * trail: just enough for the trails to continue exactly as before, as when
+     * a room is rebuilt. Only load into empty trails.
+     */
+    void saveTail(Snapshot& s) const;
+    void loadTail(Snapshot& s);
+
+    inline const std::deque<Trail*>& trails() const { return trails_; }
+
+    /** Forgets all vertex buffers, as when the OpenGL context is recreated. */
+    void invalidate();
 
   private:
-    std::vector<Vector> points_;
+    TrailChunk* allocate();
+    void release(TrailChunk* c);
+    bool discard();
+    void push(Trail& t, const Vector& p);
+
+    std::deque<Trail*> trails_;
+    std::vector<TrailChunk*> chunks_;
+    std::vector<TrailChunk*> free_;
+    int maxChunks_;
+    int count_;
   };
 
+  /**
+   * Displays a room's trails from vertex buffers. Each frame uploads only the
+   * points that have changed since the last frame.
+   */
   class TrailModel : public Model {
   public:
-    TrailModel(const Trail& trail);
+    TrailModel(Trails& trails);
 
+    virtual void initialize();
     virtual void display();
 
   private:
-    const Trail& trail_;
+    Trails& trails_;
   };
 
 }
@@ -39,3 +39,19 @@ void TransformingRoomObject::constrainInternal() {
 void TransformingRoomObject::reset() {
   object_->reset();
 }
+
+void TransformingRoomObject::saveDisplay(Snapshot& s) const {
+  object_->saveDisplay(s);
+}
+
+void TransformingRoomObject::loadDisplay(Snapshot& s) {
+  object_->loadDisplay(s);
+}
+
+void TransformingRoomObject::saveState(Snapshot& s) const {
+  object_->saveState(s);
+}
+
+void TransformingRoomObject::loadState(Snapshot& s) {
+  object_->loadState(s);
+}
@@ -19,6 +19,10 @@ namespace mbostock {
     virtual void step(const ParticleSimulator& s);
     virtual void constrainInternal();
     virtual void reset();
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
+    virtual void saveState(Snapshot& s) const;
+    virtual void loadState(Snapshot& s);
 
   protected:
     RoomObject* object_;
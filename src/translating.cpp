@@ -1,13 +1,14 @@
 // -*- C++ -*-
 
 #include "physics/particle.h"
+#include "physics/snapshot.h"
 #include "physics/vector.h"
 #include "translating.h"
 
 using namespace mbostock;
 
 TranslatingModel::TranslatingModel(Model& m, const Translation& t)
-    : model_(m), translation_(t) {
+    : model_(m), origin_(t.origin()) {
 }
 
 void TranslatingModel::initialize() {
@@ -16,11 +17,15 @@ void TranslatingModel::initialize() {
 
 void TranslatingModel::display() {
   glPushMatrix();
-  glTranslatev(translation_.origin());
+  glTranslatev(origin_);
   model_.display();
   glPopMatrix();
 }
 
+const Material* TranslatingModel::firstMaterial() const {
+  return model_.firstMaterial();
+}
+
 TranslatingRoomObject::TranslatingRoomObject(RoomObject* o, const Translation& t)
     : TransformingRoomObject(o), translation_(t),
       shape_(o->shape(), t), model_(o->model(), t) {
@@ -41,3 +46,13 @@ Vector TranslatingRoomObject::velocity(const Vector& x) const {
   }
   return v;
 }
+
+void TranslatingRoomObject::saveDisplay(Snapshot& s) const {
+  s.write(translation_.origin());
+  TransformingRoomObject::saveDisplay(s);
+}
+
+void TranslatingRoomObject::loadDisplay(Snapshot& s) {
+  model_.setOrigin(s.readVector());
+  TransformingRoomObject::loadDisplay(s);
+}
@@ -12,16 +12,24 @@
 
 namespace mbostock {
 
+  /**
+   * Displays a model translated by a translation. The origin is displayed as
+   * most recently set, rather than read from the translation, so that the
+   * translation may be stepped on another thread.
+   */
   class TranslatingModel : public Model {
   public:
     TranslatingModel(Model& m, const Translation& t);
 
     virtual void initialize();
     virtual void display();
+    virtual const Material* firstMaterial() const;
+
+    inline void setOrigin(const Vector& origin) { origin_ = origin; }
 
   private:
     Model& model_;
-    const Translation& translation_;
+    Vector origin_;
   };
 
   class TranslatingRoomObject : public TransformingRoomObject {
@@ -31,6 +39,8 @@ namespace mbostock {
     virtual Model& model();
     virtual const Shape& shape() const;
     virtual Vector velocity(const Vector& x) const;
+    virtual void saveDisplay(Snapshot& s) const;
+    virtual void loadDisplay(Snapshot& s);
 
   private:
     const Translation& translation_;
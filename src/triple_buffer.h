@@ -0,0 +1,49 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_TRIPLE_BUFFER_H
+#define MBOSTOCK_TRIPLE_BUFFER_H
+
+#include "atomic.h"
+
+namespace mbostock {
+
+  /**
+   * A lock-free triple buffer for publishing values from one writer thread to
+   * one reader thread. The writer fills the back buffer and publishes it; the
+   * reader always sees the most recently published buffer. Neither side ever
+   * waits on the other, and intermediate values may be skipped if the writer
+   * publishes faster than the reader reads.
+   */
+  template <class T>
+  class TripleBuffer {
+  public:
+    TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+    /** Returns the buffer to fill. Writer only. */
+    inline T& back() { return buffers_[back_]; }
+
+    /** Publishes the back buffer and starts a new one. Writer only. */
+    void publish() {
+      back_ = Atomics::exchange(&middle_, back_ | fresh) & mask;
+    }
+
+    /** Returns the most recently published buffer. Reader only. */
+    T& front() {
+      if (middle_ & fresh) {
+        front_ = Atomics::exchange(&middle_, front_) & mask;
+      }
+      return buffers_[front_];
+    }
+
+  private:
+    enum { mask = 3, fresh = 4 };
+
+    T buffers_[3];
+    int back_;
+    volatile int middle_;
+    int front_;
+  };
+
+}
+
+#endif
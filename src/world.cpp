@@ -1,13 +1,18 @@
 // -*- C++ -*-
 
+#include <algorithm>
 #include <OpenGL/gl.h>
+#include <SDL/SDL.h>
 
 #include "material.h"
 #include "portal.h"
+#include "replay.h"
 #include "room.h"
 #include "room_force.h"
 #include "room_object.h"
 #include "sound.h"
+#include "telemetry.h"
+#include "texture.h"
 #include "trail.h"
 #include "world.h"
 
@@ -19,11 +24,24 @@ static const float fogColor[] = { 0.f, 0.f, 0.f, 1.f };
 
 static const float gravity = 10.f;
 static const float minY = -50.f;
+static const uint32_t rewindInterval = 333; // steps, about a second
 
 static World* world_ = NULL;
 
+WorldEvent::WorldEvent()
+    : type(MOVE), direction(Player::NONE), timeMs(0) {
+}
+
+WorldEvent::WorldEvent(Type type, Player::Direction direction)
+    : type(type), direction(direction), timeMs(0) {
+}
+
+WorldSnapshot::WorldSnapshot()
+    : room(NULL), paused(false) {
+}
+
 WorldModel::WorldModel(World& world)
-    : world_(world) {
+    : world_(world), room_(NULL), paused_(false) {
 }
 
 void WorldModel::initialize() {
@@ -38,28 +56,64 @@ void WorldModel::initialize() {
   glEnable(GL_LINE_SMOOTH);
   glEnable(GL_TEXTURE_2D);
 
+  /*
+   * Evicted rooms may be displayed from here on, so they are deleted by the
+   * display rather than by the simulation (see update).
+   */
+  std::vector<Room*> rooms;
+  world_.lock();
+  world_.rooms().loaded(rooms);
+  world_.rooms().setDisplayed(true);
   std::vector<Room*>::const_iterator i;
-  for (i = world_.rooms().begin(); i != world_.rooms().end(); i++) {
+  for (i = rooms.begin(); i != rooms.end(); i++) {
+    (*i)->trailModel().initialize();
+  }
+  world_.unlock();
+  for (i = rooms.begin(); i != rooms.end(); i++) {
     (*i)->model().initialize();
   }
   world_.player().model().initialize();
   world_.pauseLighting().initialize();
 }
 
+/*
+ * The display state is read from the most recently published snapshot, so that
+ * the display never waits on the simulation thread. If nothing has been
+ * published yet (the simulation hasn't started), the current room is used as
+ * is. Rooms built since the model was initialized are initialized on first
+ * display, and rooms evicted since the last update are deleted, unless still
+ * displayed.
+ */
+void WorldModel::update() {
+  WorldSnapshot& s = world_.snapshots_.front();
+  if (s.room == NULL) {
+    room_ = world_.room_;
+  } else {
+    room_ = s.room;
+    paused_ = s.paused;
+    s.state.rewind();
+    world_.player().model().loadDisplay(s.state);
+    room_->loadDisplay(s.state);
+  }
+  if (!room_->model().initialized()) {
+    room_->model().initialize();
+  }
+  world_.rooms().collect(room_);
+  Textures::update();
+}
+
+const Vector& WorldModel::playerOrigin() const {
+  return world_.player().model().origin();
+}
+
 void WorldModel::display() {
-  world_.room().model().display();
+  room_->model().display();
 
+  /* Trails grow as the simulation runs, so they are read under lock. */
   if (world_.debug()) {
-    std::vector<Trail*>::const_iterator i;
-    for (i = world_.room().trails().begin(); i != world_.room().trails().end();
-         i++) {
-      TrailModel m(**i);
-      m.initialize();
-      m.display();
-    }
-    TrailModel m(world_.room().trail());
-    m.initialize();
-    m.display();
+    world_.lock();
+    room_->trailModel().display();
+    world_.unlock();
   }
 
   world_.player().model().display();
@@ -67,41 +121,99 @@ void WorldModel::display() {
 
 World::World()
     : Simulation(roundf(ParticleSimulator::timeStep() * 1000.f)),
-      simulator_(1.f), gravity_(gravity), room_(NULL), debug_(false),
-      model_(*this) {
+      simulator_(1.f), gravity_(gravity), room_(NULL), roomIndex_(-1),
+      debug_(false),
+      muted_(false), bookkeeping_(true), portal_(-1), fell_(false),
+      model_(*this), log_(NULL), telemetry_(NULL), steps_(0) {
   world_ = this;
   pauseLighting_.light(0).setDiffuse(.1f, .1f, .1f, 1.f);
   pauseLighting_.light(0).setSpecular(.1f, .1f, .1f, 1.f);
 }
 
 World::~World() {
-  std::vector<Room*>::const_iterator ir;
-  for (ir = rooms_.begin(); ir != rooms_.end(); ir++) {
-    delete (*ir);
-  }
-  std::vector<Material*>::const_iterator im;
-  for (im = materials_.begin(); im != materials_.end(); im++) {
-    delete (*im);
-  }
+  stop();
 }
 
 World* World::world() {
   return world_;
 }
 
-void World::addRoom(Room* r) {
-  if (room_ == NULL) {
-    setRoom(r, r->origins()[0]);
+void World::setLoader(RoomLoader* loader) {
+  rooms_.setLoader(loader);
+  setRoom(0, 0);
+}
+
+/*
+ * The previous room may be deleted by the reload, so its music is noted first.
+ * If the current room no longer exists, the player enters the first room.
+ */
+void World::reload(RoomLoader* loader, std::vector<int>& changed) {
+  const Sound* music = muted_ ? NULL : room_->music();
+  rooms_.reload(loader, changed);
+  rewind_.clear();
+  if (std::find(changed.begin(), changed.end(), roomIndex_) == changed.end()) {
+    return;
   }
-  rooms_.push_back(r);
+  contactObjects_.clear();
+  if (roomIndex_ >= rooms_.size()) {
+    if (music != NULL) {
+      music->stop();
+    }
+    room_ = NULL;
+    setRoom(0, 0);
+    return;
+  }
+  room_ = rooms_.room(roomIndex_);
+  room_->nextTrail(player_.origin());
+  if (!muted_ && (room_->music() != music)) {
+    if (music != NULL) {
+      music->stop();
+    }
+    if (room_->music() != NULL) {
+      room_->music()->play(-1);
+    }
+  }
+}
+
+bool World::post(const WorldEvent& e) {
+  WorldEvent stamped = e;
+  stamped.timeMs = SDL_GetTicks();
+  return events_.push(stamped);
 }
 
-void World::addMaterial(Material* m) {
-  materials_.push_back(m);
+void World::input(uint32_t timeMs) {
+  const WorldEvent* p;
+  while (((p = events_.peek()) != NULL)
+         && ((int32_t) (p->timeMs - timeMs) <= 0)) {
+    WorldEvent e;
+    events_.pop(e);
+    apply(e);
+  }
+}
+
+void World::apply(const WorldEvent& e) {
+  if ((log_ != NULL) && (e.type != WorldEvent::TOGGLE_PAUSED)) {
+    log_->addEvent(steps_, e);
+  }
+  switch (e.type) {
+    case WorldEvent::MOVE: player_.move(e.direction); break;
+    case WorldEvent::STOP: player_.stop(e.direction); break;
+    case WorldEvent::RESET_PLAYER: resetPlayer(); break;
+    case WorldEvent::NEXT_ROOM: nextRoom(); break;
+    case WorldEvent::PREVIOUS_ROOM: previousRoom(); break;
+    case WorldEvent::TOGGLE_PAUSED: togglePaused(); break;
+    case WorldEvent::REWIND: rewind(); break;
+  }
 }
 
-void World::addLighting(Lighting* l) {
-  lightings_.push_back(l);
+void World::publish() {
+  WorldSnapshot& s = snapshots_.back();
+  s.room = room_;
+  s.paused = paused();
+  s.state.clear();
+  player_.saveDisplay(s.state);
+  room_->saveDisplay(s.state, player_.origin());
+  snapshots_.publish();
 }
 
 void World::togglePaused() {
@@ -117,9 +229,92 @@ void World::toggleDebug() {
   debug_ = !debug_;
 }
 
-void World::setRoom(Room* r, RoomOrigin* origin) {
-  bool sameMusic = false;
-  if ((room_ != NULL) && (room_->music() != NULL)) {
+/*
+ * Rewinding depends on the step count, so a recording starts with an empty
+ * rewind buffer, as does a replay.
+ */
+void World::record(InputLog* log) {
+  log_ = log;
+  steps_ = 0;
+  rewind_.clear();
+  if (log_ != NULL) {
+    log_->clear();
+    log_->setStartRoom(roomIndex());
+  }
+}
+
+uint32_t World::stateHash() {
+  hashState_.clear();
+  saveState(hashState_, false);
+  return hashState_.hash();
+}
+
+void World::saveState(Snapshot& s) const {
+  saveState(s, true);
+}
+
+void World::saveState(Snapshot& s, bool trails) const {
+  s.write(roomIndex());
+  s.write(contactObjects_.size());
+  std::vector<RoomObject*>::const_iterator i;
+  for (i = contactObjects_.begin(); i != contactObjects_.end(); i++) {
+    s.write(std::find(room_->objects().begin(), room_->objects().end(), *i)
+        - room_->objects().begin());
+  }
+  player_.saveState(s);
+  if (trails) {
+    room_->saveState(s);
+  } else {
+    room_->saveObjectState(s);
+  }
+}
+
+/*
+ * Without bookkeeping, the room is switched without entering it: the states of
+ * batch environments in different rooms are loaded in turn, and should neither
+ * prefetch nor evict rooms, nor change the music, as they do so.
+ */
+void World::loadState(Snapshot& s) {
+  int room = (int) s.read();
+  if (room != roomIndex_) {
+    if (bookkeeping_) {
+      setRoom(room, 0);
+    } else {
+      room_ = rooms_.room(room);
+      roomIndex_ = room;
+    }
+  }
+  contactObjects_.clear();
+  for (int n = (int) s.read(); n > 0; n--) {
+    contactObjects_.push_back(room_->objects()[(int) s.read()]);
+  }
+  player_.loadState(s);
+  room_->loadState(s);
+}
+
+/*
+ * If the most recent state was saved less than half a second ago, rewinding to
+ * it would hardly be noticeable, so the one before it is used instead.
+ */
+void World::rewind() {
+  if ((steps_ % rewindInterval < rewindInterval / 2) && (rewind_.size() > 1)) {
+    rewind_.pop();
+  }
+  if (rewind_.restore(0, rewindState_)) {
+    rewind_.pop();
+    loadState(rewindState_);
+  }
+}
+
+/*
+ * Entering a room prefetches the rooms its portals lead to, and evicts the
+ * least-recently used rooms if over budget; the previous room may be evicted
+ * too, once its music has stopped.
+ */
+void World::setRoom(int room, int origin) {
+  Room* r = rooms_.room(room);
+  bool sameMusic = muted_;
+  if (!muted_ && (room_ != NULL) && (room_->music() != NULL)) {
     if (room_->music() == r->music()) {
       sameMusic = true;
     } else {
@@ -128,17 +323,34 @@ void World::setRoom(Room* r, RoomOrigin* origin) {
   }
 
   room_ = r;
-  room_->nextTrail(origin->position());
-  player_.setOrigin(origin->position());
-  player_.setVelocity(origin->velocity());
+  roomIndex_ = room;
+  RoomOrigin* o = room_->origins()[origin];
+  if (bookkeeping_) {
+    room_->nextTrail(o->position());
+  }
+  player_.setOrigin(o->position());
+  player_.setVelocity(o->velocity());
 
   if (!sameMusic && (room_->music() != NULL)) {
     room_->music()->play(-1);
   }
+
+  std::vector<Portal*>::const_iterator p;
+  for (p = room_->portals().begin(); p != room_->portals().end(); p++) {
+    rooms_.prefetch((*p)->room());
+  }
+  rooms_.evict(room);
 }
 
+/*
+ * Besides advancing the state, each step notes the index of the portal taken
+ * (in the room stepped, or -1 if none) and whether the player fell into a
+ * chasm.
+ */
 void World::step() {
   std::vector<RoomObject*>::const_iterator i;
+  portal_ = -1;
+  fell_ = false;
 
   /* Reset forces. */
   player_.resetForces();
@@ -172,28 +384,71 @@ void World::step() {
       if (portal.reset()) {
         room_->reset();
       }
-      Room* room = rooms_[portal.room()];
-      setRoom(room, room->origins()[portal.origin()]);
+      portal_ = p - room_->portals().begin();
+      setRoom(portal.room(), portal.origin());
       contactObjects_.clear();
+      countStep();
       return;
     }
   }
 
-  /* Apply constraints, detect contacts. */
+  /*
+   * Apply constraints, detect contacts. The player only reads the objects, so
+   * their internal constraints can all be applied first.
+   */
   contactObjects_.clear();
+  room_->constrainInternal();
   for (i = room_->objects().begin(); i != room_->objects().end(); i++) {
     RoomObject& object = **i;
-    object.constrainInternal();
     if (player_.constrainOutside(object)) {
       contactObjects_.push_back(&object);
     }
   }
   player_.constrainInternal();
-  room_->trail().add(player_.origin());
+  if (bookkeeping_) {
+    room_->trails().add(player_.origin());
+  }
 
   /* Reset if the player falls into a chasm. */
   if (player_.origin().y < minY) {
     resetPlayer();
+    fell_ = true;
+  }
+
+  countStep();
+}
+
+/*
+ * The state is saved for rewinding every rewind interval. When recording, the
+ * log's length is the number of steps so far, and a hash of the state is added
+ * every hash interval. Without bookkeeping, steps are only counted.
+ */
+void World::countStep() {
+  steps_++;
+  if (!bookkeeping_) {
+    return;
+  }
+  if (steps_ % rewindInterval == 0) {
+    rewindState_.clear();
+    saveState(rewindState_);
+    rewind_.push(rewindState_);
+  }
+  if (log_ != NULL) {
+    log_->setLength(steps_);
+    if ((log_->hashInterval() != 0) && (steps_ % log_->hashInterval() == 0)) {
+      log_->addHash(steps_, stateHash());
+    }
+  }
+  if ((telemetry_ != NULL) && (steps_ % telemetry_->interval() == 0)) {
+    TelemetrySample s;
+    s.step = steps_;
+    s.room = roomIndex();
+    s.origin = player_.origin();
+    s.x = player_.x();
+    s.y = player_.y();
+    s.contacts = (player_.leftWheelFriction() ? TelemetrySample::LEFT : 0)
+        | (player_.rightWheelFriction() ? TelemetrySample::RIGHT : 0);
+    telemetry_->record(s);
   }
 }
 
@@ -202,35 +457,15 @@ void World::resetPlayer() {
   player_.setOrigin(origin->position());
   player_.setVelocity(origin->velocity());
   room_->reset();
-  room_->nextTrail(origin->position());
+  if (bookkeeping_) {
+    room_->nextTrail(origin->position());
+  }
 }
 
 void World::nextRoom() {
-  std::vector<Room*>::const_iterator i;
-  Room* nextRoom = rooms_[0];
-  for (i = rooms_.begin(); i != rooms_.end(); i++) {
-    if ((*i) == room_) {
-      i++;
-      if (i != rooms_.end()) {
-        nextRoom = *i;
-      }
-      break;
-    }
-  }
-  setRoom(nextRoom, nextRoom->origins()[0]);
+  setRoom((roomIndex_ + 1) % rooms_.size(), 0);
 }
 
 void World::previousRoom() {
-  std::vector<Room*>::reverse_iterator i;
-  Room* nextRoom = rooms_[rooms_.size() - 1];
-  for (i = rooms_.rbegin(); i != rooms_.rend(); i++) {
-    if ((*i) == room_) {
-      i++;
-      if (i != rooms_.rend()) {
-        nextRoom = *i;
-      }
-      break;
-    }
-  }
-  setRoom(nextRoom, nextRoom->origins()[0]);
+  setRoom((roomIndex_ + rooms_.size() - 1) % rooms_.size(), 0);
 }
@@ -5,20 +5,60 @@
 
 #include <vector>
 
+#include "concurrent_queue.h"
 #include "lighting.h"
 #include "model.h"
 #include "physics/force.h"
+#include "physics/snapshot.h"
 #include "player.h"
+#include "rewind.h"
+#include "room_cache.h"
 #include "simulation.h"
+#include "triple_buffer.h"
 
 namespace mbostock {
 
-  class Material;
+  class InputLog;
   class Room;
   class RoomObject;
-  class RoomOrigin;
+  class TelemetryRecorder;
   class World;
 
+  /**
+   * An input event for the world, such as a key press. Events are posted by the
+   * main thread, stamped with the time they were posted, and applied by the
+   * simulation thread before the first step that begins at or after that time.
+   */
+  class WorldEvent {
+  public:
+    enum Type {
+      MOVE, STOP, RESET_PLAYER, NEXT_ROOM, PREVIOUS_ROOM, TOGGLE_PAUSED,
+      REWIND
+    };
+
+    WorldEvent();
+    WorldEvent(Type type, Player::Direction direction = Player::NONE);
+
+    Type type;
+    Player::Direction direction;
+    uint32_t timeMs;
+  };
+
+  /**
+   * The state needed to display the world, as published by the simulation
+   * after each batch of steps: the current room, whether the simulation is
+   * paused, and the display state of the player and the room's dynamic
+   * objects.
+   */
+  class WorldSnapshot {
+  public:
+    WorldSnapshot();
+
+    Room* room;
+    bool paused;
+    Snapshot state;
+  };
+
   class WorldModel : public Model {
   public:
     WorldModel(World& world);
@@ -26,8 +66,17 @@ namespace mbostock {
     virtual void initialize();
     virtual void display();
 
+    /** Applies the most recently published snapshot. */
+    void update();
+
+    inline const Room& room() const { return *room_; }
+    inline bool paused() const { return paused_; }
+    const Vector& playerOrigin() const;
+
   private:
     World& world_;
+    Room* room_;
+    bool paused_;
   };
 
   class World : public Simulation {
@@ -37,42 +86,123 @@ namespace mbostock {
 
     static World* world();
 
-    void addRoom(Room* r);
-    void addMaterial(Material* m);
-    void addLighting(Lighting* l);
+    /**
+     * Sets the loader for the world's rooms (which is then owned by the
+     * world), and enters the first room. Rooms are built as they are needed.
+     */
+    void setLoader(RoomLoader* loader);
+
+    /**
+     * Replaces the loader, rebuilding only the rooms that changed (see
+     * RoomCache::reload), whose indexes are appended to changed. If the
+     * current room changed, the player stays where it is in the new room. The
+     * rewind buffer is cleared, as it may refer to the old rooms. Only call
+     * this while the simulation thread is stopped (or locked out).
+     */
+    void reload(RoomLoader* loader, std::vector<int>& changed);
 
     inline Player& player() { return player_; }
-    inline const std::vector<Room*>& rooms() const { return rooms_; }
+    inline RoomCache& rooms() { return rooms_; }
     inline Room& room() const { return *room_; }
-    inline Model& model() { return model_; }
+    inline WorldModel& model() { return model_; }
     inline const Lighting& pauseLighting() const { return pauseLighting_; }
 
+    /**
+     * Queues the specified event, to be applied before the next step. Returns
+     * false if the queue is full. May only be called by one thread.
+     */
+    bool post(const WorldEvent& e);
+
     void resetPlayer();
     void nextRoom();
     void previousRoom();
 
+    /**
+     * Restores the state from about a second ago (or further, if called
+     * repeatedly). The state is saved every second, for up to a minute.
+     */
+    void rewind();
+
+    /**
+     * Saves (or loads) the complete mutable state of the world: the current
+     * room and its state, the player, and the objects the player is touching.
+     */
+    void saveState(Snapshot& s) const;
+    void loadState(Snapshot& s);
+
     virtual void togglePaused();
 
     void toggleDebug();
     inline bool debug() const { return debug_; }
 
+    /** Disables music, as for worlds stepped headlessly on other threads. */
+    inline void setMuted(bool muted) { muted_ = muted; }
+
+    /**
+     * Disables the bookkeeping of interactive play on each step: the states
+     * saved for rewinding, recording, telemetry and the player's trails. Batch
+     * environments step without it.
+     */
+    inline void setBookkeeping(bool b) { bookkeeping_ = b; }
+
+    /**
+     * Records the input applied to the world from now on to the specified log,
+     * or stops recording if NULL. Steps are counted from the start of the
+     * recording. Only call this while the simulation thread is stopped.
+     */
+    void record(InputLog* log);
+
+    /**
+     * Returns a hash of the world's state, as saved by saveState, except for
+     * the room's trails, so that a replay needn't enter its start room as
+     * often as the recording did.
+     */
+    uint32_t stateHash();
+
+    /**
+     * Samples the player's state to the specified recorder at its interval,
+     * or stops if NULL. Only call this while the simulation thread is stopped.
+     */
+    inline void setTelemetry(TelemetryRecorder* t) { telemetry_ = t; }
+
   protected:
     virtual void step();
+    virtual void input(uint32_t timeMs);
+    virtual void publish();
 
   private:
-    void setRoom(Room* room, RoomOrigin* origin);
+    void setRoom(int room, int origin);
+    void apply(const WorldEvent& e);
+    void countStep();
+    void saveState(Snapshot& s, bool trails) const;
+    inline int roomIndex() const { return roomIndex_; }
 
     ParticleSimulator simulator_;
     GravitationalForce gravity_;
     Player player_;
     Lighting pauseLighting_;
-    std::vector<Lighting*> lightings_;
-    std::vector<Material*> materials_;
-    std::vector<Room*> rooms_;
+    RoomCache rooms_;
     std::vector<RoomObject*> contactObjects_;
     Room* room_;
+    int roomIndex_;
     bool debug_;
+    bool muted_;
+    bool bookkeeping_;
+    int portal_;
+    bool fell_;
+    ConcurrentQueue<WorldEvent, 256> events_;
+    TripleBuffer<WorldSnapshot> snapshots_;
     WorldModel model_;
+    InputLog* log_;
+    TelemetryRecorder* telemetry_;
+    uint32_t steps_;
+    Snapshot hashState_;
+    RewindBuffer rewind_;
+    Snapshot rewindState_;
+
+    friend class WorldModel;
+    friend class Replayer;
+    friend class BatchEnvironment;
   };
 
 }
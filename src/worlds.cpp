@@ -1,13 +1,16 @@
-#include <TinyXML/tinyxml.h>
+#include <SDL/SDL.h>
+#include <algorithm>
 #include <iostream>
-#include <list>
 #include <map>
 #include <math.h>
+#include <string.h>
 #include <string>
+#include <sys/stat.h>
 #include <vector>
 
 #include "ball.h"
 #include "block.h"
+#include "compiled_world.h"
 #include "escalator.h"
 #include "fan.h"
 #include "lighting.h"
@@ -16,6 +19,7 @@
 #include "ramp.h"
 #include "resource.h"
 #include "room.h"
+#include "room_cache.h"
 #include "room_force.h"
 #include "rotating.h"
 #include "seesaw.h"
@@ -26,773 +30,1636 @@
 #include "wall.h"
 #include "world.h"
 #include "worlds.h"
+#include "xml_reader.h"
 
 namespace mbostock {
 
   class Portal;
   class RoomForce;
   class RoomObject;
-  class RoomOrigin;
   class World;
 
-  class SwitchTargets {
+  /**
+   * The objects and transforms enclosed by a transform that has not yet been
+   * closed. Transforms are indexed as they close, so these references are
+   * patched when the enclosing transform's index is known.
+   */
+  class PendingTransform {
   public:
-    SwitchTargets(Switch* s);
+    std::vector<int> objects;
+    std::vector<int> transforms;
+  };
 
-    inline Switch* svitch() const { return switch_; }
+  /**
+   * An open element, as the compiler sees it. Elements that are compiled when
+   * they close (origins, portals, forces, transforms and objects) keep a copy
+   * of their attributes, along with the vectors given by their children; as
+   * with the first child of each name, only the first vector of each name is
+   * kept. The frames are reused, so that their buffers are too.
+   */
+  class XmlFrame {
+  public:
+    enum Child {
+      MIN, MAX, C, X, Y, Z, X0, X1, X2, X3, V, POSITION, VELOCITY, FORCE,
+      ORIGIN, AXIS, CAMERA_MIN, CAMERA_MAX, T0, T1, T2, T3, TEX_COORDS,
+      CHILDREN
+    };
 
-    void addTarget(const char* targetName);
-    inline const std::vector<std::string>& targets() const { return targets_; }
+    inline bool has(int child) const { return (present & (1 << child)) != 0; }
+    Vector vector(int child, const Vector& d) const;
+    inline const Vector& vector(int child) const { return vectors[child]; }
 
-  private:
-    Switch* switch_;
-    std::vector<std::string> targets_;
+    int context;
+    XmlElement element;
+    int present;
+
+    /** For switches, the index of the first target. */
+    int targets;
+
+    /** For transforms, the name, added in document order when opened. */
+    int name;
+
+    Vector vectors[CHILDREN];
   };
 
-  class XmlWorldBuilder {
+  /**
+   * A reference by name to a material or lighting. Materials and lightings
+   * may be defined after the rooms that use them, so these are resolved at
+   * the end.
+   */
+  class PendingReference {
   public:
-    XmlWorldBuilder();
+    enum Field { MATERIAL, TOP_MATERIAL, ACTIVE_MATERIAL, LIGHTING };
+
+    PendingReference(Field field, int index, const char* name);
 
-    World* parseWorld(const char* path);
+    Field field;
+
+    /** The index of the object, or for lightings, the room. */
+    int index;
+    std::string name;
+  };
+
+  /**
+   * Compiles a world from XML into flat records, resolving every name to an
+   * index. The XML is read in a single pass, without building a tree; rooms
+   * and their contents are compiled as their elements close. References to
+   * rooms, origins, transforms, materials and lightings may precede their
+   * definitions, so they are resolved at the end.
+   */
+  class XmlWorldCompiler : public XmlHandler {
+  public:
+    XmlWorldCompiler(CompiledWorldWriter& out);
+
+    bool compile(const char* path);
+    bool compile(const char* path, const char* data, size_t length);
+
+    virtual void startElement(const XmlElement& e);
+    virtual void endElement();
 
   private:
-    static Vector parseVector(TiXmlElement* e, const Vector& d);
-    static Vector parseVector(TiXmlElement* e);
-    static bool parseBool(TiXmlElement* e, const char* name, bool d);
-    static bool parseBool(TiXmlElement* e, const char* name);
-
-    void parseLightings(TiXmlElement* e);
-    void parseLighting(TiXmlElement* e);
-    void parseLightGlobalAmbient(Lighting* l, TiXmlElement* e);
-    void parseLights(Lighting* l, TiXmlElement* e);
-    void parseLight(Light& l, TiXmlElement* e);
-    void parseLightAmbient(Light& l, TiXmlElement* e);
-    void parseLightDiffuse(Light& l, TiXmlElement* e);
-    void parseLightSpecular(Light& l, TiXmlElement* e);
-    void parseLightPosition(Light& l, TiXmlElement* e);
-    void parseLightSpotDirection(Light& l, TiXmlElement* e);
-    void parseLightAttributes(Light& l, TiXmlElement* e);
-
-    void parseMaterials(TiXmlElement* e);
-    void parseMaterial(TiXmlElement* e);
-    void parseMaterialParameter(Material* m, TiXmlElement* e);
-
-    void parseRooms(TiXmlElement* e);
-    void parseRoom(TiXmlElement* e);
-    void parseRoomLighting(Room* r, TiXmlElement* e);
-    void parseRoomMusic(Room* r, TiXmlElement* e);
-    void parseRoomCameraBounds(Room* r, TiXmlElement* e);
-    void parseRoomTopLevelObjects(Room* r, TiXmlElement* e);
-    void parseRoomObjects(Room* r, TiXmlElement* e);
-
-    RoomOrigin* parseRoomOrigin(TiXmlElement* e);
-    Portal* parseRoomPortal(TiXmlElement* e);
-
-    RoomObject* parseRoomObject(TiXmlElement* e);
-    RoomObject* parseRoomBlock(TiXmlElement* e);
-    RoomObject* parseRoomAxisAlignedBlock(TiXmlElement* e);
-    RoomObject* parseRoomOrientedBlock(TiXmlElement* e);
-    RoomObject* parseRoomWall(TiXmlElement* e);
-    RoomObject* parseRoomQuadWall(TiXmlElement* e);
-    RoomObject* parseRoomTriWall(TiXmlElement* e);
-    RoomObject* parseRoomEscalator(TiXmlElement* e);
-    RoomObject* parseRoomSeesaw(TiXmlElement* e);
-    RoomObject* parseRoomRamp(TiXmlElement* e);
-    RoomObject* parseRoomTube(TiXmlElement* e);
-    RoomObject* parseRoomBall(TiXmlElement* e);
-    RoomObject* parseRoomFan(TiXmlElement* e);
-    RoomObject* parseRoomSwitch(TiXmlElement* e);
-
-    RoomForce* parseRoomConstantForce(TiXmlElement* e);
-
-    void parseRotation(Room* r, TiXmlElement* e);
-    void parseTranslation(Room* r, TiXmlElement* e);
-    RoomObject* applyTransforms(RoomObject* o);
-
-    void parseRoomSwitchTargets(Switch* s, TiXmlElement* e);
+    enum Context {
+      WORLD, LIGHTING, LIGHT, MATERIAL, ROOM, ROOM_ORIGIN, ROOM_PORTAL,
+      ROOM_FORCE, ROOM_TRANSFORM, ROOM_OBJECT, ROOM_TEX_COORDS, IGNORED
+    };
+
+    bool finish(const char* path, const XmlReader& reader, bool read);
+
+    static Vector parseVector(const XmlElement& e);
+    static bool parseBool(const XmlElement& e, const char* name, bool d);
+    static void parseColor(float* c, const XmlElement& e);
+    static bool parseChild(XmlFrame& f, const XmlElement& e, int begin,
+        int end);
+
+    int startChild(XmlFrame& parent, const XmlElement& e);
+    int startRoomObject(const XmlElement& e);
+    void startLighting(const XmlElement& e);
+    void startLight(const XmlElement& e);
+    void parseLightParameter(CompiledLight& l, const XmlElement& e);
+    void startMaterial(const XmlElement& e);
+    void parseMaterialParameter(CompiledMaterial& m, const XmlElement& e);
+    void startRoom(const XmlElement& e);
+    void endRoom(const XmlFrame& f);
+
+    void parseRoomOrigin(const XmlFrame& f);
+    void parseRoomPortal(const XmlFrame& f);
+    void parseRoomConstantForce(const XmlFrame& f);
+
+    void parseRoomObject(const XmlFrame& f);
+    void parseRoomBlock(CompiledObject& o, const XmlFrame& f);
+    void parseRoomWall(CompiledObject& o, const XmlFrame& f);
+    void parseRoomEscalator(CompiledObject& o, const XmlFrame& f);
+    void parseRoomSeesaw(CompiledObject& o, const XmlFrame& f);
+    void parseRoomRamp(CompiledObject& o, const XmlFrame& f);
+    void parseRoomTube(CompiledObject& o, const XmlFrame& f);
+    void parseRoomBall(CompiledObject& o, const XmlFrame& f);
+    void parseRoomFan(CompiledObject& o, const XmlFrame& f);
+    void parseRoomSwitch(CompiledObject& o, const XmlFrame& f);
+    void parseRoomSwitchTarget(const XmlElement& e);
+
+    void parseRotation(const XmlFrame& f);
+    void parseTranslation(const XmlFrame& f);
+    void parseTransform(CompiledTransform& z, const XmlFrame& f);
+
+    void findMaterial(PendingReference::Field field, const XmlFrame& f,
+        const char* name);
+    void resolveReferences();
+    void resolvePortals();
     void resolveSwitchTargets();
 
-    int findRoom(const char* name);
-    int findRoomOrigin(const char* name);
+    CompiledWorldWriter& out_;
+    std::vector<XmlFrame> frames_;
+    int depth_;
+    bool world_;
+    std::map<std::string, int> lightings_;
+    std::map<std::string, int> materials_;
+    std::map<std::string, int> rooms_;
+    std::map<std::string, int> origins_;
+    std::map<std::string, CompiledTarget> transforms_;
+    std::vector<PendingTransform> activeTransforms_;
+    std::vector<PendingReference> references_;
+    std::vector<std::string> portalOrigins_;
+    std::vector<std::string> targetNames_;
+    std::string roomName_;
+    int roomOrigins_;
+    bool valid_;
+  };
 
-    TiXmlDocument document_;
-    World* world_;
-    std::map<std::string, Lighting*> lightings_;
-    std::map<std::string, Material*> materials_;
-    std::map<std::string, Transform*> transforms_;
-    std::list<Transform*> activeTransforms_;
-    std::vector<SwitchTargets*> switchTargets_;
+  /**
+   * Builds parts of a world from its compiled records. The records are
+   * already validated, so every index can be used as is. A room's transforms
+   * must be built before the room, or any room whose switches target them.
+   */
+  class CompiledWorldBuilder {
+  public:
+    CompiledWorldBuilder(const CompiledWorld& world,
+        const std::vector<Lighting*>& lightings,
+        const std::vector<Material*>& materials);
+
+    Lighting* buildLighting(const CompiledLighting& c);
+    Material* buildMaterial(const CompiledMaterial& c);
+    void buildTransforms(const CompiledRoom& c);
+    Room* buildRoom(const CompiledRoom& c);
+
+  private:
+    void buildLight(Light& l, const CompiledLight& c);
+    Transform* buildTransform(const CompiledTransform& c);
+
+    RoomObject* buildRoomObject(const CompiledObject& c);
+    RoomObject* buildRoomAxisAlignedBlock(const CompiledObject& c);
+    RoomObject* buildRoomOrientedBlock(const CompiledObject& c);
+    RoomObject* buildRoomQuadWall(const CompiledObject& c);
+    RoomObject* buildRoomTriWall(const CompiledObject& c);
+    RoomObject* buildRoomEscalator(const CompiledObject& c);
+    RoomObject* buildRoomSeesaw(const CompiledObject& c);
+    RoomObject* buildRoomRamp(const CompiledObject& c);
+    RoomObject* buildRoomTube(const CompiledObject& c);
+    RoomObject* buildRoomBall(const CompiledObject& c);
+    RoomObject* buildRoomFan(const CompiledObject& c);
+    RoomObject* buildRoomSwitch(const CompiledObject& c);
+    RoomObject* applyTransforms(RoomObject* o, int transform);
+
+    const CompiledWorld& compiled_;
+    const std::vector<Lighting*>& lightings_;
+    const std::vector<Material*>& materials_;
+    std::map<int, Transform*> transforms_;
+  };
+
+  /**
+   * Loads the rooms of a compiled world, which it owns. The lightings,
+   * materials and music are shared by rooms, so they are loaded up front, by
+   * initialize; rooms are only built when loaded. Rooms are grouped by the
+   * switch targets that connect them.
+   */
+  /**
+   * Builds rooms from a compiled world. The loader owns the materials and
+   * lightings its rooms share; those with equal contents are built once. The
+   * loader of a reloaded world takes over those it has in common with the
+   * previous loader, which the rooms kept by the reload still use.
+   */
+  class CompiledRoomLoader : public RoomLoader {
+  public:
+    virtual ~CompiledRoomLoader();
+
+    inline CompiledWorld& compiled() { return compiled_; }
+
+    void initialize(CompiledRoomLoader* previous);
+
+    virtual int rooms() const;
+    virtual void group(int room, std::vector<int>& rooms) const;
+    virtual size_t size(int room) const;
+    virtual void load(const std::vector<int>& rooms,
+        std::vector<Room*>& out) const;
+    virtual void fingerprint(int room, std::vector<char>& out) const;
+
+  private:
+    void initializeGroups();
+    void fingerprintText(int offset, std::vector<char>& out) const;
+    void fingerprintLighting(int lighting, std::vector<char>& out) const;
+    void fingerprintMaterial(int material, std::vector<char>& out) const;
+
+    CompiledWorld compiled_;
+    std::vector<Lighting*> lightings_;
+    std::vector<Material*> materials_;
+    std::vector<Lighting*> ownedLightings_;
+    std::vector<Material*> ownedMaterials_;
+    std::vector<int> groupIndexes_;
+    std::vector<std::vector<int> > groups_;
   };
 
 }
 
 using namespace mbostock;
 
-SwitchTargets::SwitchTargets(Switch* s)
-    : switch_(s) {
+static void initializeObject(CompiledObject& o, CompiledObject::Type type) {
+  o.type = type;
+  o.transform = -1;
+  o.material = -1;
+  o.topMaterial = -1;
+  o.activeMaterial = -1;
+  o.radius = 1.f;
+  o.speed = 0.f;
+  o.mass = 1.f;
+  o.texCoords = 0;
+  o.targets.begin = 0;
+  o.targets.count = 0;
+}
+
+static void initializeTransform(CompiledTransform& z,
+    CompiledTransform::Type type) {
+  z.type = type;
+  z.mode = Translation::REVERSE;
+  z.parent = -1;
+  z.name = -1;
+  z.speed = 10.f;
+  z.start = 0.f;
+  z.dampen = 0.f;
 }
 
-void SwitchTargets::addTarget(const char* targetName) {
-  targets_.push_back(targetName);
+static const char* const childNames[XmlFrame::CHILDREN] = {
+  "min", "max", "c", "x", "y", "z", "x0", "x1", "x2", "x3", "v", "position",
+  "velocity", "force", "origin", "axis", "camera-min", "camera-max", "t0",
+  "t1", "t2", "t3", "tex-coords"
+};
+
+Vector XmlFrame::vector(int child, const Vector& d) const {
+  return has(child) ? vectors[child] : d;
+}
+
+PendingReference::PendingReference(Field field, int index, const char* name)
+    : field(field), index(index), name(name) {
+}
+
+XmlWorldCompiler::XmlWorldCompiler(CompiledWorldWriter& out)
+    : out_(out), depth_(0), world_(false), roomOrigins_(0), valid_(true) {
 }
 
-XmlWorldBuilder::XmlWorldBuilder()
-    : world_(NULL) {
+bool XmlWorldCompiler::compile(const char* path) {
+  XmlReader reader;
+  return finish(path, reader, reader.readFile(path, *this));
 }
 
-World* XmlWorldBuilder::parseWorld(const char* path) {
-  std::string fullPath(Resources::path());
-  fullPath.append(path);
-  if (!document_.LoadFile(fullPath.c_str())) {
+/* The path is only for reporting errors. */
+bool XmlWorldCompiler::compile(const char* path, const char* data,
+    size_t length) {
+  XmlReader reader;
+  return finish(path, reader, reader.read(data, length, *this));
+}
+
+bool XmlWorldCompiler::finish(const char* path, const XmlReader& reader,
+    bool read) {
+  if (!read) {
     std::cerr << "Error loading world \"" << path << "\": ";
-    std::cerr << document_.ErrorDesc() << "\n";
-    return NULL;
+    std::cerr << reader.error() << "\n";
+    return false;
   }
-
-  world_ = new World();
-  TiXmlElement* e = document_.FirstChildElement("world");
-  parseLightings(e);
-  parseMaterials(e);
-  parseRooms(e);
+  if (!world_) {
+    std::cerr << "Error loading world \"" << path << "\": no world\n";
+    return false;
+  }
+  resolveReferences();
+  resolvePortals();
   resolveSwitchTargets();
-  return world_;
+  return valid_;
 }
 
-void XmlWorldBuilder::parseLightings(TiXmlElement* e) {
-  for (TiXmlElement* l = e->FirstChildElement("lighting"); l != NULL;
-       l = l->NextSiblingElement("lighting")) {
-    parseLighting(l);
+/*
+ * Decides from the element's parent how the element is compiled, and opens a
+ * frame for it. Only the first world is compiled.
+ */
+void XmlWorldCompiler::startElement(const XmlElement& e) {
+  int context = IGNORED;
+  if (depth_ == 0) {
+    if (!world_ && (strcmp(e.name(), "world") == 0)) {
+      world_ = true;
+      context = WORLD;
+    }
+  } else {
+    context = startChild(frames_[depth_ - 1], e);
+  }
+  if (depth_ == (int) frames_.size()) {
+    frames_.push_back(XmlFrame());
+  }
+  XmlFrame& f = frames_[depth_++];
+  f.context = context;
+  f.present = 0;
+  switch (context) {
+    case ROOM_ORIGIN:
+    case ROOM_PORTAL:
+    case ROOM_FORCE:
+    case ROOM_TRANSFORM:
+    case ROOM_OBJECT: {
+      f.element = e;
+      f.targets = out_.targets.size();
+      if (context == ROOM_TRANSFORM) {
+        f.name = out_.addString(e.attribute("name"));
+      }
+      break;
+    }
   }
 }
 
-void XmlWorldBuilder::parseLighting(TiXmlElement* e) {
-  Lighting* l = new Lighting();
-  lightings_[e->Attribute("name")] = l;
-  parseLightGlobalAmbient(l, e->FirstChildElement("ambient"));
-  parseLights(l, e);
-  world_->addLighting(l);
+void XmlWorldCompiler::endElement() {
+  const XmlFrame& f = frames_[--depth_];
+  switch (f.context) {
+    case ROOM: endRoom(f); break;
+    case ROOM_ORIGIN: parseRoomOrigin(f); break;
+    case ROOM_PORTAL: parseRoomPortal(f); break;
+    case ROOM_FORCE: parseRoomConstantForce(f); break;
+    case ROOM_OBJECT: parseRoomObject(f); break;
+    case ROOM_TRANSFORM: {
+      if (strcmp(f.element.name(), "rotation") == 0) {
+        parseRotation(f);
+      } else {
+        parseTranslation(f);
+      }
+      break;
+    }
+  }
 }
 
-void XmlWorldBuilder::parseLightGlobalAmbient(Lighting* l, TiXmlElement* e) {
-  if (e != NULL) {
-    float r = 0.f, g = 0.f, b = 0.f, a = 1.f;
-    e->QueryFloatAttribute("r", &r);
-    e->QueryFloatAttribute("g", &g);
-    e->QueryFloatAttribute("b", &b);
-    e->QueryFloatAttribute("a", &a);
-    l->setGlobalAmbient(r, g, b, a);
+int XmlWorldCompiler::startChild(XmlFrame& parent, const XmlElement& e) {
+  const char* name = e.name();
+  switch (parent.context) {
+    case WORLD: {
+      if (strcmp(name, "lighting") == 0) {
+        startLighting(e);
+        return LIGHTING;
+      } else if (strcmp(name, "material") == 0) {
+        startMaterial(e);
+        return MATERIAL;
+      } else if (strcmp(name, "room") == 0) {
+        startRoom(e);
+        return ROOM;
+      }
+      break;
+    }
+    case LIGHTING: {
+      CompiledLighting& l = out_.lightings.back();
+      if (strcmp(name, "ambient") == 0) {
+        if (!(l.flags & CompiledLighting::GLOBAL_AMBIENT)) {
+          l.flags |= CompiledLighting::GLOBAL_AMBIENT;
+          parseColor(l.globalAmbient, e);
+        }
+      } else if ((strcmp(name, "light") == 0)
+          && (l.lights.count < Lighting().lights())) {
+        startLight(e);
+        return LIGHT;
+      }
+      break;
+    }
+    case LIGHT: {
+      parseLightParameter(out_.lights.back(), e);
+      break;
+    }
+    case MATERIAL: {
+      parseMaterialParameter(out_.materials.back(), e);
+      break;
+    }
+    case ROOM: {
+      if (!parseChild(parent, e, XmlFrame::CAMERA_MIN, XmlFrame::CAMERA_MAX)) {
+        return startRoomObject(e);
+      }
+      break;
+    }
+    case ROOM_TRANSFORM: {
+      if (!parseChild(parent, e, XmlFrame::MIN, XmlFrame::AXIS)) {
+        return startRoomObject(e);
+      }
+      break;
+    }
+    case ROOM_ORIGIN:
+    case ROOM_PORTAL:
+    case ROOM_FORCE: {
+      parseChild(parent, e, XmlFrame::MIN, XmlFrame::AXIS);
+      break;
+    }
+    case ROOM_OBJECT: {
+      if (strcmp(name, "tex-coords") == 0) {
+        if (!parent.has(XmlFrame::TEX_COORDS)) {
+          parent.present |= 1 << XmlFrame::TEX_COORDS;
+          return ROOM_TEX_COORDS;
+        }
+      } else if (strcmp(name, "target") == 0) {
+        if (strcmp(parent.element.name(), "switch") == 0) {
+          parseRoomSwitchTarget(e);
+        }
+      } else {
+        parseChild(parent, e, XmlFrame::MIN, XmlFrame::AXIS);
+      }
+      break;
+    }
+    case ROOM_TEX_COORDS: {
+      parseChild(frames_[depth_ - 2], e, XmlFrame::T0, XmlFrame::T3);
+      break;
+    }
   }
+  return IGNORED;
 }
 
-void XmlWorldBuilder::parseLights(Lighting* l, TiXmlElement* e) {
-  int i = 0;
-  for (TiXmlElement* le = e->FirstChildElement("light");
-       le != NULL; le = le->NextSiblingElement("light")) {
-    parseLight(l->light(i++), le);
+/*
+ * Origins and portals are only recognized at the top level of a room. Any
+ * other element is assumed to be an object; unknown objects are ignored when
+ * they close.
+ */
+int XmlWorldCompiler::startRoomObject(const XmlElement& e) {
+  const char* name = e.name();
+  if (strcmp(name, "origin") == 0) {
+    return activeTransforms_.empty() ? ROOM_ORIGIN : IGNORED;
+  } else if (strcmp(name, "portal") == 0) {
+    return activeTransforms_.empty() ? ROOM_PORTAL : IGNORED;
+  } else if (strcmp(name, "constant-force") == 0) {
+    return ROOM_FORCE;
+  } else if ((strcmp(name, "rotation") == 0)
+      || (strcmp(name, "translation") == 0)) {
+    activeTransforms_.push_back(PendingTransform());
+    return ROOM_TRANSFORM;
   }
+  return ROOM_OBJECT;
 }
 
-void XmlWorldBuilder::parseLight(Light& l, TiXmlElement* e) {
-  parseLightAmbient(l, e->FirstChildElement("ambient"));
-  parseLightSpecular(l, e->FirstChildElement("specular"));
-  parseLightDiffuse(l, e->FirstChildElement("diffuse"));
-  parseLightPosition(l, e->FirstChildElement("position"));
-  parseLightSpotDirection(l, e->FirstChildElement("spot-direction"));
-  parseLightAttributes(l, e);
-  l.enable();
+/*
+ * Records the vector given by the child, if the child's name is within the
+ * specified range of names, and it is the first child of that name. Returns
+ * false if the name is not within the range.
+ */
+bool XmlWorldCompiler::parseChild(XmlFrame& f, const XmlElement& e, int begin,
+    int end) {
+  for (int i = begin; i <= end; i++) {
+    if (strcmp(e.name(), childNames[i]) == 0) {
+      if (!f.has(i)) {
+        f.present |= 1 << i;
+        f.vectors[i] = parseVector(e);
+      }
+      return true;
+    }
+  }
+  return false;
 }
 
-void XmlWorldBuilder::parseLightAmbient(Light& l, TiXmlElement* e) {
-  if (e != NULL) {
-    float r = 0.f, g = 0.f, b = 0.f, a = 1.f;
-    e->QueryFloatAttribute("r", &r);
-    e->QueryFloatAttribute("g", &g);
-    e->QueryFloatAttribute("b", &b);
-    e->QueryFloatAttribute("a", &a);
-    l.setAmbient(r, g, b, a);
+void XmlWorldCompiler::startLighting(const XmlElement& e) {
+  CompiledLighting l;
+  l.flags = 0;
+  l.lights.begin = out_.lights.size();
+  l.lights.count = 0;
+  const char* name = e.attribute("name");
+  if (name != NULL) {
+    lightings_[name] = out_.lightings.size();
   }
+  out_.lightings.push_back(l);
 }
 
-void XmlWorldBuilder::parseLightSpecular(Light& l, TiXmlElement* e) {
-  if (e != NULL) {
-    float r = 0.f, g = 0.f, b = 0.f, a = 1.f;
-    e->QueryFloatAttribute("r", &r);
-    e->QueryFloatAttribute("g", &g);
-    e->QueryFloatAttribute("b", &b);
-    e->QueryFloatAttribute("a", &a);
-    l.setSpecular(r, g, b, a);
+void XmlWorldCompiler::startLight(const XmlElement& e) {
+  CompiledLight l;
+  memset(&l, 0, sizeof(l));
+  if (e.queryFloat("spot-exponent", &l.spotExponent)) {
+    l.flags |= CompiledLight::SPOT_EXPONENT;
+  }
+  if (e.queryFloat("constant-attenuation", &l.constantAttenuation)) {
+    l.flags |= CompiledLight::CONSTANT_ATTENUATION;
   }
+  if (e.queryFloat("linear-attenuation", &l.linearAttenuation)) {
+    l.flags |= CompiledLight::LINEAR_ATTENUATION;
+  }
+  if (e.queryFloat("quadratic-attenuation", &l.quadraticAttenuation)) {
+    l.flags |= CompiledLight::QUADRATIC_ATTENUATION;
+  }
+  out_.lights.push_back(l);
+  out_.lightings.back().lights.count++;
 }
 
-void XmlWorldBuilder::parseLightDiffuse(Light& l, TiXmlElement* e) {
-  if (e != NULL) {
-    float r = 0.f, g = 0.f, b = 0.f, a = 1.f;
-    e->QueryFloatAttribute("r", &r);
-    e->QueryFloatAttribute("g", &g);
-    e->QueryFloatAttribute("b", &b);
-    e->QueryFloatAttribute("a", &a);
-    l.setDiffuse(r, g, b, a);
+void XmlWorldCompiler::parseLightParameter(CompiledLight& l,
+    const XmlElement& e) {
+  const char* name = e.name();
+  if (strcmp(name, "ambient") == 0) {
+    if (!(l.flags & CompiledLight::AMBIENT)) {
+      l.flags |= CompiledLight::AMBIENT;
+      parseColor(l.ambient, e);
+    }
+  } else if (strcmp(name, "specular") == 0) {
+    if (!(l.flags & CompiledLight::SPECULAR)) {
+      l.flags |= CompiledLight::SPECULAR;
+      parseColor(l.specular, e);
+    }
+  } else if (strcmp(name, "diffuse") == 0) {
+    if (!(l.flags & CompiledLight::DIFFUSE)) {
+      l.flags |= CompiledLight::DIFFUSE;
+      parseColor(l.diffuse, e);
+    }
+  } else if (strcmp(name, "position") == 0) {
+    if (!(l.flags & CompiledLight::POSITION)) {
+      l.flags |= CompiledLight::POSITION;
+      l.position[2] = 1.f;
+      e.queryFloat("x", &l.position[0]);
+      e.queryFloat("y", &l.position[1]);
+      e.queryFloat("z", &l.position[2]);
+      e.queryFloat("w", &l.position[3]);
+    }
+  } else if (strcmp(name, "spot-direction") == 0) {
+    if (!(l.flags & CompiledLight::SPOT_DIRECTION)) {
+      l.flags |= CompiledLight::SPOT_DIRECTION;
+      l.spotDirection[2] = -1.f;
+      e.queryFloat("x", &l.spotDirection[0]);
+      e.queryFloat("y", &l.spotDirection[1]);
+      e.queryFloat("z", &l.spotDirection[2]);
+    }
   }
 }
 
-void XmlWorldBuilder::parseLightPosition(Light& l, TiXmlElement* e) {
-  if (e != NULL) {
-    float x, y, z, w;
-    e->QueryFloatAttribute("x", &x);
-    e->QueryFloatAttribute("y", &y);
-    e->QueryFloatAttribute("z", &z);
-    e->QueryFloatAttribute("w", &w);
-    l.setPosition(x, y, z, w);
+void XmlWorldCompiler::startMaterial(const XmlElement& e) {
+  CompiledMaterial m;
+  memset(&m, 0, sizeof(m));
+  m.texture = -1;
+  m.slipAngle = 90.f;
+  e.queryFloat("slip-angle", &m.slipAngle);
+  const char* name = e.attribute("name");
+  if (name != NULL) {
+    materials_[name] = out_.materials.size();
   }
+  out_.materials.push_back(m);
 }
 
-void XmlWorldBuilder::parseLightSpotDirection(Light& l, TiXmlElement* e) {
-  if (e != NULL) {
-    float x, y, z;
-    e->QueryFloatAttribute("x", &x);
-    e->QueryFloatAttribute("y", &y);
-    e->QueryFloatAttribute("z", &z);
-    l.setSpotDirection(x, y, z);
+void XmlWorldCompiler::parseMaterialParameter(CompiledMaterial& m,
+    const XmlElement& e) {
+  const char* name = e.name();
+  if (strcmp(name, "texture") == 0) {
+    m.texture = out_.addString(e.attribute("path"));
+  } else if (strcmp(name, "ambient") == 0) {
+    m.flags |= CompiledMaterial::AMBIENT;
+    parseColor(m.ambient, e);
+  } else if (strcmp(name, "diffuse") == 0) {
+    m.flags |= CompiledMaterial::DIFFUSE;
+    parseColor(m.diffuse, e);
+  } else if (strcmp(name, "emission") == 0) {
+    m.flags |= CompiledMaterial::EMISSION;
+    parseColor(m.emission, e);
+  } else if (strcmp(name, "specular") == 0) {
+    m.flags |= CompiledMaterial::SPECULAR;
+    parseColor(m.specular, e);
   }
 }
 
-void XmlWorldBuilder::parseLightAttributes(Light& l, TiXmlElement* e) {
-  if (e->Attribute("spot-exponent")) {
-    float f;
-    e->QueryFloatAttribute("spot-exponent", &f);
-    l.setSpotExponent(f);
+/*
+ * The room's record is added when it opens, so that its contents can refer to
+ * it, and its ranges are completed when it closes.
+ */
+void XmlWorldCompiler::startRoom(const XmlElement& e) {
+  CompiledRoom r;
+  const char* name = e.attribute("name");
+  roomName_ = (name == NULL) ? "" : name;
+  if ((name != NULL) && (rooms_.find(name) == rooms_.end())) {
+    rooms_[name] = out_.rooms.size();
   }
-  if (e->Attribute("constant-attenuation")) {
-    float f;
-    e->QueryFloatAttribute("constant-attenuation", &f);
-    l.setConstantAttenuation(f);
+  r.name = out_.addString(name);
+  r.lighting = -1;
+  const char* lighting = e.attribute("lighting");
+  if (lighting != NULL) {
+    references_.push_back(PendingReference(PendingReference::LIGHTING,
+        out_.rooms.size(), lighting));
   }
-  if (e->Attribute("linear-attenuation")) {
-    float f;
-    e->QueryFloatAttribute("linear-attenuation", &f);
-    l.setLinearAttenuation(f);
+  r.music = out_.addString(e.attribute("music"));
+  r.origins.begin = roomOrigins_ = out_.origins.size();
+  r.portals.begin = out_.portals.size();
+  r.forces.begin = out_.forces.size();
+  r.transforms.begin = out_.transforms.size();
+  r.objects.begin = out_.objects.size();
+  out_.rooms.push_back(r);
+}
+
+void XmlWorldCompiler::endRoom(const XmlFrame& f) {
+  CompiledRoom& r = out_.rooms.back();
+  r.cameraMin = f.vector(XmlFrame::CAMERA_MIN, -Vector::INF());
+  r.cameraMax = f.vector(XmlFrame::CAMERA_MAX, Vector::INF());
+  r.origins.count = out_.origins.size() - r.origins.begin;
+  r.portals.count = out_.portals.size() - r.portals.begin;
+  r.forces.count = out_.forces.size() - r.forces.begin;
+  r.transforms.count = out_.transforms.size() - r.transforms.begin;
+  r.objects.count = out_.objects.size() - r.objects.begin;
+}
+
+void XmlWorldCompiler::parseRoomOrigin(const XmlFrame& f) {
+  CompiledOrigin o;
+  const char* name = f.element.attribute("name");
+  o.name = out_.addString(name);
+  o.position = f.vector(XmlFrame::POSITION);
+  o.velocity = f.vector(XmlFrame::VELOCITY);
+  if (name != NULL) {
+    std::string key = roomName_ + "." + name;
+    if (origins_.find(key) == origins_.end()) {
+      origins_[key] = out_.origins.size() - roomOrigins_;
+    }
   }
-  if (e->Attribute("quadratic-attenuation")) {
-    float f;
-    e->QueryFloatAttribute("quadratic-attenuation", &f);
-    l.setQuadraticAttenuation(f);
+  out_.origins.push_back(o);
+}
+
+void XmlWorldCompiler::parseRoomPortal(const XmlFrame& f) {
+  CompiledPortal p;
+  p.min = f.vector(XmlFrame::MIN);
+  p.max = f.vector(XmlFrame::MAX);
+  p.room = -1;
+  p.origin = -1;
+  p.reset = parseBool(f.element, "reset", false);
+  const char* origin = f.element.attribute("origin");
+  portalOrigins_.push_back((origin == NULL) ? "" : origin);
+  out_.portals.push_back(p);
+}
+
+void XmlWorldCompiler::parseRoomConstantForce(const XmlFrame& f) {
+  CompiledForce c;
+  c.min = f.vector(XmlFrame::MIN);
+  c.max = f.vector(XmlFrame::MAX);
+  c.force = f.vector(XmlFrame::FORCE);
+  out_.forces.push_back(c);
+}
+
+void XmlWorldCompiler::parseRotation(const XmlFrame& f) {
+  CompiledTransform z;
+  initializeTransform(z, CompiledTransform::ROTATION);
+  f.element.queryFloat("speed", &z.speed);
+  f.element.queryFloat("angle", &z.start);
+  z.x0 = f.vector(XmlFrame::ORIGIN);
+  z.x1 = f.vector(XmlFrame::AXIS);
+  parseTransform(z, f);
+}
+
+void XmlWorldCompiler::parseTranslation(const XmlFrame& f) {
+  CompiledTransform z;
+  initializeTransform(z, CompiledTransform::TRANSLATION);
+  f.element.queryFloat("speed", &z.speed);
+  f.element.queryFloat("start", &z.start);
+  f.element.queryFloat("dampen", &z.dampen);
+  z.x0 = f.vector(XmlFrame::X0);
+  z.x1 = f.vector(XmlFrame::X1);
+  const char* mode = f.element.attribute("mode");
+  if (mode != NULL) {
+    if (strcmp(mode, "one-way") == 0) {
+      z.mode = Translation::ONE_WAY;
+    } else if (strcmp(mode, "reset") == 0) {
+      z.mode = Translation::RESET;
+    }
   }
+  parseTransform(z, f);
 }
 
-void XmlWorldBuilder::parseMaterials(TiXmlElement* e) {
-  for (TiXmlElement* m = e->FirstChildElement("material"); m != NULL;
-       m = m->NextSiblingElement("material")) {
-    parseMaterial(m);
+/*
+ * The transform's children have already been compiled, so they are patched
+ * to refer to it now that its index is known.
+ */
+void XmlWorldCompiler::parseTransform(CompiledTransform& z,
+    const XmlFrame& f) {
+  const char* name = f.element.attribute("name");
+  z.name = f.name;
+  int index = out_.transforms.size();
+  const PendingTransform& p = activeTransforms_.back();
+  std::vector<int>::const_iterator i;
+  for (i = p.objects.begin(); i != p.objects.end(); i++) {
+    out_.objects[*i].transform = index;
+  }
+  for (i = p.transforms.begin(); i != p.transforms.end(); i++) {
+    out_.transforms[*i].parent = index;
+  }
+  activeTransforms_.pop_back();
+  if (!activeTransforms_.empty()) {
+    activeTransforms_.back().transforms.push_back(index);
   }
+  if (name != NULL) {
+    CompiledTarget& t = transforms_[name];
+    t.room = out_.rooms.size() - 1;
+    t.transform = index;
+  }
+  out_.transforms.push_back(z);
 }
 
-void XmlWorldBuilder::parseMaterial(TiXmlElement* e) {
-  Material* m = new Material();
-  materials_[e->Attribute("name")] = m;
-  float s = 90.f;
-  e->QueryFloatAttribute("slip-angle", &s);
-  m->setSlipAngle(s);
-  for (TiXmlElement* p = e->FirstChildElement(); p != NULL;
-       p = p->NextSiblingElement()) {
-    parseMaterialParameter(m, p);
+void XmlWorldCompiler::parseRoomObject(const XmlFrame& f) {
+  CompiledObject o;
+  const char* name = f.element.name();
+  if (strcmp(name, "block") == 0) {
+    parseRoomBlock(o, f);
+  } else if (strcmp(name, "wall") == 0) {
+    parseRoomWall(o, f);
+  } else if (strcmp(name, "escalator") == 0) {
+    parseRoomEscalator(o, f);
+  } else if (strcmp(name, "seesaw") == 0) {
+    parseRoomSeesaw(o, f);
+  } else if (strcmp(name, "ramp") == 0) {
+    parseRoomRamp(o, f);
+  } else if (strcmp(name, "tube") == 0) {
+    parseRoomTube(o, f);
+  } else if (strcmp(name, "ball") == 0) {
+    parseRoomBall(o, f);
+  } else if (strcmp(name, "fan") == 0) {
+    parseRoomFan(o, f);
+  } else if (strcmp(name, "switch") == 0) {
+    parseRoomSwitch(o, f);
+  } else {
+    return; // ignore unknown objects
+  }
+  if (!activeTransforms_.empty()) {
+    activeTransforms_.back().objects.push_back(out_.objects.size());
   }
-  world_->addMaterial(m);
+  out_.objects.push_back(o);
 }
 
-void XmlWorldBuilder::parseMaterialParameter(Material* m, TiXmlElement* e) {
-  const std::string& name = e->ValueStr();
-  if (name == "texture") {
-    m->setTexture(e->Attribute("path"));
-    return;
+void XmlWorldCompiler::parseRoomBlock(CompiledObject& o, const XmlFrame& f) {
+  if (f.has(XmlFrame::MIN)) {
+    initializeObject(o, CompiledObject::AXIS_ALIGNED_BLOCK);
+    o.x[0] = f.vector(XmlFrame::MIN);
+    o.x[1] = f.vector(XmlFrame::MAX);
+  } else {
+    initializeObject(o, CompiledObject::BLOCK);
+    o.x[0] = f.vector(XmlFrame::C);
+    o.x[1] = f.vector(XmlFrame::X);
+    o.x[2] = f.vector(XmlFrame::Y);
+    o.x[3] = f.vector(XmlFrame::Z);
   }
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "top-material");
+}
 
-  float r = 0.f, g = 0.f, b = 0.f, a = 1.f;
-  e->QueryFloatAttribute("r", &r);
-  e->QueryFloatAttribute("g", &g);
-  e->QueryFloatAttribute("b", &b);
-  e->QueryFloatAttribute("a", &a);
+void XmlWorldCompiler::parseRoomWall(CompiledObject& o, const XmlFrame& f) {
+  bool quad = f.has(XmlFrame::X3);
+  initializeObject(o, quad ? CompiledObject::QUAD_WALL
+      : CompiledObject::TRI_WALL);
+  o.x[0] = f.vector(XmlFrame::X0);
+  o.x[1] = f.vector(XmlFrame::X1);
+  o.x[2] = f.vector(XmlFrame::X2);
+  if (quad) {
+    o.x[3] = f.vector(XmlFrame::X3);
+  }
+  if (f.has(XmlFrame::TEX_COORDS)) {
+    o.texCoords = 1;
+    o.t[0] = f.vector(XmlFrame::T0);
+    o.t[1] = f.vector(XmlFrame::T1);
+    o.t[2] = f.vector(XmlFrame::T2);
+    if (quad) {
+      o.t[3] = f.vector(XmlFrame::T3);
+    }
+  }
+  findMaterial(PendingReference::MATERIAL, f, "material");
+}
+
+void XmlWorldCompiler::parseRoomEscalator(CompiledObject& o,
+    const XmlFrame& f) {
+  initializeObject(o, CompiledObject::ESCALATOR);
+  o.x[0] = f.vector(XmlFrame::MIN);
+  o.x[1] = f.vector(XmlFrame::MAX);
+  o.x[2] = f.vector(XmlFrame::V);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "top-material");
+}
 
-  if (name == "ambient") {
-    m->setAmbient(r, g, b, a);
-  } else if (name == "diffuse") {
-    m->setDiffuse(r, g, b, a);
-  } else if (name == "emission") {
-    m->setEmission(r, g, b, a);
-  } else if (name == "specular") {
-    m->setSpecular(r, g, b, a);
+void XmlWorldCompiler::parseRoomSeesaw(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::SEESAW);
+  f.element.queryFloat("mass", &o.mass);
+  o.x[0] = f.vector(XmlFrame::MIN);
+  o.x[1] = f.vector(XmlFrame::MAX);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "top-material");
+}
+
+void XmlWorldCompiler::parseRoomRamp(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::RAMP);
+  o.x[0] = f.vector(XmlFrame::X0);
+  o.x[1] = f.vector(XmlFrame::X1);
+  o.x[2] = f.vector(XmlFrame::X2);
+  o.x[3] = f.vector(XmlFrame::X3);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "top-material");
+}
+
+void XmlWorldCompiler::parseRoomTube(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::TUBE);
+  f.element.queryFloat("radius", &o.radius);
+  o.x[0] = f.vector(XmlFrame::X0);
+  o.x[1] = f.vector(XmlFrame::X1);
+  o.x[2] = f.vector(XmlFrame::Y, Vector::Y());
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "cap-material");
+}
+
+void XmlWorldCompiler::parseRoomBall(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::BALL);
+  f.element.queryFloat("radius", &o.radius);
+  o.x[0] = f.vector(XmlFrame::X);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+}
+
+void XmlWorldCompiler::parseRoomFan(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::FAN);
+  f.element.queryFloat("radius", &o.radius);
+  f.element.queryFloat("speed", &o.speed);
+  o.x[0] = f.vector(XmlFrame::X);
+  o.x[1] = f.vector(XmlFrame::V);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+}
+
+/* The switch's targets have already been added, as its children opened. */
+void XmlWorldCompiler::parseRoomSwitch(CompiledObject& o, const XmlFrame& f) {
+  initializeObject(o, CompiledObject::SWITCH);
+  o.x[0] = f.vector(XmlFrame::MIN);
+  o.x[1] = f.vector(XmlFrame::MAX);
+  findMaterial(PendingReference::MATERIAL, f, "material");
+  findMaterial(PendingReference::TOP_MATERIAL, f, "top-material");
+  findMaterial(PendingReference::ACTIVE_MATERIAL, f, "active-material");
+  o.targets.begin = f.targets;
+  o.targets.count = out_.targets.size() - f.targets;
+}
+
+void XmlWorldCompiler::parseRoomSwitchTarget(const XmlElement& e) {
+  const char* name = e.attribute("name");
+  CompiledTarget target;
+  target.room = -1;
+  target.transform = -1;
+  out_.targets.push_back(target);
+  targetNames_.push_back((name == NULL) ? "" : name);
+}
+
+/* Records a reference from the object being compiled to a material. */
+void XmlWorldCompiler::findMaterial(PendingReference::Field field,
+    const XmlFrame& f, const char* name) {
+  const char* material = f.element.attribute(name);
+  if (material != NULL) {
+    references_.push_back(PendingReference(field, out_.objects.size(),
+        material));
   }
 }
 
-void XmlWorldBuilder::parseRooms(TiXmlElement* e) {
-  for (TiXmlElement* r = e->FirstChildElement("room"); r != NULL;
-       r = r->NextSiblingElement("room")) {
-    parseRoom(r);
+void XmlWorldCompiler::resolveReferences() {
+  std::vector<PendingReference>::const_iterator i;
+  for (i = references_.begin(); i != references_.end(); i++) {
+    bool lighting = (i->field == PendingReference::LIGHTING);
+    const std::map<std::string, int>& names = lighting
+        ? lightings_
+        : materials_;
+    std::map<std::string, int>::const_iterator j = names.find(i->name);
+    if (j == names.end()) {
+      std::cerr << "Error: could not find "
+                << (lighting ? "lighting " : "material ") << i->name << "\n";
+      valid_ = false;
+      continue;
+    }
+    switch (i->field) {
+      case PendingReference::MATERIAL: {
+        out_.objects[i->index].material = j->second;
+        break;
+      }
+      case PendingReference::TOP_MATERIAL: {
+        out_.objects[i->index].topMaterial = j->second;
+        break;
+      }
+      case PendingReference::ACTIVE_MATERIAL: {
+        out_.objects[i->index].activeMaterial = j->second;
+        break;
+      }
+      case PendingReference::LIGHTING: {
+        out_.rooms[i->index].lighting = j->second;
+        break;
+      }
+    }
+  }
+  references_.clear();
+}
+void XmlWorldCompiler::resolvePortals() {
+  for (int i = 0; i < (int) portalOrigins_.size(); i++) {
+    const std::string& s = portalOrigins_[i];
+    int j = s.find('.');
+    std::string roomName = s.substr(0, j);
+    std::string originName = s.substr(j + 1);
+    CompiledPortal& p = out_.portals[i];
+    std::map<std::string, int>::const_iterator r = rooms_.find(roomName);
+    if (r == rooms_.end()) {
+      std::cerr << "Error: could not find room " << s << "\n";
+      continue;
+    }
+    p.room = r->second;
+    std::map<std::string, int>::const_iterator o
+        = origins_.find(roomName + "." + originName);
+    if (o == origins_.end()) {
+      std::cerr << "Error: could not find origin " << roomName << "."
+                << originName << "\n";
+      continue;
+    }
+    p.origin = o->second;
   }
+  portalOrigins_.clear();
 }
 
-void XmlWorldBuilder::parseRoom(TiXmlElement* e) {
-  Room* r = new Room();
-  parseRoomLighting(r, e);
-  parseRoomMusic(r, e);
-  parseRoomCameraBounds(r, e);
-  parseRoomTopLevelObjects(r, e);
-  world_->addRoom(r);
+void XmlWorldCompiler::resolveSwitchTargets() {
+  for (int i = 0; i < (int) targetNames_.size(); i++) {
+    std::map<std::string, CompiledTarget>::const_iterator t
+        = transforms_.find(targetNames_[i]);
+    if (t == transforms_.end()) {
+      std::cerr << "Error: could not find transform " << targetNames_[i]
+                << "\n";
+      valid_ = false;
+      continue;
+    }
+    out_.targets[i] = t->second;
+  }
+  targetNames_.clear();
 }
 
-void XmlWorldBuilder::parseRoomLighting(Room* r, TiXmlElement* e) {
-  const char* lighting = e->Attribute("lighting");
-  if (lighting != NULL) {
-    r->setLighting(*lightings_[lighting]);
+Vector XmlWorldCompiler::parseVector(const XmlElement& e) {
+  Vector v;
+  e.queryFloat("x", &v.x);
+  e.queryFloat("y", &v.y);
+  e.queryFloat("z", &v.z);
+  return v;
+}
+
+bool XmlWorldCompiler::parseBool(const XmlElement& e, const char* name,
+    bool d) {
+  const char* value = e.attribute(name);
+  if (value == NULL) {
+    return d;
   }
+  return strcmp(value, "true") == 0;
+}
+
+void XmlWorldCompiler::parseColor(float* c, const XmlElement& e) {
+  c[0] = c[1] = c[2] = 0.f;
+  c[3] = 1.f;
+  e.queryFloat("r", &c[0]);
+  e.queryFloat("g", &c[1]);
+  e.queryFloat("b", &c[2]);
+  e.queryFloat("a", &c[3]);
 }
 
-void XmlWorldBuilder::parseRoomMusic(Room* r, TiXmlElement* e) {
-  const char* music = e->Attribute("music");
-  if (music != NULL) {
-    r->setMusic(Sounds::fromFile(music));
+/* Returns the root of the room's group, flattening the path to it. */
+static int findGroup(std::vector<int>& parents, int i) {
+  while (parents[i] != i) {
+    i = parents[i] = parents[parents[i]];
   }
+  return i;
 }
 
-void XmlWorldBuilder::parseRoomCameraBounds(Room* r, TiXmlElement* e) {
-  Vector min = parseVector(e->FirstChildElement("camera-min"), -Vector::INF());
-  Vector max = parseVector(e->FirstChildElement("camera-max"), Vector::INF());
-  r->setCameraBounds(min, max);
+/* The size of a room object, not counting its transforms. */
+static size_t objectSize(const CompiledObject& c) {
+  switch (c.type) {
+    case CompiledObject::AXIS_ALIGNED_BLOCK: return sizeof(AxisAlignedBlock);
+    case CompiledObject::BLOCK: return sizeof(Block);
+    case CompiledObject::QUAD_WALL: return sizeof(Wall);
+    case CompiledObject::TRI_WALL: return sizeof(TriWall);
+    case CompiledObject::ESCALATOR: return sizeof(Escalator);
+    case CompiledObject::SEESAW: return sizeof(Seesaw);
+    case CompiledObject::RAMP: return sizeof(Ramp);
+    case CompiledObject::TUBE: return sizeof(Tube);
+    case CompiledObject::BALL: return sizeof(Ball);
+    case CompiledObject::FAN: return sizeof(Fan);
+  }
+  return sizeof(Switch);
 }
 
-void XmlWorldBuilder::parseRoomTopLevelObjects(Room* r, TiXmlElement* e) {
-  for (TiXmlElement* o = e->FirstChildElement(); o != NULL;
-       o = o->NextSiblingElement()) {
-    const std::string& name = o->ValueStr();
-    if (name == "origin") {
-      r->addOrigin(parseRoomOrigin(o));
-    } else if (name == "portal") {
-      r->addPortal(parseRoomPortal(o));
+CompiledRoomLoader::~CompiledRoomLoader() {
+  std::vector<Lighting*>::const_iterator il;
+  for (il = ownedLightings_.begin(); il != ownedLightings_.end(); il++) {
+    delete *il;
+  }
+  std::vector<Material*>::const_iterator im;
+  for (im = ownedMaterials_.begin(); im != ownedMaterials_.end(); im++) {
+    delete *im;
+  }
+}
+
+/* Moves ownership of t from one list to another, if not moved already. */
+template <class T>
+static void adopt(T* t, std::vector<T*>& from, std::vector<T*>& to) {
+  typename std::vector<T*>::iterator i = std::find(from.begin(), from.end(), t);
+  if (i != from.end()) {
+    from.erase(i);
+    to.push_back(t);
+  }
+}
+
+/*
+ * Materials and lightings are matched by their fingerprints, which the rooms'
+ * fingerprints include; so every material or lighting of a room kept by a
+ * reload is taken over from the previous loader, and the rest are deleted
+ * along with it. The standard lighting and blank material are created on first
+ * use, so they are touched here, before any room can be built on another
+ * thread.
+ */
+void CompiledRoomLoader::initialize(CompiledRoomLoader* previous) {
+  CompiledWorldBuilder builder(compiled_, lightings_, materials_);
+  std::map<std::vector<char>, Lighting*> lightings;
+  std::map<std::vector<char>, Material*> materials;
+  std::vector<char> f;
+  if (previous != NULL) {
+    for (int i = 0; i < previous->compiled_.lightings(); i++) {
+      f.clear();
+      previous->fingerprintLighting(i, f);
+      lightings[f] = previous->lightings_[i];
+    }
+    for (int i = 0; i < previous->compiled_.materials(); i++) {
+      f.clear();
+      previous->fingerprintMaterial(i, f);
+      materials[f] = previous->materials_[i];
+    }
+  }
+  for (int i = 0; i < compiled_.lightings(); i++) {
+    f.clear();
+    fingerprintLighting(i, f);
+    Lighting*& l = lightings[f];
+    if (l == NULL) {
+      l = builder.buildLighting(compiled_.lighting(i));
+      ownedLightings_.push_back(l);
+    } else if (previous != NULL) {
+      adopt(l, previous->ownedLightings_, ownedLightings_);
+    }
+    lightings_.push_back(l);
+  }
+  for (int i = 0; i < compiled_.materials(); i++) {
+    f.clear();
+    fingerprintMaterial(i, f);
+    Material*& m = materials[f];
+    if (m == NULL) {
+      m = builder.buildMaterial(compiled_.material(i));
+      ownedMaterials_.push_back(m);
+    } else if (previous != NULL) {
+      adopt(m, previous->ownedMaterials_, ownedMaterials_);
     }
+    materials_.push_back(m);
   }
-  parseRoomObjects(r, e);
+  Lightings::standard();
+  Materials::blank();
+  initializeGroups();
 }
 
-void XmlWorldBuilder::parseRoomObjects(Room* r, TiXmlElement* e) {
-  for (TiXmlElement* o = e->FirstChildElement(); o != NULL;
-       o = o->NextSiblingElement()) {
-    const std::string& name = o->ValueStr();
-    if (name == "constant-force") {
-      r->addForce(parseRoomConstantForce(o));
-    } else if (name == "rotation") {
-      parseRotation(r, o);
-    } else if (name == "translation") {
-      parseTranslation(r, o);
-    } else {
-      RoomObject* ro = parseRoomObject(o);
-      if (ro != NULL) { // ignore unknown objects
-        r->addObject(applyTransforms(ro));
+/* Rooms are grouped with the rooms of the transforms their switches target. */
+void CompiledRoomLoader::initializeGroups() {
+  std::vector<int> parents;
+  for (int i = 0; i < compiled_.rooms(); i++) {
+    parents.push_back(i);
+  }
+  for (int i = 0; i < compiled_.rooms(); i++) {
+    const CompiledRange& objects = compiled_.room(i).objects;
+    for (int j = objects.begin; j < objects.begin + objects.count; j++) {
+      const CompiledRange& targets = compiled_.object(j).targets;
+      for (int k = targets.begin; k < targets.begin + targets.count; k++) {
+        parents[findGroup(parents, compiled_.target(k).room)]
+            = findGroup(parents, i);
       }
     }
   }
+  groups_.resize(compiled_.rooms());
+  for (int i = 0; i < compiled_.rooms(); i++) {
+    groupIndexes_.push_back(findGroup(parents, i));
+    groups_[groupIndexes_.back()].push_back(i);
+  }
 }
 
-void XmlWorldBuilder::parseRotation(Room* r, TiXmlElement* e) {
-  float s = 10.f, a = 0.f;
-  e->QueryFloatAttribute("speed", &s);
-  e->QueryFloatAttribute("angle", &a);
-  Rotation* z = new Rotation(
-      parseVector(e->FirstChildElement("origin")),
-      parseVector(e->FirstChildElement("axis")),
-      s, a);
-  const char* name = e->Attribute("name");
-  if (name != NULL) {
-    transforms_[name] = z;
+int CompiledRoomLoader::rooms() const {
+  return compiled_.rooms();
+}
+
+void CompiledRoomLoader::group(int room, std::vector<int>& rooms) const {
+  rooms = groups_[groupIndexes_[room]];
+}
+
+/*
+ * The size of a room is estimated from the size of the objects built for it;
+ * this excludes the models' display lists and buffers.
+ */
+size_t CompiledRoomLoader::size(int room) const {
+  const CompiledRoom& c = compiled_.room(room);
+  size_t size = sizeof(Room)
+      + c.origins.count * sizeof(RoomOrigin)
+      + c.portals.count * sizeof(Portal)
+      + c.forces.count * sizeof(ConstantRoomForce);
+  for (int i = c.transforms.begin; i < c.transforms.begin + c.transforms.count;
+       i++) {
+    size += (compiled_.transform(i).type == CompiledTransform::TRANSLATION)
+        ? sizeof(Translation)
+        : sizeof(Rotation);
   }
-  activeTransforms_.push_back(z);
-  parseRoomObjects(r, e);
-  activeTransforms_.pop_back();
-  r->addTransform(z);
-}
-
-void XmlWorldBuilder::parseTranslation(Room* r, TiXmlElement* e) {
-  float s = 10.f, u = 0.f, kd = 0.f;
-  e->QueryFloatAttribute("speed", &s);
-  e->QueryFloatAttribute("start", &u);
-  e->QueryFloatAttribute("dampen", &kd);
-  Translation* z = new Translation(
-      parseVector(e->FirstChildElement("x0")),
-      parseVector(e->FirstChildElement("x1")),
-      s, u, kd);
-  const char* mode = e->Attribute("mode");
-  if (mode != NULL) {
-    std::string modeString = mode;
-    if (modeString == "one-way") {
-      z->setMode(Translation::ONE_WAY);
-    } else if (modeString == "reset") {
-      z->setMode(Translation::RESET);
+  for (int i = c.objects.begin; i < c.objects.begin + c.objects.count; i++) {
+    const CompiledObject& o = compiled_.object(i);
+    size += objectSize(o);
+    for (int j = o.transform; j != -1; j = compiled_.transform(j).parent) {
+      size += (compiled_.transform(j).type == CompiledTransform::TRANSLATION)
+          ? sizeof(TranslatingRoomObject)
+          : sizeof(RotatingRoomObject);
     }
   }
-  const char* name = e->Attribute("name");
-  if (name != NULL) {
-    transforms_[name] = z;
+  return size;
+}
+
+/*
+ * The group's transforms are built before any of its rooms, since switches may
+ * target transforms in other rooms of the group. A room's music is opened when
+ * the room is first built, rather than when the world is loaded.
+ */
+void CompiledRoomLoader::load(const std::vector<int>& rooms,
+    std::vector<Room*>& out) const {
+  CompiledWorldBuilder builder(compiled_, lightings_, materials_);
+  std::vector<int>::const_iterator i;
+  for (i = rooms.begin(); i != rooms.end(); i++) {
+    builder.buildTransforms(compiled_.room(*i));
+  }
+  for (i = rooms.begin(); i != rooms.end(); i++) {
+    Room* r = builder.buildRoom(compiled_.room(*i));
+    const char* music = compiled_.text(compiled_.room(*i).music);
+    if (music != NULL) {
+      r->setMusic(Sounds::fromFile(music));
+    }
+    out.push_back(r);
   }
-  activeTransforms_.push_back(z);
-  parseRoomObjects(r, e);
-  activeTransforms_.pop_back();
-  r->addTransform(z);
 }
 
-RoomObject* XmlWorldBuilder::applyTransforms(RoomObject* o) {
-  std::list<Transform*>::reverse_iterator i;
-  for (i = activeTransforms_.rbegin(); i != activeTransforms_.rend(); i++) {
-    Transform* z = *i;
-    Translation* t = dynamic_cast<Translation*>(z);
-    if (t != NULL) {
-      o = new TranslatingRoomObject(o, *t);
-      continue;
+template <class T>
+static void appendRecord(const T& r, std::vector<char>& out) {
+  const char* p = (const char*) &r;
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+/*
+ * The records are fingerprinted as is, except that strings, lightings and
+ * materials are replaced by their contents, and indexes of transforms by
+ * indexes within their room, so that editing one room doesn't change the
+ * fingerprint of the others. Every field of every record is initialized by
+ * the compiler, so records that compare equal field by field also do so byte
+ * by byte.
+ */
+void CompiledRoomLoader::fingerprint(int room, std::vector<char>& out) const {
+  const CompiledRoom& c = compiled_.room(room);
+  CompiledRoom r = c;
+  r.name = r.lighting = r.music = -1;
+  r.origins.begin = r.portals.begin = r.forces.begin = 0;
+  r.transforms.begin = r.objects.begin = 0;
+  appendRecord(r, out);
+  fingerprintText(c.name, out);
+  fingerprintText(c.music, out);
+  fingerprintLighting(c.lighting, out);
+  for (int i = c.origins.begin; i < c.origins.begin + c.origins.count; i++) {
+    CompiledOrigin o = compiled_.origin(i);
+    o.name = -1;
+    appendRecord(o, out);
+    fingerprintText(compiled_.origin(i).name, out);
+  }
+  for (int i = c.portals.begin; i < c.portals.begin + c.portals.count; i++) {
+    appendRecord(compiled_.portal(i), out);
+  }
+  for (int i = c.forces.begin; i < c.forces.begin + c.forces.count; i++) {
+    appendRecord(compiled_.force(i), out);
+  }
+  for (int i = c.transforms.begin; i < c.transforms.begin + c.transforms.count;
+       i++) {
+    CompiledTransform z = compiled_.transform(i);
+    if (z.parent != -1) {
+      z.parent -= c.transforms.begin;
     }
-    Rotation* r = dynamic_cast<Rotation*>(z);
-    if (r != NULL) {
-      o = new RotatingRoomObject(o, *r);
-      continue;
+    z.name = -1;
+    appendRecord(z, out);
+    fingerprintText(compiled_.transform(i).name, out);
+  }
+  for (int i = c.objects.begin; i < c.objects.begin + c.objects.count; i++) {
+    const CompiledObject& o = compiled_.object(i);
+    CompiledObject f = o;
+    if (f.transform != -1) {
+      f.transform -= c.transforms.begin;
+    }
+    f.material = f.topMaterial = f.activeMaterial = -1;
+    f.targets.begin = 0;
+    appendRecord(f, out);
+    fingerprintMaterial(o.material, out);
+    fingerprintMaterial(o.topMaterial, out);
+    fingerprintMaterial(o.activeMaterial, out);
+    for (int j = o.targets.begin; j < o.targets.begin + o.targets.count; j++) {
+      CompiledTarget t = compiled_.target(j);
+      t.transform -= compiled_.room(t.room).transforms.begin;
+      appendRecord(t, out);
     }
   }
-  return o;
 }
 
-RoomOrigin* XmlWorldBuilder::parseRoomOrigin(TiXmlElement* e) {
-  return new RoomOrigin(
-      parseVector(e->FirstChildElement("position")),
-      parseVector(e->FirstChildElement("velocity")));
-}
-
-Portal* XmlWorldBuilder::parseRoomPortal(TiXmlElement* e) {
-  return new Portal(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")),
-      findRoom(e->Attribute("origin")),
-      findRoomOrigin(e->Attribute("origin")),
-      parseBool(e, "reset", false));
-}
-
-RoomObject* XmlWorldBuilder::parseRoomObject(TiXmlElement* e) {
-  const std::string& name = e->ValueStr();
-  if (name == "block") {
-    return parseRoomBlock(e);
-  } else if (name == "wall") {
-    return parseRoomWall(e);
-  } else if (name == "escalator") {
-    return parseRoomEscalator(e);
-  } else if (name == "seesaw") {
-    return parseRoomSeesaw(e);
-  } else if (name == "ramp") {
-    return parseRoomRamp(e);
-  } else if (name == "tube") {
-    return parseRoomTube(e);
-  } else if (name == "ball") {
-    return parseRoomBall(e);
-  } else if (name == "fan") {
-    return parseRoomFan(e);
-  } else if (name == "switch") {
-    return parseRoomSwitch(e);
-  }
-  return NULL;
-}
-
-RoomObject* XmlWorldBuilder::parseRoomBlock(TiXmlElement* e) {
-  return (e->FirstChildElement("min") != NULL)
-      ? parseRoomAxisAlignedBlock(e)
-      : parseRoomOrientedBlock(e);
-}
-
-RoomObject* XmlWorldBuilder::parseRoomAxisAlignedBlock(TiXmlElement* e) {
-  AxisAlignedBlock* b = new AxisAlignedBlock(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")));
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    b->setMaterial(*materials_[material]);
+/* Absent strings are distinguished from empty ones. */
+void CompiledRoomLoader::fingerprintText(int offset,
+    std::vector<char>& out) const {
+  const char* s = compiled_.text(offset);
+  out.push_back(s != NULL);
+  if (s != NULL) {
+    out.insert(out.end(), s, s + strlen(s) + 1);
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    b->setTopMaterial(*materials_[topMaterial]);
+}
+
+void CompiledRoomLoader::fingerprintLighting(int lighting,
+    std::vector<char>& out) const {
+  out.push_back(lighting != -1);
+  if (lighting != -1) {
+    const CompiledLighting& c = compiled_.lighting(lighting);
+    CompiledLighting l = c;
+    l.lights.begin = 0;
+    appendRecord(l, out);
+    for (int i = c.lights.begin; i < c.lights.begin + c.lights.count; i++) {
+      appendRecord(compiled_.light(i), out);
+    }
   }
-  return b;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomOrientedBlock(TiXmlElement* e) {
-  Block* b = new Block(
-      parseVector(e->FirstChildElement("c")),
-      parseVector(e->FirstChildElement("x")),
-      parseVector(e->FirstChildElement("y")),
-      parseVector(e->FirstChildElement("z")));
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    b->setMaterial(*materials_[material]);
+void CompiledRoomLoader::fingerprintMaterial(int material,
+    std::vector<char>& out) const {
+  out.push_back(material != -1);
+  if (material != -1) {
+    CompiledMaterial m = compiled_.material(material);
+    m.texture = -1;
+    appendRecord(m, out);
+    fingerprintText(compiled_.material(material).texture, out);
+  }
+}
+
+CompiledWorldBuilder::CompiledWorldBuilder(const CompiledWorld& compiled,
+    const std::vector<Lighting*>& lightings,
+    const std::vector<Material*>& materials)
+    : compiled_(compiled), lightings_(lightings), materials_(materials) {
+}
+
+Lighting* CompiledWorldBuilder::buildLighting(const CompiledLighting& c) {
+  Lighting* l = new Lighting();
+  if (c.flags & CompiledLighting::GLOBAL_AMBIENT) {
+    const float* a = c.globalAmbient;
+    l->setGlobalAmbient(a[0], a[1], a[2], a[3]);
+  }
+  for (int i = 0; (i < c.lights.count) && (i < l->lights()); i++) {
+    buildLight(l->light(i), compiled_.light(c.lights.begin + i));
+  }
+  return l;
+}
+
+void CompiledWorldBuilder::buildLight(Light& l, const CompiledLight& c) {
+  if (c.flags & CompiledLight::AMBIENT) {
+    l.setAmbient(c.ambient[0], c.ambient[1], c.ambient[2], c.ambient[3]);
+  }
+  if (c.flags & CompiledLight::SPECULAR) {
+    l.setSpecular(c.specular[0], c.specular[1], c.specular[2], c.specular[3]);
+  }
+  if (c.flags & CompiledLight::DIFFUSE) {
+    l.setDiffuse(c.diffuse[0], c.diffuse[1], c.diffuse[2], c.diffuse[3]);
+  }
+  if (c.flags & CompiledLight::POSITION) {
+    l.setPosition(c.position[0], c.position[1], c.position[2],
+        c.position[3]);
+  }
+  if (c.flags & CompiledLight::SPOT_DIRECTION) {
+    l.setSpotDirection(c.spotDirection[0], c.spotDirection[1],
+        c.spotDirection[2]);
+  }
+  if (c.flags & CompiledLight::SPOT_EXPONENT) {
+    l.setSpotExponent(c.spotExponent);
+  }
+  if (c.flags & CompiledLight::CONSTANT_ATTENUATION) {
+    l.setConstantAttenuation(c.constantAttenuation);
+  }
+  if (c.flags & CompiledLight::LINEAR_ATTENUATION) {
+    l.setLinearAttenuation(c.linearAttenuation);
+  }
+  if (c.flags & CompiledLight::QUADRATIC_ATTENUATION) {
+    l.setQuadraticAttenuation(c.quadraticAttenuation);
+  }
+  l.enable();
+}
+
+Material* CompiledWorldBuilder::buildMaterial(const CompiledMaterial& c) {
+  Material* m = new Material();
+  m->setSlipAngle(c.slipAngle);
+  if (c.flags & CompiledMaterial::AMBIENT) {
+    m->setAmbient(c.ambient[0], c.ambient[1], c.ambient[2], c.ambient[3]);
+  }
+  if (c.flags & CompiledMaterial::DIFFUSE) {
+    m->setDiffuse(c.diffuse[0], c.diffuse[1], c.diffuse[2], c.diffuse[3]);
+  }
+  if (c.flags & CompiledMaterial::EMISSION) {
+    m->setEmission(c.emission[0], c.emission[1], c.emission[2],
+        c.emission[3]);
+  }
+  if (c.flags & CompiledMaterial::SPECULAR) {
+    m->setSpecular(c.specular[0], c.specular[1], c.specular[2],
+        c.specular[3]);
+  }
+  const char* texture = compiled_.text(c.texture);
+  if (texture != NULL) {
+    m->setTexture(texture);
+  }
+  return m;
+}
+
+void CompiledWorldBuilder::buildTransforms(const CompiledRoom& c) {
+  for (int i = c.transforms.begin; i < c.transforms.begin + c.transforms.count;
+       i++) {
+    transforms_[i] = buildTransform(compiled_.transform(i));
+  }
+}
+
+Transform* CompiledWorldBuilder::buildTransform(const CompiledTransform& c) {
+  if (c.type == CompiledTransform::ROTATION) {
+    return new Rotation(c.x0, c.x1, c.speed, c.start);
+  }
+  Translation* t = new Translation(c.x0, c.x1, c.speed, c.start, c.dampen);
+  t->setMode((Translation::Mode) c.mode);
+  return t;
+}
+
+Room* CompiledWorldBuilder::buildRoom(const CompiledRoom& c) {
+  Room* r = new Room();
+  if (c.lighting >= 0) {
+    r->setLighting(*lightings_[c.lighting]);
+  }
+  r->setCameraBounds(c.cameraMin, c.cameraMax);
+  for (int i = 0; i < c.origins.count; i++) {
+    const CompiledOrigin& o = compiled_.origin(c.origins.begin + i);
+    r->addOrigin(new RoomOrigin(o.position, o.velocity));
+  }
+  for (int i = 0; i < c.portals.count; i++) {
+    const CompiledPortal& p = compiled_.portal(c.portals.begin + i);
+    r->addPortal(new Portal(p.min, p.max, p.room, p.origin, p.reset != 0));
+  }
+  for (int i = 0; i < c.forces.count; i++) {
+    const CompiledForce& f = compiled_.force(c.forces.begin + i);
+    r->addForce(new ConstantRoomForce(f.min, f.max, f.force));
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    b->setTopMaterial(*materials_[topMaterial]);
+  for (int i = 0; i < c.objects.count; i++) {
+    const CompiledObject& o = compiled_.object(c.objects.begin + i);
+    r->addObject(applyTransforms(buildRoomObject(o), o.transform));
+  }
+  for (int i = 0; i < c.transforms.count; i++) {
+    r->addTransform(transforms_[c.transforms.begin + i]);
+  }
+  return r;
+}
+
+RoomObject* CompiledWorldBuilder::buildRoomObject(const CompiledObject& c) {
+  switch (c.type) {
+    case CompiledObject::AXIS_ALIGNED_BLOCK:
+      return buildRoomAxisAlignedBlock(c);
+    case CompiledObject::BLOCK: return buildRoomOrientedBlock(c);
+    case CompiledObject::QUAD_WALL: return buildRoomQuadWall(c);
+    case CompiledObject::TRI_WALL: return buildRoomTriWall(c);
+    case CompiledObject::ESCALATOR: return buildRoomEscalator(c);
+    case CompiledObject::SEESAW: return buildRoomSeesaw(c);
+    case CompiledObject::RAMP: return buildRoomRamp(c);
+    case CompiledObject::TUBE: return buildRoomTube(c);
+    case CompiledObject::BALL: return buildRoomBall(c);
+    case CompiledObject::FAN: return buildRoomFan(c);
+  }
+  return buildRoomSwitch(c);
+}
+
+RoomObject* CompiledWorldBuilder::buildRoomAxisAlignedBlock(
+    const CompiledObject& c) {
+  AxisAlignedBlock* b = new AxisAlignedBlock(c.x[0], c.x[1]);
+  if (c.material >= 0) {
+    b->setMaterial(*materials_[c.material]);
+  }
+  if (c.topMaterial >= 0) {
+    b->setTopMaterial(*materials_[c.topMaterial]);
   }
   return b;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomWall(TiXmlElement* e) {
-  return (e->FirstChildElement("x3") == NULL)
-      ? parseRoomTriWall(e)
-      : parseRoomQuadWall(e);
+RoomObject* CompiledWorldBuilder::buildRoomOrientedBlock(
+    const CompiledObject& c) {
+  Block* b = new Block(c.x[0], c.x[1], c.x[2], c.x[3]);
+  if (c.material >= 0) {
+    b->setMaterial(*materials_[c.material]);
+  }
+  if (c.topMaterial >= 0) {
+    b->setTopMaterial(*materials_[c.topMaterial]);
+  }
+  return b;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomQuadWall(TiXmlElement* e) {
-  Wall* w = new Wall(
-      parseVector(e->FirstChildElement("x0")),
-      parseVector(e->FirstChildElement("x1")),
-      parseVector(e->FirstChildElement("x2")),
-      parseVector(e->FirstChildElement("x3")));
-  TiXmlElement* t = e->FirstChildElement("tex-coords");
-  if (t != NULL) {
-    w->setTexCoords(
-        parseVector(t->FirstChildElement("t0")),
-        parseVector(t->FirstChildElement("t1")),
-        parseVector(t->FirstChildElement("t2")),
-        parseVector(t->FirstChildElement("t3")));
+RoomObject* CompiledWorldBuilder::buildRoomQuadWall(const CompiledObject& c) {
+  Wall* w = new Wall(c.x[0], c.x[1], c.x[2], c.x[3]);
+  if (c.texCoords) {
+    w->setTexCoords(c.t[0], c.t[1], c.t[2], c.t[3]);
   }
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    w->setMaterial(*materials_[material]);
+  if (c.material >= 0) {
+    w->setMaterial(*materials_[c.material]);
   }
   return w;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomTriWall(TiXmlElement* e) {
-  TriWall* w = new TriWall(
-      parseVector(e->FirstChildElement("x0")),
-      parseVector(e->FirstChildElement("x1")),
-      parseVector(e->FirstChildElement("x2")));
-  TiXmlElement* t = e->FirstChildElement("tex-coords");
-  if (t != NULL) {
-    w->setTexCoords(
-        parseVector(t->FirstChildElement("t0")),
-        parseVector(t->FirstChildElement("t1")),
-        parseVector(t->FirstChildElement("t2")));
+RoomObject* CompiledWorldBuilder::buildRoomTriWall(const CompiledObject& c) {
+  TriWall* w = new TriWall(c.x[0], c.x[1], c.x[2]);
+  if (c.texCoords) {
+    w->setTexCoords(c.t[0], c.t[1], c.t[2]);
   }
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    w->setMaterial(*materials_[material]);
+  if (c.material >= 0) {
+    w->setMaterial(*materials_[c.material]);
   }
   return w;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomEscalator(TiXmlElement* e) {
-  Escalator* o = new Escalator(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")),
-      parseVector(e->FirstChildElement("v")));
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    o->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomEscalator(const CompiledObject& c) {
+  Escalator* o = new Escalator(c.x[0], c.x[1], c.x[2]);
+  if (c.material >= 0) {
+    o->setMaterial(*materials_[c.material]);
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    o->setTopMaterial(*materials_[topMaterial]);
+  if (c.topMaterial >= 0) {
+    o->setTopMaterial(*materials_[c.topMaterial]);
   }
   return o;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomSeesaw(TiXmlElement* e) {
-  float mass = 1.f;
-  e->QueryFloatAttribute("mass", &mass);
-  Seesaw* s = new Seesaw(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")),
-      mass);
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    s->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomSeesaw(const CompiledObject& c) {
+  Seesaw* s = new Seesaw(c.x[0], c.x[1], c.mass);
+  if (c.material >= 0) {
+    s->setMaterial(*materials_[c.material]);
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    s->setTopMaterial(*materials_[topMaterial]);
+  if (c.topMaterial >= 0) {
+    s->setTopMaterial(*materials_[c.topMaterial]);
   }
   return s;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomRamp(TiXmlElement* e) {
-  Ramp* r = new Ramp(
-      parseVector(e->FirstChildElement("x0")),
-      parseVector(e->FirstChildElement("x1")),
-      parseVector(e->FirstChildElement("x2")),
-      parseVector(e->FirstChildElement("x3")));
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    r->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomRamp(const CompiledObject& c) {
+  Ramp* r = new Ramp(c.x[0], c.x[1], c.x[2], c.x[3]);
+  if (c.material >= 0) {
+    r->setMaterial(*materials_[c.material]);
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    r->setTopMaterial(*materials_[topMaterial]);
+  if (c.topMaterial >= 0) {
+    r->setTopMaterial(*materials_[c.topMaterial]);
   }
   return r;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomTube(TiXmlElement* e) {
-  float r = 1.f;
-  e->QueryFloatAttribute("radius", &r);
-  Tube* t = new Tube(
-      parseVector(e->FirstChildElement("x0")),
-      parseVector(e->FirstChildElement("x1")),
-      parseVector(e->FirstChildElement("y"), Vector::Y()),
-      r);
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    t->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomTube(const CompiledObject& c) {
+  Tube* t = new Tube(c.x[0], c.x[1], c.x[2], c.radius);
+  if (c.material >= 0) {
+    t->setMaterial(*materials_[c.material]);
   }
-  const char* capMaterial = e->Attribute("cap-material");
-  if (capMaterial != NULL) {
-    t->setCapMaterial(*materials_[capMaterial]);
+  if (c.topMaterial >= 0) {
+    t->setCapMaterial(*materials_[c.topMaterial]);
   }
   return t;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomBall(TiXmlElement* e) {
-  float r = 1.f;
-  e->QueryFloatAttribute("radius", &r);
-  Ball* b = new Ball(parseVector(e->FirstChildElement("x")), r);
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    b->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomBall(const CompiledObject& c) {
+  Ball* b = new Ball(c.x[0], c.radius);
+  if (c.material >= 0) {
+    b->setMaterial(*materials_[c.material]);
   }
   return b;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomFan(TiXmlElement* e) {
-  float r, s;
-  e->QueryFloatAttribute("radius", &r);
-  e->QueryFloatAttribute("speed", &s);
-  Fan* f = new Fan(
-      parseVector(e->FirstChildElement("x")),
-      parseVector(e->FirstChildElement("v")),
-      r, s);
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    f->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomFan(const CompiledObject& c) {
+  Fan* f = new Fan(c.x[0], c.x[1], c.radius, c.speed);
+  if (c.material >= 0) {
+    f->setMaterial(*materials_[c.material]);
   }
   return f;
 }
 
-RoomObject* XmlWorldBuilder::parseRoomSwitch(TiXmlElement* e) {
-  Switch* b = new Switch(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")));
-  const char* material = e->Attribute("material");
-  if (material != NULL) {
-    b->setMaterial(*materials_[material]);
+RoomObject* CompiledWorldBuilder::buildRoomSwitch(const CompiledObject& c) {
+  Switch* s = new Switch(c.x[0], c.x[1]);
+  if (c.material >= 0) {
+    s->setMaterial(*materials_[c.material]);
   }
-  const char* topMaterial = e->Attribute("top-material");
-  if (topMaterial != NULL) {
-    b->setTopMaterial(*materials_[topMaterial]);
+  if (c.topMaterial >= 0) {
+    s->setTopMaterial(*materials_[c.topMaterial]);
   }
-  const char* activeMaterial = e->Attribute("active-material");
-  if (activeMaterial != NULL) {
-    b->setActiveMaterial(*materials_[activeMaterial]);
+  if (c.activeMaterial >= 0) {
+    s->setActiveMaterial(*materials_[c.activeMaterial]);
   }
-  parseRoomSwitchTargets(b, e);
-  return b;
-}
-
-void XmlWorldBuilder::parseRoomSwitchTargets(Switch* s, TiXmlElement* e) {
-  SwitchTargets* q = new SwitchTargets(s);
-  for (TiXmlElement* t = e->FirstChildElement("target"); t != NULL;
-       t = t->NextSiblingElement("target")) {
-    q->addTarget(t->Attribute("name"));
+  for (int i = 0; i < c.targets.count; i++) {
+    s->addTarget(*transforms_[compiled_.target(c.targets.begin + i).transform]);
   }
-  switchTargets_.push_back(q);
+  return s;
 }
 
-void XmlWorldBuilder::resolveSwitchTargets() {
-  std::vector<SwitchTargets*>::const_iterator i;
-  for (i = switchTargets_.begin(); i != switchTargets_.end(); i++) {
-    SwitchTargets* t = *i;
-    Switch* s = t->svitch();
-    std::vector<std::string>::const_iterator is;
-    for (is = t->targets().begin(); is != t->targets().end(); is++) {
-      s->addTarget(*transforms_[*is]);
+/* Wraps the object in its transforms, from the innermost outwards. */
+RoomObject* CompiledWorldBuilder::applyTransforms(RoomObject* o,
+    int transform) {
+  for (int i = transform; i != -1; i = compiled_.transform(i).parent) {
+    if (compiled_.transform(i).type == CompiledTransform::TRANSLATION) {
+      o = new TranslatingRoomObject(o, *(Translation*) transforms_[i]);
+    } else {
+      o = new RotatingRoomObject(o, *(Rotation*) transforms_[i]);
     }
   }
-  switchTargets_.clear();
-}
-
-RoomForce* XmlWorldBuilder::parseRoomConstantForce(TiXmlElement* e) {
-  return new ConstantRoomForce(
-      parseVector(e->FirstChildElement("min")),
-      parseVector(e->FirstChildElement("max")),
-      parseVector(e->FirstChildElement("force")));
+  return o;
 }
 
-int XmlWorldBuilder::findRoom(const char* name) {
-  int i = 0;
-  std::string s = name;
-  std::string roomName = s.substr(0, s.find('.'));
-  TiXmlElement* e = document_.FirstChildElement("world");
-  for (TiXmlElement* r = e->FirstChildElement("room"); r != NULL;
-       r = r->NextSiblingElement("room"), i++) {
-    const char* t = r->Attribute("name");
-    if ((t != NULL) && (roomName == t)) {
-      return i;
-    }
+/*
+ * The compiled world stays open (or mapped) for as long as the world, since
+ * rooms are built from it on demand.
+ */
+World* Worlds::fromFile(const char* path) {
+  Resource resource;
+  if (!resource.open(path)) {
+    std::cerr << "Error loading world \"" << path << "\": could not open\n";
+    return NULL;
   }
-  std::cerr << "Error: could not find room " << name << "\n";
-  return -1;
-}
-
-int XmlWorldBuilder::findRoomOrigin(const char* name) {
-  std::string s = name;
-  int i = s.find('.');
-  std::string roomName = s.substr(0, i);
-  std::string originName = s.substr(i + 1);
-  TiXmlElement* e = document_.FirstChildElement("world");
-  for (TiXmlElement* r = e->FirstChildElement("room"); r != NULL;
-       r = r->NextSiblingElement("room")) {
-    const char* t = r->Attribute("name");
-    if ((t != NULL) && (roomName == t)) {
-      int j = 0;
-      for (TiXmlElement* o = r->FirstChildElement("origin"); o != NULL;
-           o = o->NextSiblingElement("origin"), j++) {
-        const char* u = o->Attribute("name");
-        if ((u != NULL) && (originName == u)) {
-          return j;
-        }
-      }
-      std::cerr << "Error: could not find origin " << roomName << "."
-                << originName << "\n";
-      return -1;
+  CompiledRoomLoader* loader = new CompiledRoomLoader();
+  CompiledWorld& compiled = loader->compiled();
+  if (CompiledWorld::isCompiled(resource.data(), resource.length())) {
+    if (!compiled.open(resource)) {
+      std::cerr << "Error loading world \"" << path << "\": invalid\n";
+      delete loader;
+      return NULL;
+    }
+  } else {
+    CompiledWorldWriter writer;
+    XmlWorldCompiler compiler(writer);
+    std::vector<char> data;
+    if (!compiler.compile(path, resource.data(), resource.length())) {
+      delete loader;
+      return NULL;
+    }
+    writer.write(data);
+    if (!compiled.open(data)) {
+      delete loader;
+      return NULL;
     }
   }
-  std::cerr << "Error: could not find room " << roomName << "\n";
-  return -1;
+  World* world = new World();
+  loader->initialize(NULL);
+  world->setLoader(loader);
+  return world;
 }
 
-Vector XmlWorldBuilder::parseVector(TiXmlElement* e, const Vector& d) {
-  return (e == NULL) ? d : parseVector(e);
-}
-
-Vector XmlWorldBuilder::parseVector(TiXmlElement* e) {
-  Vector v;
-  e->QueryFloatAttribute("x", &v.x);
-  e->QueryFloatAttribute("y", &v.y);
-  e->QueryFloatAttribute("z", &v.z);
-  return v;
+bool Worlds::compile(const char* path, std::vector<char>& out) {
+  CompiledWorldWriter writer;
+  XmlWorldCompiler compiler(writer);
+  if (!compiler.compile(path)) {
+    return false;
+  }
+  writer.write(out);
+  return true;
 }
 
-bool XmlWorldBuilder::parseBool(TiXmlElement* e, const char* name) {
-  static const std::string TRUE = "true";
-  return TRUE == e->Attribute(name);
+/*
+ * The XML is compiled, and the new materials and lightings built, before the
+ * simulation is locked out, so that the simulation only pauses while the
+ * changed rooms are swapped in. Rooms that didn't change keep their materials
+ * and lightings, which the new loader takes over from the old; the old loader
+ * deletes the rest once the rooms it built are gone.
+ */
+bool Worlds::reload(World& world, const char* path,
+    std::vector<int>& changed) {
+  CompiledRoomLoader* loader = new CompiledRoomLoader();
+  std::vector<char> data;
+  if (!compile(path, data) || !loader->compiled().open(data)) {
+    delete loader;
+    return false;
+  }
+  loader->initialize((CompiledRoomLoader*) world.rooms().loader());
+  world.lock();
+  world.reload(loader, changed);
+  world.unlock();
+  return true;
 }
 
-bool XmlWorldBuilder::parseBool(TiXmlElement* e, const char* name, bool d) {
-  const char* value = e->Attribute(name);
-  if (value == NULL) {
-    return d;
+WorldWatcher::WorldWatcher(World& world, const char* path)
+    : world_(world), path_(path), modified_(0), size_(0), checkedMs_(0) {
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    modified_ = st.st_mtime;
+    size_ = st.st_size;
   }
-  static const std::string TRUE = "true";
-  return TRUE == value;
 }
 
-World* Worlds::fromFile(const char* path) {
-  XmlWorldBuilder builder;
-  return builder.parseWorld(path);
+/*
+ * The file is compared by its modification time and size, as the time may
+ * only have a resolution of seconds. A file that fails to compile (as when
+ * saved partway) is reported, and tried again when next modified.
+ */
+void WorldWatcher::poll() {
+  uint32_t now = SDL_GetTicks();
+  if (now - checkedMs_ < defaultIntervalMs) {
+    return;
+  }
+  checkedMs_ = now;
+  struct stat st;
+  if ((stat(path_.c_str(), &st) != 0)
+      || ((st.st_mtime == modified_) && (st.st_size == size_))) {
+    return;
+  }
+  modified_ = st.st_mtime;
+  size_ = st.st_size;
+  std::vector<int> changed;
+  if (Worlds::reload(world_, path_.c_str(), changed)) {
+    std::cout << "Reloaded world \"" << path_ << "\": " << changed.size()
+        << " of " << world_.rooms().size() << " rooms changed, "
+        << (SDL_GetTicks() - now) << " ms\n";
+  }
 }
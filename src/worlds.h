@@ -3,18 +3,66 @@
 #ifndef MBOSTOCK_WORLDS_H
 #define MBOSTOCK_WORLDS_H
 
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+#include <vector>
+
 namespace mbostock {
 
   class World;
 
   class Worlds {
   public:
+    /**
+     * Loads the world at the specified path, relative to the resources. The
+     * world may be compiled (see CompiledWorld), in which case it is read in
+     * place, or XML, in which case it is compiled first.
+     */
     static World* fromFile(const char* path);
 
+    /** Compiles the XML world at the specified path; returns false on error. */
+    static bool compile(const char* path, std::vector<char>& out);
+
+    /**
+     * Compiles the XML world at the specified path, and reloads the world
+     * from it (see World::reload), appending the indexes of the rooms that
+     * changed; returns false on error, leaving the world as it was. Call this
+     * from the main thread, as the world's materials are created here.
+     */
+    static bool reload(World& world, const char* path,
+        std::vector<int>& changed);
+
   private:
     Worlds();
   };
 
+  /**
+   * Watches the XML file of a world, at a path on disk (not a resource), and
+   * reloads the world when the file is modified, for editing rooms without
+   * restarting the game.
+   */
+  class WorldWatcher {
+  public:
+    WorldWatcher(World& world, const char* path);
+
+    static const uint32_t defaultIntervalMs = 250;
+
+    /**
+     * Reloads the world if the file was modified since it was last checked;
+     * the file is checked at most once per interval.
+     */
+    void poll();
+
+  private:
+    World& world_;
+    std::string path_;
+    time_t modified_;
+    off_t size_;
+    uint32_t checkedMs_;
+  };
+
 }
 
 #endif
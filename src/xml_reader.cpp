@@ -0,0 +1,322 @@
+// -*- C++ -*-
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xml_reader.h"
+
+using namespace mbostock;
+
+static bool isSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+static bool isNameEnd(char c) {
+  return isSpace(c) || (c == '/') || (c == '>') || (c == '=');
+}
+
+static const char* nameEnd(const char* p, const char* end) {
+  while ((p < end) && !isNameEnd(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/* Appends the character with the specified code point, in UTF-8. */
+static void appendCode(std::vector<char>& out, unsigned long c) {
+  if (c < 0x80) {
+    out.push_back(c);
+  } else if (c < 0x800) {
+    out.push_back(0xc0 | (c >> 6));
+    out.push_back(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    out.push_back(0xe0 | (c >> 12));
+    out.push_back(0x80 | ((c >> 6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  } else {
+    out.push_back(0xf0 | (c >> 18));
+    out.push_back(0x80 | ((c >> 12) & 0x3f));
+    out.push_back(0x80 | ((c >> 6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  }
+}
+
+/*
+ * Appends the value with its entities decoded. Unknown entities are kept as
+ * is, as is an ampersand that doesn't start an entity.
+ */
+static void appendDecoded(std::vector<char>& out, const char* p,
+    const char* end) {
+  static const char* const names[] = {
+    "lt;", "gt;", "amp;", "quot;", "apos;"
+  };
+  static const char values[] = { '<', '>', '&', '"', '\'' };
+  while (p < end) {
+    if (*p != '&') {
+      out.push_back(*p++);
+      continue;
+    }
+    const char* semicolon = (const char*) memchr(p, ';', end - p);
+    if (semicolon != NULL) {
+      if ((p + 1 < semicolon) && (p[1] == '#')) {
+        char* e;
+        unsigned long c = (p[2] == 'x')
+            ? strtoul(p + 3, &e, 16)
+            : strtoul(p + 2, &e, 10);
+        if ((e == semicolon) && (c > 0) && (c <= 0x10ffff)) {
+          appendCode(out, c);
+          p = semicolon + 1;
+          continue;
+        }
+      } else {
+        int i;
+        for (i = 0; i < 5; i++) {
+          size_t n = strlen(names[i]);
+          if ((size_t) (end - p - 1) >= n
+              && (strncmp(p + 1, names[i], n) == 0)) {
+            break;
+          }
+        }
+        if (i < 5) {
+          out.push_back(values[i]);
+          p += strlen(names[i]) + 1;
+          continue;
+        }
+      }
+    }
+    out.push_back(*p++);
+  }
+}
+
+void XmlElement::clear() {
+  text_.clear();
+  attributes_.clear();
+}
+
+void XmlElement::setName(const char* begin, const char* end) {
+  text_.insert(text_.end(), begin, end);
+  text_.push_back('\0');
+}
+
+void XmlElement::addAttribute(const char* name, const char* nameEnd,
+    const char* value, const char* valueEnd) {
+  attributes_.push_back(text_.size());
+  text_.insert(text_.end(), name, nameEnd);
+  text_.push_back('\0');
+  attributes_.push_back(text_.size());
+  appendDecoded(text_, value, valueEnd);
+  text_.push_back('\0');
+}
+
+const char* XmlElement::attribute(const char* name) const {
+  for (int i = 0; i < (int) attributes_.size(); i += 2) {
+    if (strcmp(&text_[attributes_[i]], name) == 0) {
+      return &text_[attributes_[i + 1]];
+    }
+  }
+  return NULL;
+}
+
+bool XmlElement::queryFloat(const char* name, float* value) const {
+  const char* s = attribute(name);
+  if (s == NULL) {
+    return false;
+  }
+  char* end;
+  double d = strtod(s, &end);
+  if (end == s) {
+    return false;
+  }
+  *value = (float) d;
+  return true;
+}
+
+XmlHandler::~XmlHandler() {
+}
+
+XmlReader::XmlReader()
+    : data_(NULL), p_(NULL), end_(NULL) {
+}
+
+bool XmlReader::readFile(const char* path, XmlHandler& handler) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    error_ = "could not open file";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    error_ = "could not open file";
+    return false;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return read(NULL, 0, handler);
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    error_ = "could not map file";
+    return false;
+  }
+  bool ok = read((const char*) data, st.st_size, handler);
+  munmap(data, st.st_size);
+  return ok;
+}
+
+bool XmlReader::read(const char* data, size_t length, XmlHandler& handler) {
+  data_ = p_ = data;
+  end_ = data + length;
+  open_.clear();
+  error_.clear();
+  while (true) {
+    const char* p = (p_ < end_)
+        ? (const char*) memchr(p_, '<', end_ - p_)
+        : NULL;
+    if (p == NULL) {
+      break;
+    }
+    p_ = p + 1;
+    bool ok;
+    if ((p_ < end_) && (*p_ == '/')) {
+      p_++;
+      ok = readEndElement(handler);
+    } else if ((p_ < end_) && (*p_ == '?')) {
+      ok = skip("?>");
+    } else if ((end_ - p_ >= 3) && (strncmp(p_, "!--", 3) == 0)) {
+      ok = skip("-->");
+    } else if ((end_ - p_ >= 8) && (strncmp(p_, "![CDATA[", 8) == 0)) {
+      ok = skip("]]>");
+    } else if ((p_ < end_) && (*p_ == '!')) {
+      ok = skip(">");
+    } else {
+      ok = readElement(handler);
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  if (!open_.empty()) {
+    p_ = end_;
+    return fail("unclosed element");
+  }
+  return true;
+}
+
+/* Reads a start tag (and, if empty, its end), following the '<'. */
+bool XmlReader::readElement(XmlHandler& handler) {
+  const char* name = p_;
+  const char* end = readName();
+  if (end == name) {
+    return fail("expected element name");
+  }
+  element_.clear();
+  element_.setName(name, end);
+  while (true) {
+    skipSpace();
+    if (p_ >= end_) {
+      return fail("unterminated element");
+    }
+    if (*p_ == '>') {
+      p_++;
+      open_.push_back(name);
+      handler.startElement(element_);
+      return true;
+    }
+    if (*p_ == '/') {
+      if ((p_ + 1 >= end_) || (p_[1] != '>')) {
+        return fail("expected '>'");
+      }
+      p_ += 2;
+      handler.startElement(element_);
+      handler.endElement();
+      return true;
+    }
+    const char* attribute = p_;
+    const char* attributeEnd = readName();
+    if (attributeEnd == attribute) {
+      return fail("expected attribute name");
+    }
+    skipSpace();
+    if ((p_ >= end_) || (*p_ != '=')) {
+      return fail("expected '='");
+    }
+    p_++;
+    skipSpace();
+    if ((p_ >= end_) || ((*p_ != '"') && (*p_ != '\''))) {
+      return fail("expected quoted value");
+    }
+    const char* value = p_ + 1;
+    const char* valueEnd = (const char*) memchr(value, *p_, end_ - value);
+    if (valueEnd == NULL) {
+      return fail("unterminated value");
+    }
+    element_.addAttribute(attribute, attributeEnd, value, valueEnd);
+    p_ = valueEnd + 1;
+  }
+}
+
+/* Reads an end tag, following the "</", checking that it matches. */
+bool XmlReader::readEndElement(XmlHandler& handler) {
+  const char* name = p_;
+  const char* end = readName();
+  if (open_.empty()) {
+    return fail("unexpected end tag");
+  }
+  const char* open = open_.back();
+  if ((nameEnd(open, end_) - open != end - name)
+      || (strncmp(open, name, end - name) != 0)) {
+    return fail("mismatched end tag");
+  }
+  skipSpace();
+  if ((p_ >= end_) || (*p_ != '>')) {
+    return fail("expected '>'");
+  }
+  p_++;
+  open_.pop_back();
+  handler.endElement();
+  return true;
+}
+
+bool XmlReader::skip(const char* terminator) {
+  size_t n = strlen(terminator);
+  for (const char* p = p_; end_ - p >= (ptrdiff_t) n; p++) {
+    if (strncmp(p, terminator, n) == 0) {
+      p_ = p + n;
+      return true;
+    }
+  }
+  return fail("unterminated markup");
+}
+
+void XmlReader::skipSpace() {
+  while ((p_ < end_) && isSpace(*p_)) {
+    p_++;
+  }
+}
+
+const char* XmlReader::readName() {
+  p_ = nameEnd(p_, end_);
+  return p_;
+}
+
+/* Records the error, along with the line on which it occurred. */
+bool XmlReader::fail(const char* message) {
+  int line = 1;
+  for (const char* p = data_; p < p_; p++) {
+    if (*p == '\n') {
+      line++;
+    }
+  }
+  char s[32];
+  snprintf(s, sizeof(s), "line %d: ", line);
+  error_ = s;
+  error_.append(message);
+  return false;
+}
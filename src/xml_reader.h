@@ -0,0 +1,87 @@
+// -*- C++ -*-
+
+#ifndef MBOSTOCK_XML_READER_H
+#define MBOSTOCK_XML_READER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace mbostock {
+
+  /**
+   * An element's name and attributes, as passed to an XmlHandler. Values have
+   * their entities decoded. The element is only valid during the call; copy it
+   * to keep it.
+   */
+  class XmlElement {
+  public:
+    inline const char* name() const { return &text_[0]; }
+
+    /** Returns the value of the specified attribute, or NULL if absent. */
+    const char* attribute(const char* name) const;
+
+    /**
+     * Parses the specified attribute as a float. Returns false, leaving the
+     * value unchanged, if the attribute is absent or not a number.
+     */
+    bool queryFloat(const char* name, float* value) const;
+
+  private:
+    void clear();
+    void setName(const char* begin, const char* end);
+    void addAttribute(const char* name, const char* nameEnd,
+        const char* value, const char* valueEnd);
+
+    /** The name, then each attribute's name and value, each terminated. */
+    std::vector<char> text_;
+    std::vector<int> attributes_;
+
+    friend class XmlReader;
+  };
+
+  /** Receives the elements of a document as they are read. */
+  class XmlHandler {
+  public:
+    virtual ~XmlHandler();
+
+    virtual void startElement(const XmlElement& e) = 0;
+    virtual void endElement() = 0;
+  };
+
+  /**
+   * A streaming XML reader, which reports elements to a handler as they open
+   * and close, without building a tree. Only elements and attributes are
+   * reported; text, comments, CDATA sections, processing instructions and
+   * doctypes are skipped. Files are mapped into memory rather than read.
+   */
+  class XmlReader {
+  public:
+    XmlReader();
+
+    /** Reads the specified file; returns false on error (see error). */
+    bool readFile(const char* path, XmlHandler& handler);
+    bool read(const char* data, size_t length, XmlHandler& handler);
+
+    /** Returns a description of the last error, with its line number. */
+    inline const std::string& error() const { return error_; }
+
+  private:
+    bool readElement(XmlHandler& handler);
+    bool readEndElement(XmlHandler& handler);
+    bool skip(const char* terminator);
+    void skipSpace();
+    const char* readName();
+    bool fail(const char* message);
+
+    const char* data_;
+    const char* p_;
+    const char* end_;
+    std::vector<const char*> open_;
+    XmlElement element_;
+    std::string error_;
+  };
+
+}
+
+#endif
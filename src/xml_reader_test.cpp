@@ -0,0 +1,212 @@
+// -*- C++ -*-
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "xml_reader.h"
+
+using namespace mbostock;
+
+static int returnCode = 0;
+
+void assertTrue(bool condition, const char* message, ...) {
+  if (!condition) {
+    va_list args;
+    va_start(args, message);
+    printf("assertion failed: ");
+    vprintf(message, args);
+    printf("\n");
+    va_end(args);
+    returnCode = 1;
+  }
+}
+
+/*
+ * Records the elements read as a string, such as "<a x=1><b/></a>", so that
+ * the order of calls can be checked too. Attributes are looked up by name.
+ */
+class RecordingHandler : public XmlHandler {
+public:
+  RecordingHandler(const char* attribute = "x") : attribute_(attribute) {}
+
+  virtual void startElement(const XmlElement& e) {
+    out.append("<");
+    out.append(e.name());
+    const char* value = e.attribute(attribute_);
+    if (value != NULL) {
+      out.append(" ");
+      out.append(attribute_);
+      out.append("=");
+      out.append(value);
+    }
+    out.append(">");
+  }
+
+  virtual void endElement() {
+    out.append("</>");
+  }
+
+  std::string out;
+
+private:
+  const char* attribute_;
+};
+
+static std::string read(const char* xml, bool* ok = NULL) {
+  XmlReader reader;
+  RecordingHandler handler;
+  bool r = reader.read(xml, strlen(xml), handler);
+  if (ok != NULL) {
+    *ok = r;
+  }
+  return handler.out;
+}
+
+static std::string error(const char* xml) {
+  XmlReader reader;
+  RecordingHandler handler;
+  assertTrue(!reader.read(xml, strlen(xml), handler), "read(%s)", xml);
+  return reader.error();
+}
+
+static void testElements() {
+  printf("testElements...\n");
+  bool ok;
+  std::string s = read("<a x=\"1\">\n  <b x='2'/>\n  <c></c>\n</a>\n", &ok);
+  assertTrue(ok, "ok");
+  assertTrue(s == "<a x=1><b x=2></><c></></>", "s == %s", s.c_str());
+
+  s = read("<a  x = \"1\"  y=\"2\" ></a >", &ok);
+  assertTrue(ok, "spaced ok");
+  assertTrue(s == "<a x=1></>", "spaced s == %s", s.c_str());
+
+  s = read("", &ok);
+  assertTrue(ok && s.empty(), "empty");
+}
+
+static void testAttributes() {
+  printf("testAttributes...\n");
+  const char* xml = "<a x=\"1.5\" y=\"abc\" z=\"\"/>";
+  XmlReader reader;
+
+  class Handler : public XmlHandler {
+  public:
+    virtual void startElement(const XmlElement& e) {
+      x = 0.f;
+      y = 7.f;
+      hasX = e.queryFloat("x", &x);
+      hasY = e.queryFloat("y", &y);
+      hasW = e.queryFloat("w", &y);
+      z = e.attribute("z");
+      w = e.attribute("w");
+    }
+    virtual void endElement() {}
+    float x, y;
+    bool hasX, hasY, hasW;
+    std::string z;
+    const char* w;
+  } handler;
+
+  assertTrue(reader.read(xml, strlen(xml), handler), "read");
+  assertTrue(handler.hasX && (handler.x == 1.5f), "x == %g", handler.x);
+  assertTrue(!handler.hasY && (handler.y == 7.f), "y unchanged");
+  assertTrue(!handler.hasW && (handler.w == NULL), "w absent");
+  assertTrue(handler.z.empty(), "z empty");
+}
+
+static void testEntities() {
+  printf("testEntities...\n");
+  std::string s = read("<a x=\"&lt;&gt;&amp;&quot;&apos;\"/>");
+  assertTrue(s == "<a x=<>&\"'></>", "named: %s", s.c_str());
+
+  /* Unknown entities, and ampersands that start none, are kept as is. */
+  s = read("<a x=\"&foo; & &amp\"/>");
+  assertTrue(s == "<a x=&foo; & &amp></>", "unknown: %s", s.c_str());
+
+  /* An entity decodes to a single ampersand, not to another entity. */
+  s = read("<a x=\"&amp;lt;\"/>");
+  assertTrue(s == "<a x=&lt;></>", "once: %s", s.c_str());
+}
+
+static void testCodePoints() {
+  printf("testCodePoints...\n");
+  std::string s = read("<a x=\"&#65;&#x42;&#x63;\"/>");
+  assertTrue(s == "<a x=ABc></>", "ascii: %s", s.c_str());
+
+  s = read("<a x=\"&#xe9;&#x20ac;&#x1F600;\"/>");
+  assertTrue(s == "<a x=\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80></>",
+      "utf-8: %s", s.c_str());
+
+  /* Zero, out-of-range and malformed references are kept as is. */
+  s = read("<a x=\"&#0;&#x110000;&#x;&#12a;\"/>");
+  assertTrue(s == "<a x=&#0;&#x110000;&#x;&#12a;></>", "kept: %s",
+      s.c_str());
+}
+
+static void testSkipped() {
+  printf("testSkipped...\n");
+  bool ok;
+  std::string s = read(
+      "<?xml version=\"1.0\"?>\n"
+      "<!DOCTYPE world>\n"
+      "<!-- <b x=\"1\"/> -- not an element -->\n"
+      "<a>text<![CDATA[<c x=\"2\"/></a>]]>more text<!----></a>", &ok);
+  assertTrue(ok, "ok");
+  assertTrue(s == "<a></>", "s == %s", s.c_str());
+}
+
+static void testErrors() {
+  printf("testErrors...\n");
+  std::string e = error("<a>\n  <b>\n  </c>\n</a>");
+  assertTrue(e == "line 3: mismatched end tag", "mismatched: %s", e.c_str());
+
+  /* A name that is a prefix of the open element's still mismatches. */
+  e = error("<ab></a>");
+  assertTrue(e == "line 1: mismatched end tag", "prefix: %s", e.c_str());
+
+  e = error("<a/>\n</a>");
+  assertTrue(e == "line 2: unexpected end tag", "unexpected: %s", e.c_str());
+
+  e = error("<a>\n<b/>\n");
+  assertTrue(e == "line 3: unclosed element", "unclosed: %s", e.c_str());
+
+  e = error("<a>\n<!-- never closed\n</a>\n");
+  assertTrue(e == "line 2: unterminated markup", "comment: %s", e.c_str());
+
+  e = error("<a>\n<![CDATA[ never closed </a>");
+  assertTrue(e == "line 2: unterminated markup", "cdata: %s", e.c_str());
+
+  e = error("\n\n<a x=\"1/>");
+  assertTrue(e == "line 3: unterminated value", "value: %s", e.c_str());
+
+  e = error("<a x=1/>");
+  assertTrue(e == "line 1: expected quoted value", "quoted: %s", e.c_str());
+
+  e = error("<a\n\nx/>");
+  assertTrue(e == "line 3: expected '='", "equals: %s", e.c_str());
+
+  e = error("<>");
+  assertTrue(e == "line 1: expected element name", "name: %s", e.c_str());
+}
+
+/* The handler sees the elements read before an error, but no more. */
+static void testPartial() {
+  printf("testPartial...\n");
+  bool ok;
+  std::string s = read("<a><b/></c><d/></a>", &ok);
+  assertTrue(!ok, "!ok");
+  assertTrue(s == "<a><b></>", "s == %s", s.c_str());
+}
+
+int main(int argc, char** argv) {
+  testElements();
+  testAttributes();
+  testEntities();
+  testCodePoints();
+  testSkipped();
+  testErrors();
+  testPartial();
+  return returnCode;
+}